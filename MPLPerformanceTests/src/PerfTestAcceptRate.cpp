@@ -0,0 +1,126 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Connection rate of TCPResponder with one listener against sharded
+   accept (AcceptShards: SO_REUSEPORT listeners, one accept thread each)
+   - start Listener component in reactor mode, 1, 2, 4 and "cores" shards
+   - client threads connect and close as fast as they can (a reconnect storm)
+   - the listener stops by itself after NUM_CONNECTIONS clients (NumClients)
+   - eval connections accepted per second
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <mpl.h>
+#include <chrono>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+
+using namespace CSE384;
+
+// keep the client TIME_WAIT sockets within the ephemeral port range
+const int NUM_CONNECTIONS = 4000;
+const int NUM_CLIENT_THREADS = 8;
+
+class CloseHandler : public ClientHandler
+{
+public:
+   virtual ClientHandler *Clone()
+   {
+      return new CloseHandler();
+   }
+
+   // not used in reactor mode
+   virtual void AppProc()
+   {
+   }
+
+   virtual void OnMessage(const MessagePtr &/*msg*/)
+   {
+   }
+};
+
+void storm(int num_shards)
+{
+   EndPoint addr("127.0.0.1", 8090);
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   CloseHandler handler;
+
+   TCPResponder responder(addr, &sock_opts);
+   responder.UseReactor(true);
+   responder.ReactorThreads(1);
+   responder.AcceptShards(num_shards);
+   responder.PinAcceptShards(true);
+   responder.NumClients(NUM_CONNECTIONS);
+   responder.RegisterClientHandler(&handler);
+
+   StopWatch tmr;
+   tmr.start();
+   responder.Start(1024);
+
+   std::atomic<int> next(0);
+   std::atomic<int> failed(0);
+   std::vector<std::thread> clients;
+   for (int t = 0; t < NUM_CLIENT_THREADS; ++t)
+   {
+      clients.push_back(std::thread([&]() {
+         while (next.fetch_add(1) < NUM_CONNECTIONS)
+         {
+            TCPClientSocket sock;
+            try
+            {
+               sock.Connect(addr);
+            }
+            catch (const std::exception &)
+            {
+               // refused (backlog full): try again
+               ++failed;
+               next.fetch_sub(1);
+               continue;
+            }
+            sock.Close();
+         }
+      }));
+   }
+   for (auto &t : clients)
+      t.join();
+
+   // returns once every connection has been accepted (and closed)
+   responder.Stop();
+   tmr.stop();
+
+   std::cout << "\n  " << num_shards << " accept shard" << (num_shards > 1 ? "s" : "");
+   std::cout << "\n    elapsed microseconds: " << tmr.elapsed_micros();
+   std::cout << "\n    connections/second: " << (1.0e6 * NUM_CONNECTIONS) / tmr.elapsed_micros();
+   std::cout << "\n    refused connects (retried): " << failed.load() << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+   int cores = (int)WorkStealingPool::AvailableCores();
+   std::cout << "\n  -- " << NUM_CONNECTIONS << " connections from " << NUM_CLIENT_THREADS
+             << " client threads, " << cores << " core(s) --";
+
+   std::vector<int> shards = {1, 2, 4};
+   if (cores > 4)
+      shards.push_back(cores);
+   for (int n : shards)
+      storm(n);
+   std::cout << std::endl;
+}
+
+#else
+#include <iostream>
+
+int main()
+{
+   std::cout << "sharded accept (SO_REUSEPORT) requires Linux" << std::endl;
+}
+#endif
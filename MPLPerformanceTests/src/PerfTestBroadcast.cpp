@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Test server push (market data style) with TCPResponder::Broadcast
+   - start Listener component
+   - connect a number of subscribers (TCPConnector)
+   - broadcast a fixed number of messages (one shared payload per message)
+   - broadcast END message, each subscriber exits when it sees it
+   - eval elapsed time and delivered message rate
+   - repeat with one slow subscriber and a client queue depth limit
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <mpl.h>
+#include <chrono>
+#include <algorithm>
+
+using namespace CSE384;
+using namespace std::chrono;
+
+const int END = 1;
+
+/*---------------------------------------------------------
+  subscriber: count the pushed messages until END (or disconnect)
+*/
+void subscriber(const EndPoint &addr, unsigned delay_micros, std::atomic<uint64_t> &received)
+{
+   // read straight from the socket (no receive queue), so a slow subscriber
+   // pushes back on the server once the socket buffers are full
+   TCPConnector conn;
+   conn.UseReceiveQueue(false);
+   conn.ConnectPersist(addr, 10, 1, 0);
+   if (!conn.IsConnected())
+      return;
+
+   MessagePtr msg;
+   while ((msg = conn.ReceiveMessage())->GetType() != END && msg->GetType() != DISCONNECT)
+   {
+      ++received;
+      if (delay_micros)
+         std::this_thread::sleep_for(microseconds(delay_micros));
+   }
+   conn.Close();
+}
+
+class SubscriptionHandler : public ClientHandler
+{
+public:
+   virtual ClientHandler *Clone()
+   {
+      return new SubscriptionHandler();
+   }
+
+   // nothing to do but wait for the subscriber to leave: the data is pushed by Broadcast
+   virtual void AppProc()
+   {
+      while (GetMessage()->GetType() != MessageType::DISCONNECT)
+      {
+      }
+   }
+};
+
+bool is_connected(TCPResponder &responder, ClientId id)
+{
+   std::vector<ClientId> ids = responder.ConnectedClients();
+   return std::find(ids.begin(), ids.end(), id) != ids.end();
+}
+
+/*---------------------------------------------------------
+  push num_msgs messages to every connected subscriber
+*/
+void broadcast(TCPResponder &responder, const EndPoint &addr, int num_subs, unsigned slow_subs,
+               unsigned num_msgs, unsigned sz_bytes)
+{
+   std::atomic<uint64_t> received(0);
+   std::vector<std::thread> subs;
+   for (int i = 0; i < num_subs; ++i)
+      subs.push_back(std::thread(subscriber, addr, (i < (int)slow_subs) ? 200 : 0, std::ref(received)));
+
+   while (responder.NumConnectedClients() < (size_t)num_subs)
+      std::this_thread::sleep_for(milliseconds(10));
+
+   std::string body(sz_bytes, 'm');
+   uint64_t skipped = responder.SkippedSends();
+   uint64_t dropped = responder.DroppedClients();
+   StopWatch tmr;
+   tmr.start();
+
+   uint64_t queued = 0;
+   for (unsigned i = 0; i < num_msgs; ++i)
+      queued += responder.Broadcast(Message::CreateMessage(body, MessageType::DEFAULT));
+
+   // END has to reach everyone still connected (wait for skipped clients to catch up)
+   MessagePtr end = Message::CreateMessage(nullptr, 0, END);
+   for (ClientId id : responder.ConnectedClients())
+   {
+      while (!responder.SendTo(id, end) && is_connected(responder, id))
+         std::this_thread::sleep_for(milliseconds(1));
+   }
+
+   for (auto &sub : subs)
+      sub.join();
+   tmr.stop();
+
+   auto et = tmr.elapsed_micros();
+   std::cout << "\n  subscribers: " << num_subs << " (slow: " << slow_subs << ")";
+   std::cout << "\n  elapsed microseconds: " << et;
+   std::cout << "\n  messages queued: " << queued << " received: " << received.load();
+   std::cout << "\n  delivered messages/second: " << (1.0e6 * received.load()) / et;
+   std::cout << "\n  skipped sends: " << responder.SkippedSends() - skipped
+             << " dropped clients: " << responder.DroppedClients() - dropped
+             << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+   // each client handler occupies one of the TCPResponder's 8 thread pool threads
+   const int NUM_SUBSCRIBERS = 8;
+   const int NUM_MSGS = 5000;
+   const int MSG_SIZE = 4096;
+
+   EndPoint addr("127.0.0.1", 8082);
+   SubscriptionHandler sh;
+
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   TCPResponder responder(addr, &sock_opts);
+   responder.NumClients(3 * NUM_SUBSCRIBERS);
+   responder.UseClientSendDrain(true);
+   responder.RegisterClientHandler(&sh);
+   responder.Start();
+   std::this_thread::sleep_for(milliseconds(100));
+
+   std::cout << "\n  -- broadcast: all subscribers keep up --";
+   broadcast(responder, addr, NUM_SUBSCRIBERS, 0, NUM_MSGS, MSG_SIZE);
+
+   std::cout << "\n  -- broadcast: one slow subscriber, queue limit 1000 (skip) --";
+   responder.ClientQueueLimit(1000, TCPResponder::SKIP_CLIENT);
+   broadcast(responder, addr, NUM_SUBSCRIBERS, 1, NUM_MSGS, MSG_SIZE);
+
+   std::cout << "\n  -- broadcast: one slow subscriber, queue limit 1000 (disconnect) --";
+   responder.ClientQueueLimit(1000, TCPResponder::DISCONNECT_CLIENT);
+   broadcast(responder, addr, NUM_SUBSCRIBERS, 1, NUM_MSGS, MSG_SIZE);
+
+   responder.Stop();
+   std::cout << std::endl;
+}
@@ -15,6 +15,11 @@
    - send END message to exit client handler
    - eval elapsed time
    - send QUIT message to shut down Listener
+   - run once over loopback TCP, once over a Unix domain socket (same host)
+   - round trip latency (client_wait_for_reply) over loopback TCP, a Unix
+     domain socket and a shared memory channel
+   - both again in-process (no socket, no serialization): the cost of the
+     framework itself, apart from the kernel
 */
 
 #include <string>
@@ -84,6 +89,7 @@ void client_wait_for_reply(const EndPoint &addr,    // endpoint (address, port)
    int64_t et = tmr.elapsed_micros();
    conn.Close(); // shutdown connection (end message etc.)
    display_test_data(et, num_msgs, sz_bytes);
+   std::cout << "\n   round trip usec  " << (double)et / num_msgs;
    //});
 
    //return handle;
@@ -169,8 +175,19 @@ void multiple_clients(int nc,
 
    std::cout << "\n elapsed microseconds: " << et;
    std::cout << "\n number messages: " << nm;
-   std::cout << "\n throughput MB/S: " << tp
-             << "\n";
+   std::cout << "\n throughput MB/S: " << tp;
+   std::cout << "\n message pool hits: " << MessagePool::Hits()
+             << " misses: " << MessagePool::Misses()
+             << " oversize: " << MessagePool::Oversize();
+
+   // per size class (hits/misses): misses track the peak number of messages in flight
+   std::cout << "\n message pool classes:";
+   for (int i = 0; i < MessagePool::NUM_CLASSES; ++i)
+   {
+      if (MessagePool::Hits(i) + MessagePool::Misses(i) > 0)
+         std::cout << " [" << MessagePool::ClassSize(i) << "B " << MessagePool::Hits(i) << "/" << MessagePool::Misses(i) << "]";
+   }
+   std::cout << "\n";
 }
 
 class PerfClientHandler : public FixedSizeMsgClientHander
@@ -216,17 +233,16 @@ public:
    }
 };
 
-int main(int argc, char* argv[])
+const int MSG_SIZE = 4096;
+const int NUM_CLIENTS = 16;
+const int NUM_MSGS = 1000;
+const std::string TEST_NAME = "test4";
+
+/*---------------------------------------------------------
+  start a responder on addr and run the clients against it
+*/
+void run(const std::string &transport, const EndPoint &addr)
 {
-   // specify the server Endpoint we wish to connect
-   
-   const int MSG_SIZE = 4096;
-   const int NUM_CLIENTS = 16;
-   const int NUM_MSGS = 1000;
-   const int NUM_THREAD_POOL_THREADS = 8;
-   const std::string TEST_NAME = "test4";
-   
-   EndPoint addr("127.0.0.1", 8080);
    PerfClientHandler ph(MSG_SIZE);
 
    // set TCP socket options
@@ -250,19 +266,56 @@ int main(int argc, char* argv[])
    // give the server a 
    std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
-   // std::thread test3 = std::thread(client_wait_for_reply, addr, "test3", 1000, 1024);
-   // test3.join();
-  
-   std::cout << "\n  -- test4: (fixed size message) c++_comm --\n";
+   std::cout << "\n  -- test4: (fixed size message) c++_comm, " << transport << " " << addr << " --\n";
    int nt = 8;
    std::cout << "\n  num thrdpool thrds: " << nt;
 
    multiple_clients(NUM_CLIENTS, addr, TEST_NAME, NUM_MSGS, MSG_SIZE);
 
-  // std::cin.get();
+   // stop the listener
+   responder.Stop();
+}
+
+/*---------------------------------------------------------
+  one client, each message waits for its reply
+*/
+void round_trip(const std::string &transport, const EndPoint &addr)
+{
+   const int RT_MSGS = 10000;
+   const int RT_SIZE = 64;
+
+   PerfClientHandler ph(RT_SIZE);
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   TCPResponder responder(addr, &sock_opts);
+   responder.NumClients(1);
+   responder.UseClientSendReceiveQueues(false);
+   responder.RegisterClientHandler(&ph);
+   responder.Start();
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+   std::cout << "\n  -- round trip, " << transport << " " << addr << " --";
+   client_wait_for_reply(addr, "test3", RT_MSGS, RT_SIZE);
+   std::cout << "\n";
 
-   // stop the listener and quit
    responder.Stop();
+}
+
+int main(int argc, char* argv[])
+{
+   run("loopback TCP", EndPoint("127.0.0.1", 8080));
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+   // same host peers: Unix domain socket
+   run("Unix domain socket", EndPoint("unix:/tmp/mpl_perf_fixed.sock"));
+#endif
+   run("in-process", EndPoint("inproc:perf_fixed"));
+
+   round_trip("loopback TCP", EndPoint("127.0.0.1", 8081));
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+   round_trip("Unix domain socket", EndPoint("unix:/tmp/mpl_perf_rt.sock"));
+   round_trip("shared memory", EndPoint("shm:/tmp/mpl_perf_rt_shm.sock"));
+#endif
+   round_trip("in-process", EndPoint("inproc:perf_rt"));
 
    return 0;
-}
\ No newline at end of file
+}
@@ -28,6 +28,10 @@ using namespace std::chrono;
 
 static std::mutex ioLock;
 
+// receive buffer counters (summed over all clients)
+static std::atomic<uint64_t> recv_calls(0);
+static std::atomic<uint64_t> recv_msgs(0);
+
 
 /*---------------------------------------------------------
   Display test data - used for individual tests
@@ -96,7 +100,9 @@ void client_wait_for_reply(const EndPoint &addr,    // endpoint (address, port)
 void client_no_wait_for_reply(const EndPoint &addr,    // endpoint (address, port)
                               const std::string &name, // test name
                               unsigned num_msgs,       // number of mesages to send
-                              unsigned sz_bytes        // body size in bytes
+                              unsigned sz_bytes,       // body size in bytes
+                              bool drain,              // flush queued messages in one gather send
+                              bool recv_buf            // decode many frames per recv()
 )
 {
    {
@@ -105,6 +111,8 @@ void client_no_wait_for_reply(const EndPoint &addr,    // endpoint (address, por
    }
 
    TCPConnector conn;
+   conn.UseSendDrain(drain);
+   conn.UseReceiveBuffer(recv_buf);
    conn.ConnectPersist(addr, 10, 1, 0);
    if (conn.IsConnected())
    {
@@ -130,6 +138,12 @@ void client_no_wait_for_reply(const EndPoint &addr,    // endpoint (address, por
       
       conn.Close(&handle);
 
+      if (conn.GetReceiveBuffer())
+      {
+         recv_calls += conn.GetReceiveBuffer()->RecvCalls();
+         recv_msgs += conn.GetReceiveBuffer()->MessagesDecoded();
+      }
+
    }
 }
 
@@ -141,17 +155,22 @@ void multiple_clients(int nc,
                      const EndPoint &addr,    // endpoint (address, port)
                      const std::string &name, // test name
                      unsigned num_msgs,       // number of mesages to send
-                     unsigned sz_bytes        // body size in bytes
+                     unsigned sz_bytes,       // body size in bytes
+                     bool drain,              // send drain mode (batched gather sends)
+                     bool recv_buf            // receive buffer mode (many frames per recv)
 )
 {
    std::cout << "\n  number of clients:  ", nc;
+   std::cout << "\n  send drain mode:    " << (drain ? "on" : "off");
+   std::cout << "\n  receive buffer:     " << (recv_buf ? "on" : "off");
+   recv_calls = recv_msgs = 0;
    StopWatch tmr;
    tmr.start();
 
    std::vector<std::thread> handles;
    for (int _i = 0; _i < nc; ++_i)
    {
-      handles.push_back(std::thread(client_no_wait_for_reply, addr, name, num_msgs, sz_bytes));
+      handles.push_back(std::thread(client_no_wait_for_reply, addr, name, num_msgs, sz_bytes, drain, recv_buf));
    }
 
    /*-- wait for all replies --*/
@@ -168,6 +187,11 @@ void multiple_clients(int nc,
 
    std::cout << "\n elapsed microseconds: " << et;
    std::cout << "\n number messages: " << nm;
+   std::cout << "\n messages/second: " << (uint64_t) (1.0e6 * nm / et);
+   if (recv_buf && recv_msgs > 0)
+      std::cout << "\n recv calls/message: " << (double) recv_calls / recv_msgs;
+   else
+      std::cout << "\n recv calls/message: 2 (header + body)";
    std::cout << "\n throughput MB/S: " << tp
              << "\n";
 }
@@ -238,7 +262,8 @@ int main(int argc, char* argv[])
    TCPResponder responder(addr, &sock_opts);
 
     // set number of clients for the server process to service before exiting (-1 runs indefinitely)
-   responder.NumClients(NUM_CLIENTS);
+    // (three rounds: baseline, send drain mode, send drain + receive buffer)
+   responder.NumClients(3 * NUM_CLIENTS);
 
    responder.UseClientSendReceiveQueues(false);  // uncomment if you use SendMessage/ReceiveMessage
 
@@ -259,7 +284,12 @@ int main(int argc, char* argv[])
    std::cout << "\n  num thrdpool thrds: " << nt;
    
 
-   multiple_clients(NUM_CLIENTS, addr, TEST_NAME, NUM_MSGS, MSG_SIZE);
+   multiple_clients(NUM_CLIENTS, addr, TEST_NAME, NUM_MSGS, MSG_SIZE, false, false);
+   multiple_clients(NUM_CLIENTS, addr, TEST_NAME, NUM_MSGS, MSG_SIZE, true, false);
+
+   // the responder reads the receive buffer setting when each client connects
+   responder.UseClientReceiveBuffer(true);
+   multiple_clients(NUM_CLIENTS, addr, TEST_NAME, NUM_MSGS, MSG_SIZE, true, true);
 
   // std::cin.get();
 
@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Test client fan-out: many TCPConnectors to several servers
+   - start several Listener components (reactor mode echo servers)
+   - connect a number of connectors, spread over the servers
+   - post a message on every connector, then get every reply (repeat)
+   - eval elapsed time, round trip rate and client thread count
+   - once with a send/receive thread per connector, once with a ConnectorGroup
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <mpl.h>
+#include <chrono>
+
+using namespace CSE384;
+using namespace std::chrono;
+
+const int NUM_SERVERS = 4;
+const int NUM_CONNECTORS = 400;
+const int NUM_ROUNDS = 100;
+const int MSG_SIZE = 64;
+const int BASE_PORT = 8084;
+
+class EchoHandler : public ClientHandler
+{
+public:
+   virtual ClientHandler *Clone()
+   {
+      return new EchoHandler();
+   }
+
+   // not used in reactor mode
+   virtual void AppProc()
+   {
+   }
+
+   virtual void OnMessage(const MessagePtr &msg)
+   {
+      if (msg->GetType() != MessageType::DISCONNECT)
+         PostMessage(msg);
+   }
+};
+
+// number of threads in this process (Linux: /proc/self/status)
+int num_threads()
+{
+   std::ifstream status("/proc/self/status");
+   std::string line;
+   while (std::getline(status, line))
+   {
+      if (line.compare(0, 8, "Threads:") == 0)
+         return std::stoi(line.substr(8));
+   }
+   return -1;
+}
+
+/*---------------------------------------------------------
+  connect, run the echo rounds and close: group == nullptr uses connector threads
+  (client threads: started since base_threads)
+*/
+void fan_out(ConnectorGroup *group, int base_threads)
+{
+   std::vector<std::unique_ptr<TCPConnector>> conns;
+   for (int i = 0; i < NUM_CONNECTORS; ++i)
+   {
+      conns.emplace_back(new TCPConnector());
+      conns.back()->UseConnectorGroup(group);
+      conns.back()->ConnectPersist(EndPoint("127.0.0.1", BASE_PORT + i % NUM_SERVERS), 10, 1, 0);
+   }
+   int client_threads = num_threads() - base_threads;
+
+   MessagePtr msg = Message::CreateMessage(std::string(MSG_SIZE, 'f'), MessageType::DEFAULT);
+   uint64_t round_trips = 0;
+   StopWatch tmr;
+   tmr.start();
+   for (int round = 0; round < NUM_ROUNDS; ++round)
+   {
+      for (auto &conn : conns)
+         conn->PostMessage(msg);
+      for (auto &conn : conns)
+      {
+         if (conn->GetMessage()->GetType() == MessageType::DEFAULT)
+            ++round_trips;
+      }
+   }
+   tmr.stop();
+
+   auto et = tmr.elapsed_micros();
+   std::cout << "\n  connectors: " << NUM_CONNECTORS << " to " << NUM_SERVERS << " servers";
+   std::cout << "\n  client threads: " << client_threads;
+   std::cout << "\n  elapsed microseconds: " << et;
+   std::cout << "\n  round trips/second: " << (1.0e6 * round_trips) / et << "\n";
+
+   for (auto &conn : conns)
+      conn->Close();
+}
+
+int main(int argc, char *argv[])
+{
+   EchoHandler eh;
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   std::vector<std::unique_ptr<TCPResponder>> servers;
+   for (int i = 0; i < NUM_SERVERS; ++i)
+   {
+      servers.emplace_back(new TCPResponder(EndPoint("127.0.0.1", BASE_PORT + i), &sock_opts));
+      servers.back()->UseReactor(true);
+      servers.back()->ReactorThreads(1);
+      // both runs connect to every server
+      servers.back()->NumClients(2 * NUM_CONNECTORS / NUM_SERVERS);
+      servers.back()->RegisterClientHandler(&eh);
+      servers.back()->Start(NUM_CONNECTORS);
+   }
+   std::this_thread::sleep_for(milliseconds(100));
+
+   std::cout << "\n  -- fan-out: send and receive threads per connector --";
+   fan_out(nullptr, num_threads());
+
+   std::cout << "\n  -- fan-out: ConnectorGroup with 2 threads --";
+   {
+      int base_threads = num_threads();
+      ConnectorGroup group(2);
+      fan_out(&group, base_threads);
+   }
+
+   for (auto &server : servers)
+      server->Stop();
+   std::cout << std::endl;
+}
@@ -0,0 +1,311 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Compare plain system calls with the io_uring backend
+   - sockets: open a number of loopback connections, then repeat rounds of
+     one block written on every connection and read back on the other end
+       1. plain send/recv
+       2. TCPSocket::UseIoUring(true) (one ring operation per call)
+       3. batched: every write and read of a round queued in one ring with
+          registered buffers, submitted together
+   - files: read a temporary file in blocks
+       1. plain pread
+       2. batched registered buffer reads (queue depth 16)
+   - eval rate and system calls per operation
+   (only the plain modes run when io_uring is not available)
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <mpl.h>
+#include <chrono>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+
+using namespace CSE384;
+using namespace std::chrono;
+
+const int NUM_CONNS = 128;
+const int BLOCK_SIZE = 4096;
+const int NUM_ROUNDS = 200;
+
+const size_t FILE_SIZE = 64 * 1024 * 1024;
+const size_t FILE_BLOCK = 64 * 1024;
+const int QUEUE_DEPTH = 16;
+
+void report(const std::string &mode, long long et, double ops, double syscalls, const std::string &unit, double amount)
+{
+   std::cout << "\n  " << mode;
+   std::cout << "\n    elapsed microseconds: " << et;
+   std::cout << "\n    " << unit << ": " << (1.0e6 * amount) / et;
+   std::cout << "\n    system calls per operation: " << syscalls / ops << "\n";
+}
+
+/*---------------------------------------------------------
+  sockets: writers[i] is connected to readers[i]
+*/
+void socket_rounds(std::vector<TCPClientSocket> &writers, std::vector<TCPSocket> &readers, const std::string &mode)
+{
+   std::vector<char> block(BLOCK_SIZE, 'u');
+   std::vector<char> reply(BLOCK_SIZE);
+   IoUring *ring = TCPSocket::UseIoUring() ? IoUring::ThreadRing() : nullptr;
+   uint64_t enter_before = (ring != nullptr) ? ring->EnterCalls() : 0;
+
+   StopWatch tmr;
+   tmr.start();
+   for (int round = 0; round < NUM_ROUNDS; ++round)
+   {
+      for (auto &sock : writers)
+         sock.Send(block.data(), BLOCK_SIZE, 0, 1);
+      for (auto &sock : readers)
+         sock.Recv(reply.data(), BLOCK_SIZE, MSG_WAITALL, 1);
+   }
+   tmr.stop();
+
+   double ops = 2.0 * NUM_CONNS * NUM_ROUNDS;
+   // plain mode: one send and (at least) one recv per block
+   double syscalls = (ring != nullptr) ? (double)(ring->EnterCalls() - enter_before) : ops;
+   report(mode, tmr.elapsed_micros(), ops, syscalls, "MB/second", (double)NUM_CONNS * NUM_ROUNDS * BLOCK_SIZE / 1.0e6);
+}
+
+void socket_rounds_batched(std::vector<TCPClientSocket> &writers, std::vector<TCPSocket> &readers)
+{
+   IoUring ring;
+   ring.Init(2 * NUM_CONNS);
+
+   // one registered region for the outgoing blocks (index 0), one for the incoming (index 1)
+   std::vector<char> out(NUM_CONNS * BLOCK_SIZE, 'u');
+   std::vector<char> in(NUM_CONNS * BLOCK_SIZE);
+   IOVEC regions[2];
+   set_iovec_portable(regions[0], out.data(), out.size());
+   set_iovec_portable(regions[1], in.data(), in.size());
+   if (ring.RegisterBuffers(regions, 2) == -1)
+   {
+      std::cout << "\n  registering buffers failed: " << strerror(errno) << "\n";
+      return;
+   }
+
+   // user_data: connection index, high bit set for reads
+   const uint64_t READ = 1ull << 63;
+   std::vector<size_t> written(NUM_CONNS), received(NUM_CONNS);
+   std::vector<IoUring::Completion> done(2 * NUM_CONNS);
+   uint64_t ops = 0;
+
+   StopWatch tmr;
+   tmr.start();
+   for (int round = 0; round < NUM_ROUNDS; ++round)
+   {
+      for (int i = 0; i < NUM_CONNS; ++i)
+      {
+         written[i] = received[i] = 0;
+         ring.PrepWriteFixed(writers[i].GetSockFd(), &out[i * BLOCK_SIZE], BLOCK_SIZE, 0, 0, i);
+         ring.PrepReadFixed(readers[i].GetSockFd(), &in[i * BLOCK_SIZE], BLOCK_SIZE, 0, 1, READ | i);
+      }
+      ops += 2 * NUM_CONNS;
+
+      // one system call submits the round and waits; partial transfers are queued again
+      int pending = 2 * NUM_CONNS;
+      while (pending > 0)
+      {
+         if (ring.Submit(1) == -1)
+         {
+            std::cout << "\n  io_uring_enter failed: " << strerror(errno) << "\n";
+            return;
+         }
+
+         size_t n = ring.Reap(done.data(), done.size());
+         for (size_t c = 0; c < n; ++c)
+         {
+            size_t i = (size_t)(done[c].user_data & ~READ);
+            if (done[c].result <= 0)
+            {
+               std::cout << "\n  transfer failed: " << strerror(-done[c].result) << "\n";
+               return;
+            }
+
+            bool is_read = (done[c].user_data & READ) != 0;
+            size_t &count = is_read ? received[i] : written[i];
+            count += done[c].result;
+            if (count < BLOCK_SIZE)
+            {
+               if (is_read)
+                  ring.PrepReadFixed(readers[i].GetSockFd(), &in[i * BLOCK_SIZE + count], BLOCK_SIZE - count, 0, 1, READ | i);
+               else
+                  ring.PrepWriteFixed(writers[i].GetSockFd(), &out[i * BLOCK_SIZE + count], BLOCK_SIZE - count, 0, 0, i);
+               ++ops;
+            }
+            else
+               --pending;
+         }
+      }
+   }
+   tmr.stop();
+
+   report("3. io_uring batched, registered buffers", tmr.elapsed_micros(), (double)ops, (double)ring.EnterCalls(),
+          "MB/second", (double)NUM_CONNS * NUM_ROUNDS * BLOCK_SIZE / 1.0e6);
+   ring.UnregisterBuffers();
+}
+
+void socket_tests(bool uring)
+{
+   EndPoint addr("127.0.0.1", 8088);
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   TCPServerSocket listener;
+   listener.Bind(addr, &sock_opts);
+   listener.Listen(NUM_CONNS);
+
+   std::vector<TCPClientSocket> writers(NUM_CONNS);
+   std::vector<TCPSocket> readers;
+   for (auto &sock : writers)
+   {
+      sock.Connect(addr);
+      readers.push_back(listener.Accept());
+   }
+   listener.Close();
+
+   std::cout << "\n  -- sockets: " << NUM_CONNS << " connections, " << BLOCK_SIZE << " byte blocks, "
+             << NUM_ROUNDS << " rounds --";
+   socket_rounds(writers, readers, "1. plain send/recv");
+   if (uring)
+   {
+      TCPSocket::UseIoUring(true);
+      socket_rounds(writers, readers, "2. TCPSocket::UseIoUring(true)");
+      TCPSocket::UseIoUring(false);
+      socket_rounds_batched(writers, readers);
+   }
+
+   for (auto &sock : writers)
+      sock.Close();
+   for (auto &sock : readers)
+      sock.Close();
+}
+
+/*---------------------------------------------------------
+  files: sequential block reads of a (page cached) file
+*/
+void file_pread(int fd)
+{
+   std::vector<char> block(FILE_BLOCK);
+   size_t ops = 0;
+
+   StopWatch tmr;
+   tmr.start();
+   for (size_t off = 0; off < FILE_SIZE; off += FILE_BLOCK, ++ops)
+   {
+      if (pread(fd, block.data(), FILE_BLOCK, off) != (ssize_t)FILE_BLOCK)
+      {
+         std::cout << "\n  pread failed\n";
+         return;
+      }
+   }
+   tmr.stop();
+
+   report("1. plain pread", tmr.elapsed_micros(), (double)ops, (double)ops, "MB/second", FILE_SIZE / 1.0e6);
+}
+
+void file_batched(int fd)
+{
+   IoUring ring;
+   ring.Init(QUEUE_DEPTH);
+
+   // one registered buffer per slot in flight
+   std::vector<char> blocks(QUEUE_DEPTH * FILE_BLOCK);
+   std::vector<IOVEC> regions(QUEUE_DEPTH);
+   for (int i = 0; i < QUEUE_DEPTH; ++i)
+      set_iovec_portable(regions[i], &blocks[i * FILE_BLOCK], FILE_BLOCK);
+   if (ring.RegisterBuffers(regions.data(), QUEUE_DEPTH) == -1)
+   {
+      std::cout << "\n  registering buffers failed: " << strerror(errno) << "\n";
+      return;
+   }
+
+   IoUring::Completion done[QUEUE_DEPTH];
+   size_t next = 0, completed = 0, ops = 0;
+   const size_t total = FILE_SIZE / FILE_BLOCK;
+
+   StopWatch tmr;
+   tmr.start();
+   // user_data: buffer slot; a finished slot is refilled with the next block
+   for (int slot = 0; slot < QUEUE_DEPTH && next < total; ++slot, ++next, ++ops)
+      ring.PrepReadFixed(fd, &blocks[slot * FILE_BLOCK], FILE_BLOCK, next * FILE_BLOCK, slot, slot);
+
+   while (completed < total)
+   {
+      if (ring.Submit(1) == -1)
+      {
+         std::cout << "\n  io_uring_enter failed: " << strerror(errno) << "\n";
+         return;
+      }
+
+      size_t n = ring.Reap(done, QUEUE_DEPTH);
+      for (size_t c = 0; c < n; ++c)
+      {
+         if (done[c].result != (int)FILE_BLOCK)
+         {
+            std::cout << "\n  read failed: " << done[c].result << "\n";
+            return;
+         }
+         ++completed;
+         if (next < total)
+         {
+            int slot = (int)done[c].user_data;
+            ring.PrepReadFixed(fd, &blocks[slot * FILE_BLOCK], FILE_BLOCK, next * FILE_BLOCK, slot, slot);
+            ++next;
+            ++ops;
+         }
+      }
+   }
+   tmr.stop();
+
+   report("2. io_uring batched, registered buffers (queue depth 16)", tmr.elapsed_micros(), (double)ops,
+          (double)ring.EnterCalls(), "MB/second", FILE_SIZE / 1.0e6);
+   ring.UnregisterBuffers();
+}
+
+void file_tests(bool uring)
+{
+   char path[] = "/tmp/PerfTestIoUringXXXXXX";
+   int fd = mkstemp(path);
+   if (fd == -1)
+   {
+      std::cout << "\n  could not create a temporary file\n";
+      return;
+   }
+   unlink(path);
+
+   std::vector<char> block(FILE_BLOCK, 'f');
+   for (size_t off = 0; off < FILE_SIZE; off += FILE_BLOCK)
+      pwrite(fd, block.data(), FILE_BLOCK, off);
+
+   std::cout << "\n  -- files: " << FILE_SIZE / (1024 * 1024) << " MB read in " << FILE_BLOCK / 1024 << " KB blocks --";
+   file_pread(fd);
+   if (uring)
+      file_batched(fd);
+   close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+   bool uring = IoUring::Available();
+   if (!uring)
+      std::cout << "\n  io_uring is not available: running the plain system call modes only\n";
+
+   socket_tests(uring);
+   file_tests(uring);
+   std::cout << std::endl;
+}
+
+#else
+#include <iostream>
+
+int main()
+{
+   std::cout << "io_uring requires Linux" << std::endl;
+}
+#endif
@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Compare the cost of a log statement on the calling thread (no sockets)
+   - AsyncLog below the runtime level (statement disabled)
+   - Logger: message built with Utilities::Converter on the calling thread
+   - AsyncLog at the Debug level: raw arguments copied into the thread's ring
+     (1 logging thread, then 4)
+   - output goes to /dev/null (the logger threads still format and write)
+   - eval nanoseconds per statement, and the records AsyncLog dropped
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <mpl.h>
+#include <chrono>
+
+using namespace CSE384;
+using namespace std::chrono;
+
+const int CALLS_PER_THREAD = 200000;
+
+// runs stmt CALLS_PER_THREAD times on each thread, returns ns per statement
+double run(int num_threads, std::function<void(int)> stmt)
+{
+   auto start = steady_clock::now();
+   std::vector<std::thread> threads;
+   for (int t = 0; t < num_threads; ++t)
+   {
+      threads.push_back(std::thread([&stmt]() {
+         for (int i = 0; i < CALLS_PER_THREAD; ++i)
+            stmt(i);
+      }));
+   }
+   for (auto &t : threads)
+      t.join();
+   auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+   return (double)ns / ((double)num_threads * CALLS_PER_THREAD);
+}
+
+void show(const std::string &name, double ns)
+{
+   std::cout << "\n  " << name << ": " << ns << " ns/statement";
+}
+
+int main(int argc, char *argv[])
+{
+   std::ofstream null_out("/dev/null");
+   std::string peer = "127.0.0.1";
+
+   std::cout << "\n  -- " << CALLS_PER_THREAD << " log statements per thread --";
+
+   AsyncLog::Attach(&null_out);
+   AsyncLog::Start(LogLevel::Info);
+   show("AsyncLog, below level (disabled)", run(1, [&](int i) {
+      MPL_LOG_DEBUG("client {} connected from {} port {}", i, peer, 40000 + i);
+   }));
+   AsyncLog::Stop();
+
+   Logger logger;
+   logger.attach(&null_out);
+   logger.start();
+   show("Logger (formats on the caller)", run(1, [&](int i) {
+      logger.write("client " + Utilities::Converter<int>::toString(i) + " connected from " + peer +
+                   " port " + Utilities::Converter<int>::toString(40000 + i) + "\n");
+   }));
+   logger.stop();
+
+   for (int threads : {1, 4})
+   {
+      uint64_t dropped = AsyncLog::Dropped();
+      AsyncLog::Start(LogLevel::Debug);
+      double ns = run(threads, [&](int i) {
+         MPL_LOG_DEBUG("client {} connected from {} port {}", i, peer, 40000 + i);
+      });
+      AsyncLog::Stop();
+      show("AsyncLog, enabled, " + std::to_string(threads) + " thread(s)", ns);
+      std::cout << " (dropped " << AsyncLog::Dropped() - dropped << " of "
+                << (uint64_t)threads * CALLS_PER_THREAD << ")";
+   }
+   std::cout << std::endl;
+}
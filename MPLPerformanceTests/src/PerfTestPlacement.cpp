@@ -0,0 +1,155 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Compare unpinned and pinned runs of the same echo test (ThreadPlacement)
+   - start Listener component (thread mode, send/receive queues)
+   - start Connector components, each posting messages and reading the echoes
+   - run 1: no placement (threads migrate freely)
+   - run 2: responder and connector threads spread one per cpu over NUMA
+     node 0 (every available cpu when there is no NUMA information)
+   - eval elapsed time, message rate and throughput of each run
+   - list the thread names (as top -H shows them)
+*/
+
+#include <string>
+#include <vector>
+#include <set>
+#include <iostream>
+#include <fstream>
+#include <mpl.h>
+#include <chrono>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include <dirent.h>
+
+using namespace CSE384;
+
+const int NUM_CLIENTS = 4;
+const int NUM_MSGS = 20000;
+const int MSG_SIZE = 4096;
+
+class EchoHandler : public ClientHandler
+{
+public:
+   virtual ClientHandler *Clone()
+   {
+      return new EchoHandler();
+   }
+
+   virtual void AppProc()
+   {
+      MessagePtr msg;
+      while ((msg = GetMessage())->GetType() != MessageType::DISCONNECT)
+         PostMessage(msg);
+   }
+};
+
+// names of this process's threads (/proc/self/task/<tid>/comm)
+std::set<std::string> thread_names()
+{
+   std::set<std::string> names;
+   DIR *dir = opendir("/proc/self/task");
+   if (dir == nullptr)
+      return names;
+   while (struct dirent *entry = readdir(dir))
+   {
+      std::ifstream comm(std::string("/proc/self/task/") + entry->d_name + "/comm");
+      std::string name;
+      if (std::getline(comm, name))
+         names.insert(name);
+   }
+   closedir(dir);
+   return names;
+}
+
+void run(const std::string &mode, const ThreadPlacement &placement, int port)
+{
+   EndPoint addr("127.0.0.1", port);
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   EchoHandler handler;
+
+   TCPResponder responder(addr, &sock_opts);
+   responder.Placement(placement);
+   responder.NumClients(NUM_CLIENTS);
+   responder.RegisterClientHandler(&handler);
+   responder.Start();
+   std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+   MessagePtr msg = Message::CreateMessage(std::string(MSG_SIZE, 'p'), MessageType::DEFAULT);
+   std::vector<std::unique_ptr<TCPConnector>> conns;
+   for (int i = 0; i < NUM_CLIENTS; ++i)
+   {
+      conns.emplace_back(new TCPConnector());
+      conns.back()->Placement(placement);
+      conns.back()->Connect(addr);
+   }
+
+   std::set<std::string> names;
+   StopWatch tmr;
+   tmr.start();
+   std::vector<std::thread> readers;
+   for (auto &conn : conns)
+   {
+      TCPConnector *c = conn.get();
+      readers.push_back(std::thread([c]() {
+         for (int i = 0; i < NUM_MSGS; ++i)
+            c->GetMessage();
+      }));
+   }
+   for (int i = 0; i < NUM_MSGS; ++i)
+   {
+      for (auto &conn : conns)
+         conn->PostMessage(msg);
+      if (i == NUM_MSGS / 2)
+         names = thread_names();
+   }
+   for (auto &t : readers)
+      t.join();
+   tmr.stop();
+
+   for (auto &conn : conns)
+      conn->Close();
+   responder.Stop();
+
+   auto et = tmr.elapsed_micros();
+   double num_msgs = 2.0 * NUM_CLIENTS * NUM_MSGS;
+   std::cout << "\n  " << mode;
+   std::cout << "\n    elapsed microseconds: " << et;
+   std::cout << "\n    messages/second: " << (1.0e6 * num_msgs) / et;
+   std::cout << "\n    throughput MB/s: " << (num_msgs * MSG_SIZE) / et;
+   std::cout << "\n    threads:";
+   for (auto &name : names)
+      std::cout << " " << name;
+   std::cout << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+   std::vector<int> cpus = ThreadPlacement::NodeCpus(0);
+   if (cpus.empty())
+   {
+      for (int i = 0; i < (int)std::thread::hardware_concurrency(); ++i)
+         cpus.push_back(i);
+   }
+
+   std::cout << "\n  -- " << NUM_CLIENTS << " clients, " << NUM_MSGS << " echoes of " << MSG_SIZE
+             << " bytes each, NUMA nodes: " << ThreadPlacement::NumNodes() << ", node 0 cpus: " << cpus.size() << " --";
+
+   run("unpinned", ThreadPlacement(), 8091);
+   run("pinned (spread over node 0)", ThreadPlacement().Cpus(cpus).Spread(true), 8092);
+   std::cout << std::endl;
+}
+
+#else
+#include <iostream>
+
+int main()
+{
+   std::cout << "thread placement comparison requires Linux" << std::endl;
+}
+#endif
@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Compare the message queues between threads (no sockets)
+   - BlockingQueue (mutex + condition variable) against the lock-free rings:
+     SPSCQueue (receive queue) and MPSCQueue (send queue)
+   - paced: one message every 20 microseconds (the consumer is idle in between)
+   - burst: as fast as the producers can go (1 producer, then 4 producers)
+   - eval messages/second and enqueue -> dequeue latency percentiles
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <mpl.h>
+#include <chrono>
+
+using namespace CSE384;
+using namespace std::chrono;
+
+const int PACED_MESSAGES = 20000;
+const int PACE_MICROS = 20;
+const int BURST_MESSAGES = 1000000;
+const size_t RING_CAPACITY = 4096;
+
+int64_t now_nanos()
+{
+   return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/*---------------------------------------------------------
+  run producers against one consumer: each producer posts its own MessagePtr,
+  so the consumer knows whose send time to look up (queues are FIFO per producer)
+*/
+void run(const std::string &name, int num_producers, int per_producer, bool paced,
+         std::function<void(const MessagePtr &)> enq, std::function<MessagePtr()> deq,
+         std::function<uint64_t()> parks = nullptr)
+{
+   std::vector<MessagePtr> msgs;
+   std::vector<std::vector<int64_t>> sent(num_producers, std::vector<int64_t>(per_producer));
+   for (int p = 0; p < num_producers; ++p)
+      msgs.push_back(Message::CreateMessage(std::string(64, 'q'), MessageType::DEFAULT));
+
+   std::vector<int64_t> latency;
+   latency.reserve((size_t)num_producers * per_producer);
+
+   std::thread consumer([&]() {
+      std::vector<int> count(num_producers, 0);
+      for (int n = 0; n < num_producers * per_producer; ++n)
+      {
+         MessagePtr msg = deq();
+         int64_t t = now_nanos();
+         int p = 0;
+         while (msgs[p] != msg)
+            ++p;
+         latency.push_back(t - sent[p][count[p]++]);
+      }
+   });
+
+   StopWatch tmr;
+   tmr.start();
+   std::vector<std::thread> producers;
+   for (int p = 0; p < num_producers; ++p)
+   {
+      producers.push_back(std::thread([&, p]() {
+         for (int i = 0; i < per_producer; ++i)
+         {
+            sent[p][i] = now_nanos();
+            enq(msgs[p]);
+            if (paced)
+               std::this_thread::sleep_for(microseconds(PACE_MICROS));
+         }
+      }));
+   }
+   for (auto &t : producers)
+      t.join();
+   consumer.join();
+   tmr.stop();
+
+   std::sort(latency.begin(), latency.end());
+   auto pct = [&](double q) { return latency[(size_t)(q * (latency.size() - 1))] / 1000.0; };
+   auto et = tmr.elapsed_micros();
+
+   std::cout << "\n  " << name << " (" << num_producers << " producer" << (num_producers > 1 ? "s" : "") << ")";
+   std::cout << "\n    messages/second: " << (1.0e6 * latency.size()) / et;
+   std::cout << "\n    latency microseconds: p50 " << pct(0.5) << "  p99 " << pct(0.99)
+             << "  p99.9 " << pct(0.999) << "  max " << latency.back() / 1000.0;
+   if (parks)
+      std::cout << "\n    parked waits: " << parks();
+   std::cout << "\n";
+}
+
+void compare(bool paced, int num_producers, int per_producer)
+{
+   {
+      BlockingQueue<MessagePtr> bq;
+      run("BlockingQueue", num_producers, per_producer, paced,
+          [&](const MessagePtr &m) { bq.enQ(m); }, [&]() { return bq.deQ(); });
+   }
+
+   if (num_producers == 1)
+   {
+      SPSCQueue<MessagePtr> spsc(RING_CAPACITY);
+      run("SPSCQueue", num_producers, per_producer, paced,
+          [&](const MessagePtr &m) { spsc.enQ(m); },
+          [&]() { MessagePtr m; spsc.deQ(m); return m; },
+          [&]() { return spsc.Parks(); });
+   }
+
+   MPSCQueue<MessagePtr> mpsc(RING_CAPACITY);
+   run("MPSCQueue", num_producers, per_producer, paced,
+       [&](const MessagePtr &m) { mpsc.enQ(m); },
+       [&]() { MessagePtr m; mpsc.deQ(m); return m; },
+       [&]() { return mpsc.Parks(); });
+}
+
+int main(int argc, char *argv[])
+{
+   std::cout << "\n  -- paced: one message every " << PACE_MICROS << " microseconds --";
+   compare(true, 1, PACED_MESSAGES);
+
+   std::cout << "\n  -- burst: " << BURST_MESSAGES << " messages --";
+   compare(false, 1, BURST_MESSAGES);
+   compare(false, 4, BURST_MESSAGES / 4);
+   std::cout << std::endl;
+}
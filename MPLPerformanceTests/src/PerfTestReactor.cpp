@@ -0,0 +1,196 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Test TCPResponder reactor mode (epoll) with many connections
+   - start Listener component in reactor mode (2 I/O threads, echo handler)
+   - fork a client process (each process keeps its own descriptor limit)
+   - client: open 10000 idle connections and 1000 active connections
+   - client: a few threads run echo round trips over the active connections
+   - eval elapsed time and round trip rate
+   - server: report thread count and resident memory with every client connected
+*/
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <mpl.h>
+#include <chrono>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+using namespace CSE384;
+using namespace std::chrono;
+
+const int NUM_IDLE = 10000;
+const int NUM_ACTIVE = 1000;
+const int NUM_CLIENT_THREADS = 4;
+const int NUM_ROUNDS = 100;
+const int MSG_SIZE = 64;
+
+class EchoHandler : public ClientHandler
+{
+public:
+   virtual ClientHandler *Clone()
+   {
+      return new EchoHandler();
+   }
+
+   // not used in reactor mode
+   virtual void AppProc()
+   {
+   }
+
+   // runs on a reactor thread: queue the reply, never block
+   virtual void OnMessage(const MessagePtr &msg)
+   {
+      if (msg->GetType() != MessageType::DISCONNECT)
+         PostMessage(msg);
+   }
+};
+
+// "Threads:" / "VmRSS:" line of /proc/self/status
+std::string proc_status(const std::string &key)
+{
+   std::ifstream status("/proc/self/status");
+   std::string line;
+   while (std::getline(status, line))
+   {
+      if (line.compare(0, key.size(), key) == 0)
+         return line.substr(key.size() + 1);
+   }
+   return "?";
+}
+
+/*---------------------------------------------------------
+  client thread: pipelined echo rounds (send to every socket, then read every reply)
+*/
+void echo_rounds(std::vector<TCPClientSocket> &socks, size_t first, size_t last, std::atomic<uint64_t> &round_trips)
+{
+   MessagePtr msg = Message::CreateMessage(std::string(MSG_SIZE, 'e'), MessageType::DEFAULT);
+   size_t frame_size = MSGHEADER::SizeFor(MSG_SIZE, MessageType::DEFAULT) + MSG_SIZE;
+   std::vector<char> reply(frame_size);
+
+   for (int round = 0; round < NUM_ROUNDS; ++round)
+   {
+      for (size_t i = first; i < last; ++i)
+      {
+         IOVEC iov[2];
+         Message::GatherFrames(&msg, 1, false, iov);
+         if (socks[i].SendV(iov, 2, 0, 1) == -1)
+            return;
+      }
+      for (size_t i = first; i < last; ++i)
+      {
+         if (socks[i].Recv(reply.data(), frame_size, MSG_WAITALL, 1) != (long long)frame_size)
+            return;
+         ++round_trips;
+      }
+   }
+}
+
+void run_clients(const EndPoint &addr)
+{
+   std::vector<TCPClientSocket> idle(NUM_IDLE);
+   std::vector<TCPClientSocket> active(NUM_ACTIVE);
+   try
+   {
+      for (auto &sock : idle)
+         sock.Connect(addr);
+      for (auto &sock : active)
+         sock.Connect(addr);
+   }
+   catch (const std::exception &ex)
+   {
+      std::cerr << "\n  connect failed: " << ex.what() << std::endl;
+      return;
+   }
+
+   std::atomic<uint64_t> round_trips(0);
+   std::vector<std::thread> threads;
+   StopWatch tmr;
+   tmr.start();
+   size_t per_thread = NUM_ACTIVE / NUM_CLIENT_THREADS;
+   for (int t = 0; t < NUM_CLIENT_THREADS; ++t)
+   {
+      size_t last = (t == NUM_CLIENT_THREADS - 1) ? NUM_ACTIVE : (t + 1) * per_thread;
+      threads.push_back(std::thread(echo_rounds, std::ref(active), t * per_thread, last, std::ref(round_trips)));
+   }
+   for (auto &t : threads)
+      t.join();
+   tmr.stop();
+
+   auto et = tmr.elapsed_micros();
+   std::cout << "\n  connections: " << NUM_IDLE << " idle + " << NUM_ACTIVE << " active";
+   std::cout << "\n  elapsed microseconds: " << et;
+   std::cout << "\n  round trips: " << round_trips.load() << " (" << MSG_SIZE << " byte messages)";
+   std::cout << "\n  round trips/second: " << (1.0e6 * round_trips.load()) / et << std::endl;
+
+   for (auto &sock : active)
+      sock.Close();
+   for (auto &sock : idle)
+      sock.Close();
+}
+
+int main(int argc, char *argv[])
+{
+   const int TOTAL = NUM_IDLE + NUM_ACTIVE;
+
+   // each process needs a descriptor per connection (plus a few)
+   struct rlimit lim;
+   getrlimit(RLIMIT_NOFILE, &lim);
+   if (lim.rlim_cur < (rlim_t)TOTAL + 64)
+   {
+      lim.rlim_cur = (lim.rlim_max < (rlim_t)TOTAL + 64) ? lim.rlim_max : (rlim_t)TOTAL + 64;
+      setrlimit(RLIMIT_NOFILE, &lim);
+   }
+
+   EndPoint addr("127.0.0.1", 8083);
+
+   // fork before any threads are started
+   pid_t pid = fork();
+   if (pid == 0)
+   {
+      std::this_thread::sleep_for(milliseconds(200));
+      run_clients(addr);
+      return 0;
+   }
+
+   EchoHandler eh;
+   TCPSocketOptions sock_opts(SOL_SOCKET, (SO_REUSEADDR));
+   TCPResponder responder(addr, &sock_opts);
+   responder.UseReactor(true);
+   responder.ReactorThreads(2);
+   responder.NumClients(TOTAL);
+   responder.RegisterClientHandler(&eh);
+   responder.Start(4096);
+
+   int status;
+   while (responder.NumConnectedClients() < (size_t)TOTAL && waitpid(pid, &status, WNOHANG) == 0)
+      std::this_thread::sleep_for(milliseconds(10));
+
+   std::cout << "\n  -- reactor mode: " << responder.ReactorThreads() << " I/O threads --";
+   std::cout << "\n  server connected clients: " << responder.NumConnectedClients();
+   std::cout << "\n  server threads: " << proc_status("Threads:");
+   std::cout << "\n  server resident memory: " << proc_status("VmRSS:") << std::endl;
+
+   waitpid(pid, &status, 0);
+   responder.Stop();
+   std::cout << std::endl;
+}
+
+#else
+#include <iostream>
+
+int main()
+{
+   std::cout << "reactor mode (epoll) requires Linux" << std::endl;
+}
+#endif
@@ -0,0 +1,126 @@
+//////////////////////////////////////////////////////////////
+// C++ (MPL) Comm - Test Communication library              //
+//                                                          //
+// Mike Corley, https://github.com/mwcorley79, 22 Aug 2020  //
+//////////////////////////////////////////////////////////////
+
+/*
+   Demo:
+   Compare ThreadPool<N> (one shared blocking queue) with WorkStealingPool
+   (per thread queues, idle threads steal) on short work items (no sockets)
+   - flat: the main thread posts every work item
+   - fork/join: work items post more work items (a binary tree), as a task
+     splitting its work would
+   - eval work items/second (and steals)
+*/
+
+#include <string>
+#include <iostream>
+#include <atomic>
+#include <functional>
+#include <mpl.h>
+#include <chrono>
+
+using namespace CSE384;
+
+const size_t POOL_THREADS = 4;
+const int FLAT_ITEMS = 500000;
+const int TREE_DEPTH = 18;   // 2^19 - 1 work items
+const int SPIN = 200;        // work per item
+
+std::atomic<int> done{0};
+
+void work()
+{
+   volatile int x = 0;
+   for (int i = 0; i < SPIN; ++i)
+      x += i;
+   done.fetch_add(1);
+}
+
+void wait_for(int count)
+{
+   while (done.load() < count)
+      std::this_thread::yield();
+}
+
+void report(const std::string &name, long long et, int items, uint64_t steals = 0)
+{
+   std::cout << "\n    " << name;
+   std::cout << "\n      work items/second: " << (1.0e6 * items) / et;
+   if (steals != 0)
+      std::cout << "  (steals: " << steals << ")";
+}
+
+/*---------------------------------------------------------
+  post(item) posts one work item, for either pool
+*/
+void flat(const std::string &name, std::function<void(std::function<void()>)> post,
+          std::function<uint64_t()> steals = nullptr)
+{
+   done = 0;
+   StopWatch tmr;
+   tmr.start();
+   for (int i = 0; i < FLAT_ITEMS; ++i)
+      post(work);
+   wait_for(FLAT_ITEMS);
+   tmr.stop();
+   report(name, tmr.elapsed_micros(), FLAT_ITEMS, steals ? steals() : 0);
+}
+
+void tree(const std::string &name, std::function<void(std::function<void()>)> post,
+          std::function<uint64_t()> steals = nullptr)
+{
+   done = 0;
+   std::function<void(int)> node = [&](int depth) {
+      if (depth < TREE_DEPTH)
+      {
+         post([&node, depth]() { node(depth + 1); });
+         post([&node, depth]() { node(depth + 1); });
+      }
+      work();
+   };
+
+   int items = (1 << (TREE_DEPTH + 1)) - 1;
+   StopWatch tmr;
+   tmr.start();
+   post([&node]() { node(0); });
+   wait_for(items);
+   tmr.stop();
+   report(name, tmr.elapsed_micros(), items, steals ? steals() : 0);
+}
+
+int main(int argc, char *argv[])
+{
+   std::cout << "\n  available cores (affinity, cgroup quota): " << WorkStealingPool::AvailableCores();
+   std::cout << "\n  " << POOL_THREADS << " threads per pool, " << SPIN << " loop iterations per work item\n";
+
+   std::cout << "\n  -- flat: " << FLAT_ITEMS << " work items --";
+   {
+      ThreadPool<POOL_THREADS> pool;
+      flat("ThreadPool<" + std::to_string(POOL_THREADS) + ">",
+           [&](std::function<void()> f) { pool.workItem([f]() { f(); return true; }); });
+      pool.stop();
+      pool.wait();
+   }
+   {
+      WorkStealingPool pool(POOL_THREADS);
+      flat("WorkStealingPool", [&](std::function<void()> f) { pool.WorkItem(std::move(f)); },
+           [&]() { return pool.Steals(); });
+   }
+
+   std::cout << "\n\n  -- fork/join: " << (1 << (TREE_DEPTH + 1)) - 1 << " work items --";
+   {
+      ThreadPool<POOL_THREADS> pool;
+      tree("ThreadPool<" + std::to_string(POOL_THREADS) + ">",
+           [&](std::function<void()> f) { pool.workItem([f]() { f(); return true; }); });
+      pool.stop();
+      pool.wait();
+   }
+   {
+      WorkStealingPool pool(POOL_THREADS);
+      tree("WorkStealingPool", [&](std::function<void()> f) { pool.WorkItem(std::move(f)); },
+           [&]() { return pool.Steals(); });
+   }
+   std::cout << std::endl;
+}
@@ -0,0 +1,59 @@
+/* 
+ * File:   Chunks.h
+ *
+ * Chunked (parallel, resumable) transfers: a file is split into CHUNK_SIZE
+ * byte chunks addressed by offset, each requested and sent on any of the
+ * transfer's connections.  ChunkDigest identifies a chunk's contents, so a
+ * resumed transfer skips the chunks both copies already agree on.
+ *
+ *   FILE_STAT(name)              -> FILE_SIZE(size) | FILE_NOT_FOUND
+ *   CHUNK_REQUEST("offset length digest name")
+ *                                -> FILE_CHUNK(bytes) | CHUNK_SKIP | FILE_NOT_FOUND
+ *   (digest: of the requester's copy, 0 when it has none)
+ */
+
+#ifndef CHUNKS_H
+#define	CHUNKS_H
+
+#include <cstring>
+#include <vector>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include "FileSystemLin.h"
+#else
+#include "FileSystemWin.h"
+#endif
+
+const size_t CHUNK_SIZE = 8 * 1024 * 1024;
+const int DEFAULT_STREAMS = 4;
+
+// 64-bit digest of length bytes of a direct file from offset (moves the
+// file position); 0 when the file is shorter, never 0 otherwise
+inline unsigned long long ChunkDigest(FileSystem::File& file, long long offset, size_t length)
+{
+  const size_t BUF_SIZE = 1024 * 1024;
+  std::vector<char> buf(BUF_SIZE);
+  unsigned long long h = 0xcbf29ce484222325ULL ^ length;
+
+  file.seek(offset);
+  while (length > 0)
+  {
+    size_t n = file.readInto(&buf[0], length < BUF_SIZE ? length : BUF_SIZE);
+    if (n == 0)
+      return 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+      unsigned long long w;
+      std::memcpy(&w, &buf[i], 8);
+      h = (h ^ w) * 0x100000001b3ULL;
+      h ^= h >> 29;
+    }
+    for (; i < n; ++i)
+      h = (h ^ (unsigned char)buf[i]) * 0x100000001b3ULL;
+    length -= n;
+  }
+  return h ? h : 1;
+}
+
+#endif	/* CHUNKS_H */
@@ -15,7 +15,17 @@ enum class Commands {
                       FILE_RECV=130,
                       FILE_BLOCK=140, 
                       FILE_NOT_FOUND=150, 
-                      FILE_CLOSE=170   
+                      FILE_SIZE=160,
+                      FILE_CLOSE=170,
+                      FILE_STAT=180,
+                      CHUNK_REQUEST=190,
+                      FILE_CHUNK=200,
+                      CHUNK_SKIP=210,
+                      DELTA_REQUEST=220,
+                      DELTA_SIGNATURES=230,
+                      DELTA_LITERAL=240,
+                      DELTA_COPY=250,
+                      DELTA_END=260
                     }; 
 
 #endif	/* COMMANDS_H */
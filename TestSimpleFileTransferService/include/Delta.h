@@ -0,0 +1,211 @@
+/* 
+ * File:   Delta.h
+ *
+ * Delta (rsync style) uploads: the receiver describes the copy it has as
+ * signatures of DELTA_BLOCK byte blocks, a weak rolling sum and a strong
+ * 64-bit hash each.  The sender slides a window over its file one byte at a
+ * time, rolling the weak sum; where it matches a block (and the strong hash
+ * confirms) a block reference is sent instead of the bytes.  Only the
+ * bytes between matches travel as literal data.
+ *
+ *   DELTA_REQUEST(name)          -> DELTA_SIGNATURES(block size, signatures)
+ *   DELTA_LITERAL(bytes) | DELTA_COPY("first count") ... DELTA_END(size)
+ *
+ * The block hashing loops keep independent accumulators (no carried
+ * dependency from one byte or word to the next) so the compiler can
+ * vectorize them.
+ */
+
+#ifndef DELTA_H
+#define	DELTA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+const size_t DELTA_BLOCK = 8 * 1024;
+
+struct BlockSignature
+{
+  uint32_t weak;
+  uint64_t strong;
+};
+
+// rsync's weak sum of n bytes, the two halves before folding:
+// a = sum of the bytes, b = sum of the bytes weighted n .. 1
+inline void WeakSums(const unsigned char *p, size_t n, uint32_t &a, uint32_t &b)
+{
+  uint32_t s1 = 0, s2 = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    s1 += p[i];
+    s2 += (uint32_t)(n - i) * p[i];
+  }
+  a = s1;
+  b = s2;
+}
+
+inline uint32_t WeakSum(uint32_t a, uint32_t b)
+{
+  return (a & 0xffff) | (b << 16);
+}
+
+inline uint64_t LoadLE64(const unsigned char *p)
+{
+  uint64_t w = 0;
+  for (int i = 7; i >= 0; --i)
+    w = (w << 8) | p[i];
+  return w;
+}
+
+// 64-bit hash of n bytes: four interleaved lanes over 32 byte strides
+inline uint64_t StrongSum(const unsigned char *p, size_t n)
+{
+  const uint64_t K = 0x9e3779b97f4a7c15ULL;
+  uint64_t h[4] = { n, K, ~K, ~(uint64_t)n };
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+  {
+    for (int l = 0; l < 4; ++l)
+    {
+      h[l] = (h[l] ^ LoadLE64(p + i + 8 * l)) * K;
+      h[l] ^= h[l] >> 29;
+    }
+  }
+  for (; i < n; ++i)
+    h[0] = (h[0] ^ p[i]) * K;
+
+  uint64_t x = h[0] ^ ((h[1] << 16) | (h[1] >> 48)) ^ ((h[2] << 32) | (h[2] >> 32)) ^ ((h[3] << 48) | (h[3] >> 16));
+  x ^= x >> 31;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  return x;
+}
+
+// signatures of the whole blocks of data (a short last block is not matched)
+inline std::vector<BlockSignature> Signatures(const unsigned char *data, size_t size)
+{
+  std::vector<BlockSignature> sigs(size / DELTA_BLOCK);
+  for (size_t j = 0; j < sigs.size(); ++j)
+  {
+    const unsigned char *block = data + j * DELTA_BLOCK;
+    uint32_t a, b;
+    WeakSums(block, DELTA_BLOCK, a, b);
+    sigs[j].weak = WeakSum(a, b);
+    sigs[j].strong = StrongSum(block, DELTA_BLOCK);
+  }
+  return sigs;
+}
+
+// wire form (DELTA_SIGNATURES body): block size, then weak and strong sum
+// per block, big endian
+inline std::vector<char> EncodeSignatures(const std::vector<BlockSignature> &sigs)
+{
+  std::vector<char> out(4 + 12 * sigs.size());
+  unsigned char *p = (unsigned char *)out.data();
+  auto put = [&p](uint64_t v, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i)
+      *p++ = (unsigned char)(v >> (8 * i));
+  };
+  put(DELTA_BLOCK, 4);
+  for (const BlockSignature &s : sigs)
+  {
+    put(s.weak, 4);
+    put(s.strong, 8);
+  }
+  return out;
+}
+
+// false when the body is not signatures of DELTA_BLOCK byte blocks
+inline bool DecodeSignatures(const char *body, size_t len, std::vector<BlockSignature> &sigs)
+{
+  const unsigned char *p = (const unsigned char *)body;
+  auto get = [&p](int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+      v = (v << 8) | *p++;
+    return v;
+  };
+  if (len < 4 || (len - 4) % 12 != 0 || get(4) != DELTA_BLOCK)
+    return false;
+  sigs.resize((len - 4) / 12);
+  for (BlockSignature &s : sigs)
+  {
+    s.weak = (uint32_t)get(4);
+    s.strong = get(8);
+  }
+  return true;
+}
+
+// the delta of data against the signatures: literal(offset, length) for
+// bytes the receiver does not have, copy(first, count) for runs of its blocks
+template <typename Literal, typename Copy>
+void DeltaEncode(const unsigned char *data, size_t size, const std::vector<BlockSignature> &sigs,
+                 Literal literal, Copy copy)
+{
+  std::unordered_multimap<uint32_t, size_t> blocks(sigs.size());
+  for (size_t j = 0; j < sigs.size(); ++j)
+    blocks.emplace(sigs[j].weak, j);
+
+  size_t pos = 0, lit_start = 0;
+  size_t run_first = 0, run_count = 0;
+  uint32_t a = 0, b = 0;
+  bool have_sums = false;
+
+  while (!blocks.empty() && pos + DELTA_BLOCK <= size)
+  {
+    if (!have_sums)
+    {
+      WeakSums(data + pos, DELTA_BLOCK, a, b);
+      have_sums = true;
+    }
+
+    size_t match = sigs.size();
+    auto range = blocks.equal_range(WeakSum(a, b));
+    if (range.first != range.second)
+    {
+      uint64_t strong = StrongSum(data + pos, DELTA_BLOCK);
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        // prefer the block that continues the current run
+        if (sigs[it->second].strong == strong &&
+            (match == sigs.size() || it->second == run_first + run_count))
+          match = it->second;
+      }
+    }
+
+    if (match != sigs.size())
+    {
+      if (lit_start < pos || match != run_first + run_count)
+      {
+        if (run_count > 0)
+          copy(run_first, run_count);
+        if (lit_start < pos)
+          literal(lit_start, pos - lit_start);
+        run_first = match;
+        run_count = 0;
+      }
+      ++run_count;
+      pos += DELTA_BLOCK;
+      lit_start = pos;
+      have_sums = false;
+      continue;
+    }
+
+    // slide the window one byte
+    if (pos + DELTA_BLOCK == size)
+      break;
+    uint32_t out = data[pos], in = data[pos + DELTA_BLOCK];
+    a += in - out;
+    b += a - (uint32_t)DELTA_BLOCK * out;
+    ++pos;
+  }
+
+  if (run_count > 0)
+    copy(run_first, run_count);
+  if (lit_start < size)
+    literal(lit_start, size - lit_start);
+}
+
+#endif	/* DELTA_H */
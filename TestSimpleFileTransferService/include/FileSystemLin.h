@@ -42,6 +42,10 @@
  *   block b = f.getBlock();
  *   g.putBlock(b);
  * }
+ * File d(filespec);                  // direct: raw descriptor, no stream
+ * d.open(File::in, File::direct);
+ * size_t n = d.readInto(buffer, size);
+ * const Byte* p = d.map(size);       // or the whole file, memory mapped
  * FileInfo fi("..\foobar.txt");
  * if(fi.good())
  *   ...
@@ -67,6 +71,10 @@
  *
  * Maintenance History:
  * ====================
+ * ver 1.6 : File::sync
+ * ver 1.5 : File::update (direct files)
+ * ver 1.4 : File::direct: readInto, writeFrom, map, preallocate
+ * ver 1.3 : File::openDescriptor / closeDescriptor
  * ver 1.2 : 21 Jan 2015
  * - changed teststub contents to match new directory structure
  * - minor cleanup of code
@@ -108,8 +116,8 @@ namespace FileSystem
   class File
   {
   public:
-    enum direction { in, out };
-    enum type { text, binary };
+    enum direction { in, out, update };
+    enum type { text, binary, direct };
     File(const std::string& filespec);
     bool open(direction dirn, type typ=File::text);
     ~File();
@@ -125,6 +133,28 @@ namespace FileSystem
     static bool exists(const std::string& file);
     static bool copy(const std::string& src, const std::string& dst, bool failIfExists=false);
     static bool remove(const std::string& filespec);
+    // the file as a raw descriptor, without a stream (zero-copy transfers):
+    // -1 if it cannot be opened; out creates or truncates it, update creates
+    // it or keeps its contents (read and write)
+    static int openDescriptor(const std::string& filespec, direction dirn);
+    static void closeDescriptor(int fd);
+
+    // direct files (update: direct only): bytes move between the file and
+    // the caller's buffer at the file position, with no stream or Block in
+    // between.  Input files
+    // are read with sequential readahead hints (isGood() is false at end)
+    size_t readInto(Byte* dst, size_t size);
+    size_t writeFrom(const Byte* src, size_t size);
+    // the whole input file mapped read only (nullptr if empty or on error),
+    // valid until close()
+    const Byte* map(size_t& size);
+    // reserves disk space for size bytes without changing the file size
+    bool preallocate(size_t size);
+    // writes the file's data through to the disk
+    bool sync();
+    int descriptor();
+    long long position();
+    void seek(long long pos);
   private:
     std::string name_;
     std::ifstream* pIStream;
@@ -132,9 +162,17 @@ namespace FileSystem
     direction dirn_;
     type typ_;
     bool good_;
+    int fd_;
+    long long pos_;
+    long long ahead_;
+    void* map_;
+    size_t mapSize_;
   };
 
   inline std::string File::name() { return name_; }
+  inline int File::descriptor() { return fd_; }
+  inline long long File::position() { return pos_; }
+  inline void File::seek(long long pos) { pos_ = pos; }
 
   /////////////////////////////////////////////////////////
   // FileInfo
@@ -0,0 +1,206 @@
+/* 
+ * File:   WriteBehind.h
+ *
+ * Write-behind stage for received files: the receiving thread hands each
+ * block (a received message) to a writer thread and goes back to the
+ * socket, so disk writes overlap with receiving.  At most "budget" bytes
+ * are in flight: a receiver that gets that far ahead of the disk waits,
+ * which leaves the rest of the backlog in the TCP window instead of memory.
+ *
+ * Where io_uring is available the writer hands the blocks queued at once to
+ * the kernel as one batch of positioned writes (one system call), otherwise
+ * it writes them one by one through the file.
+ */
+
+#ifndef WRITE_BEHIND_H
+#define	WRITE_BEHIND_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <mpl.h>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include "FileSystemLin.h"
+#else
+#include "FileSystemWin.h"
+#endif
+
+class WriteBehind
+{
+public:
+  // blocks are written to a direct output file from its position on
+  WriteBehind(FileSystem::File &file, size_t budget);
+  ~WriteBehind();
+
+  // queues the body of msg after the previous block: waits while the
+  // budget is in flight (a block larger than the budget goes alone)
+  void Write(const CSE384::MessagePtr &msg);
+  // waits for the queued blocks, then syncs the file to the disk: false if
+  // a write or the sync failed
+  bool Finish();
+  // most bytes in flight at once
+  size_t HighWater() const { return high_water_; }
+  // the blocks went through io_uring (after Finish)
+  bool IoUringWrites() const { return ring_writes_; }
+
+  WriteBehind(const WriteBehind &) = delete;
+  WriteBehind &operator=(const WriteBehind &) = delete;
+
+private:
+  // blocks taken by the writer at once (io_uring submission entries)
+  static const size_t BATCH = 32;
+
+  void WriterProc();
+  // writes blocks one after the other from the file position (ring: reset
+  // to nullptr, plain writes from then on, when the kernel refuses a batch)
+  bool WriteBlocks(CSE384::IoUring *&ring, const std::vector<CSE384::MessagePtr> &blocks);
+
+  FileSystem::File &file_;
+  size_t budget_;
+  std::mutex mtx_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<CSE384::MessagePtr> blocks_;
+  size_t in_flight_;
+  size_t high_water_;
+  bool closed_;
+  bool failed_;
+  bool ring_writes_;
+  std::thread writer_;
+};
+
+inline WriteBehind::WriteBehind(FileSystem::File &file, size_t budget) : file_(file),
+                                                                         budget_(budget),
+                                                                         in_flight_(0),
+                                                                         high_water_(0),
+                                                                         closed_(false),
+                                                                         failed_(false),
+                                                                         ring_writes_(false)
+{
+  writer_ = std::thread(&WriteBehind::WriterProc, this);
+}
+
+inline WriteBehind::~WriteBehind()
+{
+  if (writer_.joinable())
+    Finish();
+}
+
+inline void WriteBehind::Write(const CSE384::MessagePtr &msg)
+{
+  std::unique_lock<std::mutex> lock(mtx_);
+  not_full_.wait(lock, [&] { return in_flight_ == 0 || in_flight_ + msg->Length() <= budget_; });
+  blocks_.push_back(msg);
+  in_flight_ += msg->Length();
+  if (in_flight_ > high_water_)
+    high_water_ = in_flight_;
+  not_empty_.notify_one();
+}
+
+inline bool WriteBehind::Finish()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    closed_ = true;
+    not_empty_.notify_one();
+  }
+  writer_.join();
+  return file_.sync() && !failed_;
+}
+
+inline void WriteBehind::WriterProc()
+{
+  // a ring of the writer's own: nullptr (plain writes) without io_uring
+  CSE384::IoUring uring;
+  CSE384::IoUring *ring = uring.Init(BATCH) ? &uring : nullptr;
+  ring_writes_ = ring != nullptr;
+
+  std::vector<CSE384::MessagePtr> batch;
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (true)
+  {
+    not_empty_.wait(lock, [&] { return !blocks_.empty() || closed_; });
+    if (blocks_.empty())
+      return;
+
+    // the blocks count against the budget until they are written
+    size_t length = 0;
+    while (!blocks_.empty() && batch.size() < BATCH)
+    {
+      length += blocks_.front()->Length();
+      batch.push_back(blocks_.front());
+      blocks_.pop_front();
+    }
+    lock.unlock();
+    bool written = WriteBlocks(ring, batch);
+    batch.clear();
+    lock.lock();
+
+    failed_ = failed_ || !written;
+    in_flight_ -= length;
+    not_full_.notify_one();
+  }
+}
+
+inline bool WriteBehind::WriteBlocks(CSE384::IoUring *&ring, const std::vector<CSE384::MessagePtr> &blocks)
+{
+  bool written = true;
+  if (ring == nullptr)
+  {
+    for (const CSE384::MessagePtr &msg : blocks)
+      written = file_.writeFrom(msg->GetData(), msg->Length()) == msg->Length() && written;
+    return written;
+  }
+
+  // every block at its own offset, submitted together
+  long long start = file_.position();
+  long long pos = start;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    ring->PrepWrite(file_.descriptor(), blocks[i]->GetData(), blocks[i]->Length(), (uint64_t)pos, i);
+    pos += (long long)blocks[i]->Length();
+  }
+  if (ring->Submit((unsigned)blocks.size()) == -1)
+  {
+    ring = nullptr;
+    ring_writes_ = false;
+    return WriteBlocks(ring, blocks);
+  }
+
+  CSE384::IoUring::Completion done[BATCH];
+  size_t reaped = 0;
+  while (reaped < blocks.size())
+  {
+    size_t n = ring->Reap(done, BATCH);
+    if (n == 0 && ring->Submit((unsigned)(blocks.size() - reaped)) == -1)
+      return false;
+    for (size_t i = 0; i < n; ++i)
+    {
+      const CSE384::MessagePtr &msg = blocks[done[i].user_data];
+      if (done[i].result < 0)
+      {
+        written = false;
+        continue;
+      }
+      // a short write: the rest of the block the plain way
+      size_t result = (size_t)done[i].result;
+      if (result < msg->Length())
+      {
+        long long offset = start;
+        for (size_t b = 0; b < done[i].user_data; ++b)
+          offset += (long long)blocks[b]->Length();
+        file_.seek(offset + (long long)result);
+        written = file_.writeFrom(msg->GetData() + result, msg->Length() - result) == msg->Length() - result && written;
+      }
+    }
+    reaped += n;
+  }
+  file_.seek(pos);
+  return written;
+}
+
+#endif	/* WRITE_BEHIND_H */
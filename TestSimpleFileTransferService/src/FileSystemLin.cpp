@@ -23,6 +23,7 @@
 #include <sys/syscall.h>
 #include <sys/stat.h>
 #include <sys/sendfile.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -31,6 +32,10 @@
 
 using namespace FileSystem;
 
+// direct input files: how far ahead of the reads the kernel is asked to
+// have the file in the page cache
+static const long long READAHEAD = 2 * 1024 * 1024;
+
 //----< block constructor taking array iterators >-------------------------
 
 Block::Block(Byte* beg, Byte* end) : bytes_(beg, end) {}
@@ -79,7 +84,8 @@ size_t Block::size() const
 //----< File constructor opens file stream >-------------------------------
 
 File::File(const std::string& filespec) 
-    : name_(filespec), pIStream(0), pOStream(0), dirn_(in), typ_(text), good_(true)
+    : name_(filespec), pIStream(0), pOStream(0), dirn_(in), typ_(text), good_(true),
+      fd_(-1), pos_(0), ahead_(0), map_(0), mapSize_(0)
 {
 }
 //----< File destructor closes file stream >-------------------------------
@@ -96,6 +102,9 @@ File::~File()
     pOStream->close();
     delete pOStream; 
   }
+  if(map_)
+    ::munmap(map_, mapSize_);
+  closeDescriptor(fd_);
 }
 //----< open for reading or writing >--------------------------------------
 
@@ -103,6 +112,18 @@ bool File::open(direction dirn, type typ)
 {
   dirn_ = dirn;
   typ_ = typ;
+  if(typ == direct)
+  {
+    fd_ = openDescriptor(name_, dirn);
+    pos_ = ahead_ = 0;
+    good_ = (fd_ != -1);
+    // sequential input: the kernel doubles its readahead window
+    if(good_ && dirn == in)
+      ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return good_;
+  }
+  if(dirn == update)
+    return (good_ = false);
   if(dirn == in)
   {
     pIStream = new std::ifstream;
@@ -200,12 +221,109 @@ void File::putBlock(const Block& blk)
     pOStream->put(blk[i]);
   }
 }
+//----< reads up to size bytes of a direct file at its position >----------
+
+size_t File::readInto(Byte* dst, size_t size)
+{
+  if(fd_ == -1)
+    throw std::runtime_error("direct file not open");
+  if(dirn_ == out)
+    throw std::runtime_error("reading output file");
+
+  // ask for the next window before the reads get there
+  if(pos_ + (long long)size > ahead_)
+  {
+    long long from = (ahead_ > pos_) ? ahead_ : pos_;
+    ahead_ = pos_ + (long long)size + READAHEAD;
+    ::posix_fadvise(fd_, from, ahead_ - from, POSIX_FADV_WILLNEED);
+  }
+
+  size_t count = 0;
+  while(count < size)
+  {
+    ssize_t n = ::pread(fd_, dst + count, size - count, pos_);
+    if(n == -1 && errno == EINTR)
+      continue;
+    if(n <= 0)
+    {
+      good_ = false;    // end of file, or error
+      break;
+    }
+    count += n;
+    pos_ += n;
+  }
+  return count;
+}
+//----< writes size bytes to a direct file at its position >---------------
+
+size_t File::writeFrom(const Byte* src, size_t size)
+{
+  if(fd_ == -1)
+    throw std::runtime_error("direct file not open");
+  if(dirn_ == in)
+    throw std::runtime_error("writing input file");
+
+  size_t count = 0;
+  while(count < size)
+  {
+    ssize_t n = ::pwrite(fd_, src + count, size - count, pos_);
+    if(n == -1 && errno == EINTR)
+      continue;
+    if(n <= 0)
+    {
+      good_ = false;
+      break;
+    }
+    count += n;
+    pos_ += n;
+  }
+  return count;
+}
+//----< maps a direct input file into memory >-----------------------------
+
+const Byte* File::map(size_t& size)
+{
+  if(fd_ == -1 || dirn_ == out)
+    throw std::runtime_error("mapping needs a direct input file");
+  if(map_ == 0)
+  {
+    struct stat st;
+    size = 0;
+    if(::fstat(fd_, &st) == -1 || st.st_size == 0)
+      return 0;
+    void* p = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(p == MAP_FAILED)
+      return 0;
+    ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+    map_ = p;
+    mapSize_ = st.st_size;
+  }
+  size = mapSize_;
+  return (const Byte*)map_;
+}
+//----< reserves disk blocks for a direct output file >--------------------
+
+bool File::preallocate(size_t size)
+{
+  if(fd_ == -1 || dirn_ == in)
+    return false;
+  // the size stays as written: a transfer cut short leaves no zero tail
+  return ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, (off_t)size) == 0;
+}
+//----< flushes a direct file to the disk >--------------------------------
+
+bool File::sync()
+{
+  return fd_ != -1 && ::fsync(fd_) == 0;
+}
 //----< tests for error free stream state >--------------------------------
 
 bool File::isGood()
 {
   if(!good_)
     return false;
+  if(typ_ == direct)
+    return fd_ != -1;
   if(pIStream)
     return (good_ = pIStream->good());
   if(pOStream)
@@ -239,6 +357,11 @@ void File::close()
     pIStream->close();
   if(pOStream)
     pOStream->close();
+  if(map_)
+    ::munmap(map_, mapSize_);
+  map_ = 0;
+  closeDescriptor(fd_);
+  fd_ = -1;
 }
 //----< file exists >--------------------------------------------------
 
@@ -284,6 +407,23 @@ bool File::remove(const std::string& file)
 {
   return std::remove(file.c_str()) != -1;
 }
+//----< open raw descriptor >------------------------------------------
+
+int File::openDescriptor(const std::string& file, direction dirn)
+{
+  if(dirn == in)
+    return ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if(dirn == update)
+    return ::open(file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  return ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+//----< close raw descriptor >-----------------------------------------
+
+void File::closeDescriptor(int fd)
+{
+  if(fd != -1)
+    ::close(fd);
+}
 //----< constructor >--------------------------------------------------
 
 FileInfo::FileInfo(const std::string& fileSpec)
@@ -943,6 +1083,18 @@ int main(int argc, char* argv[])
     }
   }
 
+  // the same copy with direct files: mapped source, preallocated destination
+
+  File from(src);
+  File to(dst);
+  if(from.open(File::in, File::direct) && to.open(File::out, File::direct))
+  {
+    size_t size;
+    const Byte* bytes = from.map(size);
+    to.preallocate(size);
+    std::cout << "\n  direct copy of " << to.writeFrom(bytes, size) << " bytes\n";
+  }
+
   // save some filespecs of text files in a vector for File demonstrations
 
   std::vector<std::string> files;
@@ -19,6 +19,9 @@
 #include <utility>
 #include <clocale>
 #include <locale>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include "FileSystemWin.h"
 
 using namespace FileSystem;
@@ -94,7 +97,8 @@ size_t Block::size() const
 //----< File constructor opens file stream >-------------------------------
 
 File::File(const std::string& filespec) 
-    : name_(filespec), pIStream(nullptr), pOStream(nullptr), dirn_(in), typ_(text), good_(true)
+    : name_(filespec), pIStream(nullptr), pOStream(nullptr), dirn_(in), typ_(text), good_(true),
+      fd_(-1), pos_(0), mapping_(NULL), map_(nullptr), mapSize_(0)
 {
 }
 //----< File destructor closes file stream >-------------------------------
@@ -115,6 +119,14 @@ File::~File()
     pOStream = nullptr;
     good_ = false;
   }
+  if (map_ != nullptr)
+    ::UnmapViewOfFile(map_);
+  map_ = nullptr;
+  if (mapping_ != NULL)
+    ::CloseHandle(mapping_);
+  mapping_ = NULL;
+  closeDescriptor(fd_);
+  fd_ = -1;
 }
 //----< open for reading or writing >--------------------------------------
 
@@ -123,6 +135,19 @@ bool File::open(direction dirn, type typ)
   dirn_ = dirn;
   typ_ = typ;
   good_ = true;
+  if(typ == direct)
+  {
+    // sequential input: the cache manager reads further ahead
+    if(dirn == in)
+      fd_ = ::_open(name_.c_str(), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL);
+    else
+      fd_ = openDescriptor(name_, dirn);
+    pos_ = 0;
+    good_ = (fd_ != -1);
+    return good_;
+  }
+  if(dirn == update)
+    return (good_ = false);
   if(dirn == in)
   {
     pIStream = new std::ifstream;
@@ -294,12 +319,117 @@ void File::putBuffer(size_t bufLen, File::byte* buffer)
       break;
   }
 }
+//----< reads up to size bytes of a direct file at its position >----------
+
+size_t File::readInto(Byte* dst, size_t size)
+{
+  if (fd_ == -1)
+    throw std::runtime_error("direct file not open");
+  if (dirn_ == out)
+    throw std::runtime_error("reading output file");
+  if (::_lseeki64(fd_, pos_, SEEK_SET) == -1)
+  {
+    good_ = false;
+    return 0;
+  }
+  size_t count = 0;
+  while (count < size)
+  {
+    size_t chunk = size - count;
+    int n = ::_read(fd_, dst + count, (unsigned)(chunk < (1u << 30) ? chunk : (1u << 30)));
+    if (n <= 0)
+    {
+      good_ = false;    // end of file, or error
+      break;
+    }
+    count += n;
+    pos_ += n;
+  }
+  return count;
+}
+//----< writes size bytes to a direct file at its position >---------------
+
+size_t File::writeFrom(const Byte* src, size_t size)
+{
+  if (fd_ == -1)
+    throw std::runtime_error("direct file not open");
+  if (dirn_ == in)
+    throw std::runtime_error("writing input file");
+  if (::_lseeki64(fd_, pos_, SEEK_SET) == -1)
+  {
+    good_ = false;
+    return 0;
+  }
+  size_t count = 0;
+  while (count < size)
+  {
+    size_t chunk = size - count;
+    int n = ::_write(fd_, src + count, (unsigned)(chunk < (1u << 30) ? chunk : (1u << 30)));
+    if (n <= 0)
+    {
+      good_ = false;
+      break;
+    }
+    count += n;
+    pos_ += n;
+  }
+  return count;
+}
+//----< maps a direct input file into memory >-----------------------------
+
+const Byte* File::map(size_t& size)
+{
+  if (fd_ == -1 || dirn_ == out)
+    throw std::runtime_error("mapping needs a direct input file");
+  if (map_ == nullptr)
+  {
+    size = 0;
+    HANDLE file = (HANDLE)::_get_osfhandle(fd_);
+    LARGE_INTEGER len;
+    if (file == INVALID_HANDLE_VALUE || !::GetFileSizeEx(file, &len) || len.QuadPart == 0)
+      return nullptr;
+    mapping_ = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_ == NULL)
+      return nullptr;
+    map_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (map_ == nullptr)
+    {
+      ::CloseHandle(mapping_);
+      mapping_ = NULL;
+      return nullptr;
+    }
+    mapSize_ = (size_t)len.QuadPart;
+  }
+  size = mapSize_;
+  return (const Byte*)map_;
+}
+//----< reserves disk blocks for a direct output file >--------------------
+
+bool File::preallocate(size_t size)
+{
+  if (fd_ == -1 || dirn_ == in)
+    return false;
+  // allocation only: the end of file stays where the writes leave it
+  FILE_ALLOCATION_INFO info;
+  info.AllocationSize.QuadPart = (LONGLONG)size;
+  HANDLE file = (HANDLE)::_get_osfhandle(fd_);
+  return file != INVALID_HANDLE_VALUE &&
+         ::SetFileInformationByHandle(file, FileAllocationInfo, &info, sizeof(info)) != 0;
+}
+//----< flushes a direct file to the disk >--------------------------------
+
+bool File::sync()
+{
+  return fd_ != -1 && ::_commit(fd_) == 0;
+}
 //----< tests for error free stream state >--------------------------------
 
 bool File::isGood()
 {
   if(!good_)
     return false;
+  if(typ_ == direct)
+    return fd_ != -1;
   if(pIStream != nullptr)
     return (good_ = pIStream->good());
   if(pOStream != nullptr)
@@ -339,6 +469,14 @@ void File::close()
     pOStream = nullptr;
     good_ = false;
   }
+  if (map_ != nullptr)
+    ::UnmapViewOfFile(map_);
+  map_ = nullptr;
+  if (mapping_ != NULL)
+    ::CloseHandle(mapping_);
+  mapping_ = NULL;
+  closeDescriptor(fd_);
+  fd_ = -1;
 }
 //----< file exists >--------------------------------------------------
 
@@ -358,6 +496,23 @@ bool File::remove(const std::string& file)
 {
   return ::DeleteFileA(file.c_str()) != 0;
 }
+//----< open raw descriptor >------------------------------------------
+
+int File::openDescriptor(const std::string& file, direction dirn)
+{
+  if(dirn == in)
+    return ::_open(file.c_str(), _O_RDONLY | _O_BINARY);
+  if(dirn == update)
+    return ::_open(file.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+  return ::_open(file.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+//----< close raw descriptor >-----------------------------------------
+
+void File::closeDescriptor(int fd)
+{
+  if(fd != -1)
+    ::_close(fd);
+}
 //----< constructor >--------------------------------------------------
 
 FileInfo::FileInfo(const std::string& fileSpec)
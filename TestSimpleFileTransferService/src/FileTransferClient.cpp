@@ -1,5 +1,9 @@
 #include <future>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <chrono>
 #include <ratio>
 #include <ctime>
@@ -15,13 +19,15 @@
 #endif
 
 #include "Commands.h"
+#include "Chunks.h"
+#include "Delta.h"
 
 using namespace CSE384;
 using namespace FileSystem;
 
-// inherits implementation of FixedSizeMsgSender to gain Fixed size messaging.
-// PostMessage(), SendPessage, GetMessage() functions etc.
-class FTSClient : private Sender
+// inherits implementation of TCPConnector to gain messaging:
+// SendMessage(), ReceiveMessage() and the file messages (direct mode)
+class FTSClient : private TCPConnector
 {
 public:
    FTSClient(const std::string &ip,
@@ -35,38 +41,46 @@ public:
    std::vector<std::string> DoGetRemoteFileList();
    void UpdateDisplay(const std::string &command, std::vector<std::string> &files);
    void DoSendFile(const std::string &filename);
+   void DoSendFileDelta(const std::string &filename);
    void DoReceiveFile(const std::string &rfile);
+   void DoReceiveFileChunked(const std::string &rfile, int streams);
    bool ProcessCommand(const std::string &command);
 
 private:
    std::string root_path_;
    EndPoint server_ep_;
    size_t msg_size_;
+   TCPSocketOptions *sock_opts_;
 };
 
 FTSClient::FTSClient(const std::string &ip,
                      int port,
                      int msg_size,
                      const std::string &rootpath,
-                     TCPSocketOptions *sock_opts) : Sender(sock_opts),
+                     TCPSocketOptions *sock_opts) : TCPConnector(sock_opts),
                                                     root_path_(rootpath),
                                                     server_ep_(ip, port),
-                                                    msg_size_(msg_size)
+                                                    msg_size_(msg_size),
+                                                    sock_opts_(sock_opts)
 
 {
+   // file blocks go straight between the file and the socket
+   UseSendReceiveQueues(false);
 }
 
 void FTSClient::DisplayMenu()
 {
    std::cout << std::endl;
    std::cout << "*********************************************************" << std::endl;
-   std::cout << "FTS Client Version 1.0 " << std::endl;
+   std::cout << "FTS Client Version 1.1 " << std::endl;
    std::cout << "Rooted (Upload/Download) Path " << root_path_ << std::endl;
    std::cout << "*********************************************************" << std::endl;
    std::cout << "L            - list files client (local)                 " << std::endl;
    std::cout << "R            - list files server (remote)                " << std::endl;
    std::cout << "G [filename] - get a file from the remote server         " << std::endl;
+   std::cout << "M [file] [n] - get a file over n connections (resumable) " << std::endl;
    std::cout << "P [filename] - put a file to the remote server           " << std::endl;
+   std::cout << "D [filename] - put a file, sending only what changed     " << std::endl;
    std::cout << "Q            - close the connection and exit             " << std::endl;
    std::cout << "*********************************************************" << std::endl;
    std::cout << "Enter command :=> ";
@@ -94,25 +108,23 @@ void FTSClient::DoClientConnection()
       }
    }
 
-   //close the sender
+   //close the connector
    Close();
 }
 
 std::vector<std::string> FTSClient::DoGetRemoteFileList()
 {
-   //file list request message
-   Message file_list_request(Message(0, 0, (int)Commands::REQUEST_FILE_LIST));
-
-   //dispatch request message to server
-   PostMessage(file_list_request);
+   //dispatch file list request message to server
+   SendMessage(Message::CreateMessage(nullptr, 0, (int)Commands::REQUEST_FILE_LIST));
 
    //receive response messages and return list of remote files
-   Message response_msg;
+   MessagePtr response_msg;
    std::vector<std::string> remote_files;
 
-   while ((response_msg = GetMessage()).GetType() != (int)(Commands::ACK_FILE_LIST))
+   while ((response_msg = ReceiveMessage())->GetType() != (int)(Commands::ACK_FILE_LIST) &&
+          response_msg->GetType() != MessageType::DISCONNECT)
    {
-      remote_files.push_back(response_msg.ToString());
+      remote_files.push_back(response_msg->ToString());
    }
 
    return remote_files;
@@ -134,9 +146,8 @@ void FTSClient::UpdateDisplay(const std::string &command, std::vector<std::strin
 void FTSClient::DoSendFile(const std::string &filename)
 {
    File file(root_path_ + filename);
-   file.open(File::in, File::binary);
 
-   if (!file.isGood())
+   if (!file.open(File::in, File::direct))
    {
       std::cout << "File: " << filename << " not found" << std::endl;
       return;
@@ -145,54 +156,287 @@ void FTSClient::DoSendFile(const std::string &filename)
    std::cout << "Uploading File: " << filename << " to " << server_ep_ << std::endl;
 
    // dispatch the file create message
-   PostMessage(Message(filename, (int)Commands::FILE_RECV));
+   SendMessage(Message::CreateMessage(filename, (int)Commands::FILE_RECV));
+
+   //the size first, so the server can reserve the disk space
+   long long size = (long long)FileInfo(root_path_ + filename).size();
+   SendMessage(Message::CreateMessage(std::to_string(size), (int)Commands::FILE_SIZE));
 
-   //dispatch file in fixed size blocks: FixedSizeMsgSender::GetMsgDataSize()
-   while (file.isGood())
+   //dispatch file in fixed size blocks (sent from the file by the kernel)
+   for (long long offset = 0; offset < size; offset += (long long)msg_size_)
    {
-      Block b = file.getBlock(msg_size_);
-      if (b.size())
-         PostMessage(Message(&b[0], (int) b.size(), (int)Commands::FILE_BLOCK));
+      size_t len = (size_t)std::min<long long>((long long)msg_size_, size - offset);
+      SendFileMessage((int)Commands::FILE_BLOCK, file.descriptor(), offset, len);
    }
 
    file.close();
 
    //dispatch the file close message
-   PostMessage(Message(0, 0, (int)Commands::FILE_CLOSE));
+   SendMessage(Message::CreateMessage(nullptr, 0, (int)Commands::FILE_CLOSE));
+
+   std::cout << "Uploaded file: " << filename << " to "
+             << server_ep_ << std::endl;
+}
+
+void FTSClient::DoSendFileDelta(const std::string &filename)
+{
+   File file(root_path_ + filename);
+
+   if (!file.open(File::in, File::direct))
+   {
+      std::cout << "File: " << filename << " not found" << std::endl;
+      return;
+   }
+   size_t size;
+   const Byte *data = file.map(size);
+   if (data == nullptr && FileInfo(root_path_ + filename).size() != 0)
+   {
+      std::cout << "File: " << filename << " could not be mapped" << std::endl;
+      return;
+   }
+
+   // the server answers with the signatures of its copy
+   SendMessage(Message::CreateMessage(filename, (int)Commands::DELTA_REQUEST));
+   MessagePtr sigs_msg = ReceiveMessage();
+   if (sigs_msg->GetType() != (int)Commands::DELTA_SIGNATURES)
+      return;
+   std::vector<BlockSignature> sigs;
+   if (!DecodeSignatures(sigs_msg->GetData(), sigs_msg->Length(), sigs))
+      sigs.clear();
+
+   std::cout << "Uploading File: " << filename << " (delta against " << sigs.size()
+             << " blocks) to " << server_ep_ << std::endl;
+
+   size_t literal = 0, copied = 0, copies = 0;
+   DeltaEncode((const unsigned char *)data, size, sigs,
+               [&](size_t offset, size_t length) {
+                  // literal bytes go from the file by the kernel, in message size pieces
+                  literal += length;
+                  for (size_t done = 0; done < length; done += msg_size_)
+                     SendFileMessage((int)Commands::DELTA_LITERAL, file.descriptor(), (long long)(offset + done),
+                                     std::min(msg_size_, length - done));
+               },
+               [&](size_t first, size_t count) {
+                  copied += count * DELTA_BLOCK;
+                  ++copies;
+                  SendMessage(Message::CreateMessage(std::to_string(first) + " " + std::to_string(count),
+                                                     (int)Commands::DELTA_COPY));
+               });
+   SendMessage(Message::CreateMessage(std::to_string(size), (int)Commands::DELTA_END));
+
+   file.close();
 
-   std::cout << "Uploaded file: " << file.name() << " to "
+   std::cout << "Uploaded file: " << filename << " to "
              << server_ep_ << std::endl;
+   std::cout << "  " << literal << " literal bytes, " << copies << " block references for "
+             << copied << " bytes, " << sigs_msg->Length() << " signature bytes: "
+             << (size ? 100.0 * (double)(literal + sigs_msg->Length()) / (double)size : 0.0)
+             << "% of the file size on the wire" << std::endl;
 }
 
 void FTSClient::DoReceiveFile(const std::string &rfile)
 {
    // dispatch the request to the server to send the remote file
-   Message file_request(rfile, (int)Commands::FILE_SEND);
-   PostMessage(file_request);
+   SendMessage(Message::CreateMessage(rfile, (int)Commands::FILE_SEND));
 
    //now receive the response from the server: (the file requested, or not found)
-   Message msg;
-   if ((msg = GetMessage()).GetType() == (int)Commands::FILE_RECV)
+   MessagePtr msg;
+   if ((msg = ReceiveMessage())->GetType() == (int)Commands::FILE_RECV)
    {
-      std::string filename = msg.ToString();
+      std::string filename = msg->ToString();
       File file(root_path_ + filename);
-      file.open(File::out, File::binary);
 
-      if (file.isGood())
+      if (file.open(File::out, File::direct))
       {
          std::cout << "Downloading File: " << filename << std::endl;
 
-         while ((msg = GetMessage()).GetType() != (int)Commands::FILE_CLOSE)
-            file.putBlock(Block(msg.GetData(), (msg.GetData() + msg.Length())));
+         //file blocks are written into the file by the kernel
+         size_t written;
+         while ((msg = ReceiveFileMessage((int)Commands::FILE_BLOCK, file.descriptor(), file.position(), written))->GetType() != (int)Commands::FILE_CLOSE &&
+                msg->GetType() != MessageType::DISCONNECT)
+         {
+            if (msg->GetType() == (int)Commands::FILE_SIZE)
+               file.preallocate(std::stoull(msg->ToString()));
+            file.seek(file.position() + (long long)written);
+         }
          file.close();
 
          std::cout << "Downloaded file: " << root_path_ + filename << std::endl;
       }
+      else
+      {
+         std::cout << "Could not create file: " << filename << std::endl;
+         while ((msg = ReceiveMessage())->GetType() != (int)Commands::FILE_CLOSE &&
+                msg->GetType() != MessageType::DISCONNECT)
+            ;
+      }
+   }
+   else if (msg->GetType() == (int)Commands::FILE_NOT_FOUND)
+   {
+      std::cout << "Response from Server: " << msg->ToString() << std::endl;
+   }
+}
+
+// chunks (indexes) of file the journal records as written, empty when there
+// is no journal or it belongs to another version of the file
+static std::set<size_t> ReadJournal(const std::string &journal_path, long long size)
+{
+   std::set<size_t> done;
+   std::ifstream journal(journal_path);
+   long long jsize = -1;
+   size_t jchunk = 0, index;
+   if (!(journal >> jsize >> jchunk) || jsize != size || jchunk != CHUNK_SIZE)
+      return done;
+   while (journal >> index)
+      done.insert(index);
+   return done;
+}
+
+void FTSClient::DoReceiveFileChunked(const std::string &rfile, int streams)
+{
+   SendMessage(Message::CreateMessage(rfile, (int)Commands::FILE_STAT));
+   MessagePtr msg = ReceiveMessage();
+   if (msg->GetType() != (int)Commands::FILE_SIZE)
+   {
+      if (msg->GetType() == (int)Commands::FILE_NOT_FOUND)
+         std::cout << "Response from Server: " << msg->ToString() << std::endl;
+      return;
+   }
+   long long size = std::stoll(msg->ToString());
+   size_t chunks = (size_t)((size + (long long)CHUNK_SIZE - 1) / (long long)CHUNK_SIZE);
+
+   // the journal lists the chunks written so far: it outlives an interrupted
+   // transfer, and is removed when the file is complete
+   std::string path = root_path_ + rfile;
+   std::string journal_path = path + ".part";
+   std::set<size_t> done = ReadJournal(journal_path, size);
+
+   File file(path);
+   if (!file.open(done.empty() ? File::out : File::update, File::direct))
+   {
+      std::cout << "Could not create file: " << rfile << std::endl;
+      return;
+   }
+   file.preallocate((size_t)size);
+
+   std::ofstream journal;
+   if (done.empty())
+   {
+      journal.open(journal_path, std::ios::out | std::ios::trunc);
+      journal << size << " " << CHUNK_SIZE << std::endl;
+   }
+   else
+      journal.open(journal_path, std::ios::out | std::ios::app);
+
+   // the digest of each chunk we have already, for the server to verify
+   std::vector<unsigned long long> digests(chunks, 0);
+   for (size_t index : done)
+   {
+      if (index >= chunks)
+         continue;
+      long long offset = (long long)index * (long long)CHUNK_SIZE;
+      digests[index] = ChunkDigest(file, offset, (size_t)std::min<long long>((long long)CHUNK_SIZE, size - offset));
    }
-   else if (msg.GetType() == (int)Commands::FILE_NOT_FOUND)
+
+   std::cout << "Downloading File: " << rfile << " (" << chunks << " chunks, "
+             << done.size() << " to verify) over " << streams << " connections" << std::endl;
+
+   std::atomic<size_t> next(0);
+   std::atomic<size_t> skipped(0);
+   std::atomic<long long> received(0);
+   std::atomic<bool> failed(false);
+   std::mutex journal_mtx;
+
+   // each connection takes the next chunk not requested yet: chunks arrive
+   // out of order, written where they belong in the file.  Every connection
+   // writes through a descriptor of its own (where positioned writes are a
+   // seek and a write, a shared descriptor would put chunks at wrong offsets)
+   auto receive_chunks = [&]() {
+      TCPConnector conn(sock_opts_);
+      conn.UseSendReceiveQueues(false);
+      File part(path);
+      try
+      {
+         if (!part.open(File::update, File::direct))
+         {
+            std::cout << "Could not open file: " << rfile << std::endl;
+            failed.store(true);
+            return;
+         }
+         conn.Connect(server_ep_);
+         size_t index;
+         while (!failed.load() && (index = next++) < chunks)
+         {
+            long long offset = (long long)index * (long long)CHUNK_SIZE;
+            size_t length = (size_t)std::min<long long>((long long)CHUNK_SIZE, size - offset);
+            conn.SendMessage(Message::CreateMessage(std::to_string(offset) + " " + std::to_string(length) + " " +
+                                                    std::to_string(digests[index]) + " " + rfile,
+                                                    (int)Commands::CHUNK_REQUEST));
+            // a longer body would overwrite the next chunk: refused before it is written
+            size_t written;
+            MessagePtr reply = conn.ReceiveFileMessage((int)Commands::FILE_CHUNK, part.descriptor(), offset, written, length);
+            if (reply->GetType() == (int)Commands::CHUNK_SKIP)
+            {
+               ++skipped;
+               continue;
+            }
+            if (reply->GetType() != (int)Commands::FILE_CHUNK)
+            {
+               if (reply->GetType() == (int)Commands::FILE_NOT_FOUND)
+                  std::cout << "Response from Server: " << reply->ToString() << std::endl;
+               failed.store(true);
+               break;
+            }
+            // a short chunk leaves a hole: not journaled as done
+            if (written != length)
+            {
+               std::cout << "Chunk " << index << ": " << written << " of " << length << " bytes" << std::endl;
+               failed.store(true);
+               break;
+            }
+            received += (long long)written;
+            std::lock_guard<std::mutex> lock(journal_mtx);
+            journal << index << std::endl;
+         }
+      }
+      catch (std::exception &ex)
+      {
+         std::cout << "Chunk connection: " << ex.what() << std::endl;
+         failed.store(true);
+      }
+      conn.Close();
+      part.close();
+   };
+
+   std::chrono::high_resolution_clock::time_point start =
+       std::chrono::high_resolution_clock::now();
+
+   std::vector<std::thread> threads;
+   for (int i = 0; i < streams; ++i)
+      threads.push_back(std::thread(receive_chunks));
+   for (auto &t : threads)
+      t.join();
+
+   std::chrono::high_resolution_clock::time_point stop =
+       std::chrono::high_resolution_clock::now();
+   std::chrono::duration<double> time_span =
+       std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
+
+   file.close();
+   journal.close();
+
+   if (failed.load())
    {
-      std::cout << "Response from Server: " << msg.ToString() << std::endl;
+      std::cout << "Download of " << rfile << " interrupted: repeat the command to resume" << std::endl;
+      return;
    }
+   File::remove(journal_path);
+
+   std::cout << "Downloaded file: " << path << std::endl;
+   std::cout << "  " << received.load() << " bytes in " << (chunks - skipped.load()) << " chunks, "
+             << skipped.load() << " chunks verified and skipped" << std::endl;
+   std::cout << "  Throughput:= " << (double)received.load() / time_span.count() / (1024 * 1024)
+             << " MB/s over " << streams << " connections" << std::endl;
 }
 
 bool FTSClient::ProcessCommand(const std::string &command)
@@ -200,6 +444,9 @@ bool FTSClient::ProcessCommand(const std::string &command)
    std::istringstream iss(command);
    std::string cmd, arg = "none";
    iss >> cmd >> arg;
+   int streams;
+   if (!(iss >> streams) || streams < 1)
+      streams = DEFAULT_STREAMS;
    for (int i = 0; i < cmd.length(); ++i)
       cmd[i] = std::toupper(cmd[i]);
 
@@ -228,6 +475,30 @@ bool FTSClient::ProcessCommand(const std::string &command)
           std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
       std::cout << "  Latency:= " << time_span.count() << std::endl;
    }
+   else if (cmd == "M" && arg != "none")
+   {
+      std::chrono::high_resolution_clock::time_point start =
+          std::chrono::high_resolution_clock::now();
+      DoReceiveFileChunked(arg, streams); // *** receive the file in parallel chunks
+
+      std::chrono::high_resolution_clock::time_point stop =
+          std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> time_span =
+          std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
+      std::cout << "  Latency:= " << time_span.count() << std::endl;
+   }
+   else if (cmd == "D" && arg != "none")
+   {
+      std::chrono::high_resolution_clock::time_point start =
+          std::chrono::high_resolution_clock::now();
+      DoSendFileDelta(arg); // *** send what changed in the file
+
+      std::chrono::high_resolution_clock::time_point stop =
+          std::chrono::high_resolution_clock::now();
+      std::chrono::duration<double> time_span =
+          std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
+      std::cout << "  Latency:= " << time_span.count() << std::endl;
+   }
    else if (cmd == "P" && arg != "none")
    {
       std::chrono::high_resolution_clock::time_point start =
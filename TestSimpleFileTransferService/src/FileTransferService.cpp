@@ -7,22 +7,31 @@
 #endif
 
 #include "Commands.h"
+#include "Chunks.h"
+#include "Delta.h"
+#include "WriteBehind.h"
+#include <memory>
 #include <sstream>
 
 using namespace CSE384;
 using namespace FileSystem;
 
 // extend ClientHandler to get server processing
+// file blocks go straight between the socket and the file (SendFileMessage /
+// ReceiveFileMessage), so the handler runs without send and receive queues
 class FTSClientHandler : public ClientHandler
 {
 public:
-  FTSClientHandler(const std::string &root_path, size_t msg_size);
+  FTSClientHandler(const std::string &root_path, size_t msg_size, size_t write_behind);
   virtual ~FTSClientHandler();
 
   void DoSendFileList();
   void DoReceiveFile(const std::string &filename);
   void DoSendFile(const std::string &filename);
-  void ProcessCommand(Message &msg);
+  void DoSendFileSize(const std::string &filename);
+  void DoSendChunk(const std::string &request);
+  void DoReceiveDelta(const std::string &filename);
+  void ProcessCommand(const MessagePtr &msg);
 
   virtual void AppProc();
   virtual ClientHandler *Clone();
@@ -30,17 +39,24 @@ public:
 private:
   std::string root_path_;
   size_t msg_size_;
+  // upload bytes in flight to the disk writer, 0: spliced into the file
+  size_t write_behind_;
+  // the file chunks are requested from, open across requests
+  std::unique_ptr<File> chunk_file_;
+  long long chunk_file_size_;
 };
 
-FTSClientHandler::FTSClientHandler(const std::string &root_path, size_t msg_size) : root_path_(root_path),
-                                                                                    msg_size_(msg_size)
+FTSClientHandler::FTSClientHandler(const std::string &root_path, size_t msg_size, size_t write_behind) : root_path_(root_path),
+                                                                                                         msg_size_(msg_size),
+                                                                                                         write_behind_(write_behind),
+                                                                                                         chunk_file_size_(0)
 {
 }
 
 // need to implement Clone() to enable Receiver to instances on a per client basis
 ClientHandler *FTSClientHandler::Clone()
 {
-  return new FTSClientHandler(root_path_, msg_size_);
+  return new FTSClientHandler(root_path_, msg_size_, write_behind_);
 }
 
 FTSClientHandler::~FTSClientHandler()
@@ -52,86 +68,271 @@ void FTSClientHandler::DoSendFileList()
 {
   std::vector<std::string> local_files = Directory::getFiles(root_path_, "*.*");
   for(auto f : local_files)
-     PostMessage(Message(f, (int)Commands::REQUEST_FILE_LIST));
-  PostMessage(Message(0, (int)Commands::ACK_FILE_LIST));
+     SendMessage(Message::CreateMessage(f, (int)Commands::REQUEST_FILE_LIST));
+  SendMessage(Message::CreateMessage(nullptr, 0, (int)Commands::ACK_FILE_LIST));
 }
 
 void FTSClientHandler::DoReceiveFile(const std::string &filename)
 {
-  Message msg;
+  MessagePtr msg;
 
   File file(root_path_ + filename);
-  file.open(File::out, File::binary);
-
-  if (file.isGood())
+  if (!file.open(File::out, File::direct))
   {
-    std::cout << "Uploading file from: " << filename
-              << " from client: " << RemoteEP()
-              << std::endl;
+    std::cout << "Could not create file: " << filename << std::endl;
 
-    Byte *begin, *end;
+    // skip the blocks the client sends anyway
+    while ((msg = ReceiveMessage())->GetType() != (int)Commands::FILE_CLOSE &&
+           msg->GetType() != MessageType::DISCONNECT)
+      ;
+    return;
+  }
 
-    //receive file blocks until client sends FILE_CLOSE message type
-    while ((msg = GetMessage()).GetType() != (int)Commands::FILE_CLOSE)
-    {
-      Message &file_block = msg;
-      begin = file_block.GetData();
-      end = (file_block.GetData() + file_block.Length());
-      file.putBlock(Block(begin, end));
-    }
+  std::cout << "Uploading file from: " << filename
+            << " from client: " << RemoteEP()
+            << std::endl;
 
-    file.close();
+  std::chrono::high_resolution_clock::time_point start =
+      std::chrono::high_resolution_clock::now();
 
-    std::cout << "Successfully Uploaded file: "
-              << filename << " from client: " << RemoteEP()
-              << std::endl;
+  //receive file blocks until client sends FILE_CLOSE message type, then
+  //make the file durable
+  bool synced;
+  size_t high_water = 0;
+  bool ring_writes = false;
+  if (write_behind_ > 0)
+  {
+    //blocks are received here and written on the writer's thread
+    WriteBehind writer(file, write_behind_);
+    while ((msg = ReceiveMessage())->GetType() != (int)Commands::FILE_CLOSE &&
+           msg->GetType() != MessageType::DISCONNECT)
+    {
+      if (msg->GetType() == (int)Commands::FILE_SIZE)
+        file.preallocate(std::stoull(msg->ToString()));
+      else if (msg->GetType() == (int)Commands::FILE_BLOCK)
+        writer.Write(msg);
+    }
+    synced = writer.Finish();
+    high_water = writer.HighWater();
+    ring_writes = writer.IoUringWrites();
   }
   else
   {
-    std::cout << "Could not create file: " << filename << std::endl;
+    //blocks are spliced from the socket into the file
+    size_t written;
+    while ((msg = ReceiveFileMessage((int)Commands::FILE_BLOCK, file.descriptor(), file.position(), written))->GetType() != (int)Commands::FILE_CLOSE &&
+           msg->GetType() != MessageType::DISCONNECT)
+    {
+      if (msg->GetType() == (int)Commands::FILE_SIZE)
+        file.preallocate(std::stoull(msg->ToString()));
+      file.seek(file.position() + (long long)written);
+    }
+    synced = file.sync();
   }
+
+  std::chrono::high_resolution_clock::time_point stop =
+      std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> time_span =
+      std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
+
+  long long size = file.position();
+  file.close();
+
+  if (msg->GetType() == MessageType::DISCONNECT)
+  {
+    std::cout << "Upload of file: " << filename << " interrupted by client: " << RemoteEP()
+              << " after " << size << " bytes" << std::endl;
+    return;
+  }
+
+  std::cout << "Successfully Uploaded file: "
+            << filename << " from client: " << RemoteEP()
+            << std::endl;
+  std::cout << "  " << size << " bytes, " << (synced ? "synced to disk" : "write or sync FAILED")
+            << ", Throughput:= " << (double)size / time_span.count() / (1024 * 1024) << " MB/s";
+  if (write_behind_ > 0)
+    std::cout << ", write-behind high-water: " << high_water << " of " << write_behind_ << " bytes"
+              << (ring_writes ? " (io_uring)" : "");
+  std::cout << std::endl;
 }
 
 void FTSClientHandler::DoSendFile(const std::string &filename)
 {
   File file(root_path_ + filename);
-  file.open(File::in, File::binary);
 
-  if (!file.isGood())
+  if (!file.open(File::in, File::direct))
   {
     std::string response_msg = std::string("File: ") + filename + std::string(" not found");
     std::cout << response_msg << std::endl;
-    PostMessage(Message(response_msg, (int)Commands::FILE_NOT_FOUND));
+    SendMessage(Message::CreateMessage(response_msg, (int)Commands::FILE_NOT_FOUND));
     return;
   }
 
   std::cout << "Sending file: " << filename
             << " to " << RemoteEP() << std::endl;
 
-  PostMessage(Message(filename, (int)Commands::FILE_RECV));
+  SendMessage(Message::CreateMessage(filename, (int)Commands::FILE_RECV));
+
+  //the size first, so the client can reserve the disk space
+  long long size = (long long)FileInfo(root_path_ + filename).size();
+  SendMessage(Message::CreateMessage(std::to_string(size), (int)Commands::FILE_SIZE));
 
-  while (file.isGood())
+  //chuck the file over the channel in fixed size messages
+  for (long long offset = 0; offset < size; offset += (long long)msg_size_)
   {
-    //chuck the file over the channel in fixed size messages
-    Block b = file.getBlock(msg_size_);
-    PostMessage(Message(&b[0], (int) b.size(), (int)Commands::FILE_BLOCK));
-    std::cout << "Sent block of size: " << b.size()
-              << " bytes\n"
-              << std::endl;
+    size_t len = (size_t)std::min<long long>((long long)msg_size_, size - offset);
+    SendFileMessage((int)Commands::FILE_BLOCK, file.descriptor(), offset, len);
   }
 
   file.close();
 
   //done, so send the FILE_CLOSE message
-  PostMessage(Message(0, 0, (int)Commands::FILE_CLOSE));
+  SendMessage(Message::CreateMessage(nullptr, 0, (int)Commands::FILE_CLOSE));
 
-  std::cout << "Sent File: " << file.name()
-            << " to " << RemoteEP() << std::endl;
+  std::cout << "Sent File: " << filename
+            << " (" << size << " bytes) to " << RemoteEP() << std::endl;
+}
+
+void FTSClientHandler::DoSendFileSize(const std::string &filename)
+{
+  File file(root_path_ + filename);
+  if (!file.open(File::in, File::direct))
+  {
+    std::string response_msg = std::string("File: ") + filename + std::string(" not found");
+    SendMessage(Message::CreateMessage(response_msg, (int)Commands::FILE_NOT_FOUND));
+    return;
+  }
+  std::string size = std::to_string(FileInfo(root_path_ + filename).size());
+  SendMessage(Message::CreateMessage(size, (int)Commands::FILE_SIZE));
 }
 
-void FTSClientHandler::ProcessCommand(Message &msg)
+void FTSClientHandler::DoSendChunk(const std::string &request)
 {
-  switch ((Commands)msg.GetType())
+  // "offset length digest filename"
+  std::istringstream iss(request);
+  long long offset = -1;
+  size_t length = 0;
+  unsigned long long digest = 0;
+  std::string filename;
+  if (!(iss >> offset >> length >> digest) || iss.get() != ' ' || !std::getline(iss, filename) || filename.empty())
+  {
+    SendMessage(Message::CreateMessage(std::string("Malformed chunk request"), (int)Commands::FILE_NOT_FOUND));
+    return;
+  }
+
+  if (chunk_file_ == nullptr || chunk_file_->name() != root_path_ + filename)
+  {
+    chunk_file_.reset(new File(root_path_ + filename));
+    if (!chunk_file_->open(File::in, File::direct))
+    {
+      chunk_file_.reset();
+      std::string response_msg = std::string("File: ") + filename + std::string(" not found");
+      SendMessage(Message::CreateMessage(response_msg, (int)Commands::FILE_NOT_FOUND));
+      return;
+    }
+    chunk_file_size_ = (long long)FileInfo(root_path_ + filename).size();
+  }
+
+  // (the length is compared with what is left: offset + length could overflow)
+  if (offset < 0 || offset > chunk_file_size_ || length > (size_t)(chunk_file_size_ - offset))
+  {
+    std::string response_msg = std::string("File: ") + filename + std::string(" has no such chunk");
+    SendMessage(Message::CreateMessage(response_msg, (int)Commands::FILE_NOT_FOUND));
+    return;
+  }
+
+  // the client has this chunk from an interrupted transfer: send it only
+  // when the two copies differ
+  if (digest != 0 && ChunkDigest(*chunk_file_, offset, length) == digest)
+  {
+    SendMessage(Message::CreateMessage(nullptr, 0, (int)Commands::CHUNK_SKIP));
+    return;
+  }
+  SendFileMessage((int)Commands::FILE_CHUNK, chunk_file_->descriptor(), offset, length);
+}
+
+void FTSClientHandler::DoReceiveDelta(const std::string &filename)
+{
+  std::string path = root_path_ + filename;
+
+  // signatures of the copy we have (none for a new file)
+  File old_file(path);
+  size_t old_size = 0;
+  const Byte *old_data = nullptr;
+  if (old_file.open(File::in, File::direct))
+    old_data = old_file.map(old_size);
+  std::vector<char> sigs = EncodeSignatures(old_data ? Signatures((const unsigned char *)old_data, old_size)
+                                                     : std::vector<BlockSignature>());
+  SendMessage(Message::CreateMessage(sigs.data(), sigs.size(), (int)Commands::DELTA_SIGNATURES));
+
+  // the new version is built next to the old one, then replaces it
+  File new_file(path + ".delta");
+  bool good = new_file.open(File::out, File::direct);
+  if (!good)
+    std::cout << "Could not create file: " << filename << ".delta" << std::endl;
+
+  std::cout << "Uploading file (delta against " << old_size << " bytes): " << filename
+            << " from client: " << RemoteEP()
+            << std::endl;
+
+  long long literal = 0, copied = 0;
+  MessagePtr msg;
+  while ((msg = ReceiveMessage())->GetType() != (int)Commands::DELTA_END &&
+         msg->GetType() != MessageType::DISCONNECT)
+  {
+    if (!good)
+      continue;
+    if (msg->GetType() == (int)Commands::DELTA_LITERAL)
+    {
+      good = new_file.writeFrom(msg->GetData(), msg->Length()) == msg->Length();
+      literal += (long long)msg->Length();
+    }
+    else if (msg->GetType() == (int)Commands::DELTA_COPY)
+    {
+      // "first count": a run of blocks of the old copy
+      std::istringstream iss(msg->ToString());
+      size_t first = 0, count = 0;
+      iss >> first >> count;
+      if (first > old_size / DELTA_BLOCK || count > old_size / DELTA_BLOCK - first)
+      {
+        good = false;
+        continue;
+      }
+      size_t length = count * DELTA_BLOCK;
+      good = new_file.writeFrom(old_data + first * DELTA_BLOCK, length) == length;
+      copied += (long long)length;
+    }
+  }
+
+  bool complete = good && msg->GetType() == (int)Commands::DELTA_END &&
+                  new_file.position() == std::stoll(msg->ToString()) && new_file.sync();
+  new_file.close();
+  old_file.close();
+
+  if (!complete)
+  {
+    File::remove(path + ".delta");
+    std::cout << "Upload of file: " << filename << " from client: " << RemoteEP()
+              << " failed, the old copy is kept" << std::endl;
+    return;
+  }
+
+  // rename replaces the old copy in one step on POSIX; Windows wants it gone first
+  if (std::rename((path + ".delta").c_str(), path.c_str()) != 0)
+  {
+    File::remove(path);
+    std::rename((path + ".delta").c_str(), path.c_str());
+  }
+
+  std::cout << "Successfully Uploaded file: "
+            << filename << " from client: " << RemoteEP()
+            << std::endl;
+  std::cout << "  " << literal << " literal bytes, " << copied << " bytes from the old copy" << std::endl;
+}
+
+void FTSClientHandler::ProcessCommand(const MessagePtr &msg)
+{
+  switch ((Commands)msg->GetType())
   {
   case Commands::REQUEST_FILE_LIST:
   {
@@ -141,7 +342,7 @@ void FTSClientHandler::ProcessCommand(Message &msg)
 
   case Commands::FILE_SEND:
   {
-    std::string filename = msg.ToString();
+    std::string filename = msg->ToString();
 
     std::chrono::high_resolution_clock::time_point start =
         std::chrono::high_resolution_clock::now();
@@ -157,7 +358,7 @@ void FTSClientHandler::ProcessCommand(Message &msg)
 
   case Commands::FILE_RECV:
   {
-    std::string filename = msg.ToString();
+    std::string filename = msg->ToString();
 
     std::chrono::high_resolution_clock::time_point start =
         std::chrono::high_resolution_clock::now();
@@ -169,14 +370,46 @@ void FTSClientHandler::ProcessCommand(Message &msg)
         std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
     std::cout << "  Latency:= " << time_span.count() << std::endl;
   }
+  break;
+
+  case Commands::FILE_STAT:
+  {
+    DoSendFileSize(msg->ToString());
+  }
+  break;
+
+  case Commands::CHUNK_REQUEST:
+  {
+    DoSendChunk(msg->ToString());
+  }
+  break;
+
+  case Commands::DELTA_REQUEST:
+  {
+    std::string filename = msg->ToString();
+
+    std::chrono::high_resolution_clock::time_point start =
+        std::chrono::high_resolution_clock::now();
+    DoReceiveDelta(filename);
+
+    std::chrono::high_resolution_clock::time_point stop =
+        std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> time_span =
+        std::chrono::duration_cast<std::chrono::duration<double>>(stop - start);
+    std::cout << "  Latency:= " << time_span.count() << std::endl;
+  }
+  break;
+
+  default:
+  break;
   }
 }
 
 void FTSClientHandler::AppProc()
 {
-  Message msg;
+  MessagePtr msg;
   // sout << locked << "Connection from: "<< RemoteEP() << MPL::endl << unlocked;
-  while ((msg = GetMessage()).GetType() != MessageType::DISCONNECT)
+  while ((msg = ReceiveMessage())->GetType() != MessageType::DISCONNECT)
     ProcessCommand(msg);
 }
 
@@ -184,14 +417,16 @@ void FTSClientHandler::AppProc()
 int main(int argc, char *argv[])
 {
 
-  if (argc != 5)
+  if (argc != 5 && argc != 6)
   {
-    std::cout << "Usage:  fts_server  IP-address   Port   Msg-Size   [Upload-Download-Directory] " << std::endl;
+    std::cout << "Usage:  fts_server  IP-address   Port   Msg-Size   [Upload-Download-Directory] "
+              << "[Write-Behind-KB (default 16384, 0: splice uploads into the file)]" << std::endl;
     return 0;
   }
   EndPoint ep(argv[1], std::stoi(argv[2]));
   int msg_size = std::stoi(argv[3]);
   std::string root_path = std::string(argv[4]);
+  size_t write_behind = (argc == 6) ? std::stoul(argv[5]) * 1024 : 16 * 1024 * 1024;
 
   //set SO_REUSEADDR socket option
   TCPSocketOptions sock_opts(SOL_SOCKET, SO_REUSEADDR);
@@ -199,17 +434,21 @@ int main(int argc, char *argv[])
     root_path += std::string("/");
 
   std::cout << "*************************************************************\n";
-  std::cout << "********* File Transfer Service Version 1.0 **************** \n";
+  std::cout << "********* File Transfer Service Version 1.1 **************** \n";
   std::cout << "*************************************************************\n";
   std::cout << "Rooted (Upload/Download) Path " << root_path << "\n";
+  std::cout << "Upload write-behind budget " << write_behind << " bytes\n";
 
-  // create the and start the Receiver running with a ClientHandler
-  FTSClientHandler fts_ch(root_path, (size_t) msg_size);
+  // create the and start the TCPResponder running with a ClientHandler
+  FTSClientHandler fts_ch(root_path, (size_t) msg_size, write_behind);
 
-  Receiver recv(ep, &sock_opts);
-  recv.RegisterClientHandler(&fts_ch);
+  TCPResponder responder(ep, &sock_opts);
+  // direct mode: SendMessage/ReceiveMessage (and the file messages)
+  responder.UseClientSendReceiveQueues(false);
+  responder.RegisterClientHandler(&fts_ch);
 
-  recv.Start();
-  //recv.Stop();
+  responder.Start();
+  // serves clients until the process is killed
+  responder.Stop();
 }
 #endif
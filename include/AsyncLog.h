@@ -0,0 +1,257 @@
+/////////////////////////////////////////////////////////////////////////////
+// AsyncLog.h - low overhead asynchronous logging with levels              //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  Logging meant to stay enabled on hot paths (Logger.h formats on the
+ *  calling thread and funnels every message through one mutex guarded queue):
+ *  - levels are filtered twice: MPL_LOG_COMPILE_LEVEL removes lower level
+ *    statements at compile time (0 trace .. 4 error, 5 off), and a statement
+ *    below the runtime Level() (or while the logger is not started) costs one
+ *    relaxed atomic load, its arguments are not even evaluated
+ *  - formatting is deferred: the calling thread copies the raw arguments
+ *    (numbers, pointers, string text up to LogText::MAX_LEN characters) into a
+ *    fixed size record, the logger thread formats it
+ *  - every logging thread has its own lock-free ring (SPSCQueue), so threads
+ *    never contend with each other.  A full ring drops the record (counted by
+ *    Dropped()) rather than block the caller
+ *
+ *  USAGE:  AsyncLog::Attach(&std::cout);
+ *          AsyncLog::Start(LogLevel::Debug);
+ *          MPL_LOG_DEBUG("client {} connected from port {}", id, port);
+ *          AsyncLog::Stop();      // writes everything logged so far
+ *
+ *  "{}" is replaced by the next argument.  Output lines look like
+ *  "12:04:01.123456 DEBUG [t3] client 7 connected from port 40212" (UTC time
+ *  of day, t<N>: the logging thread).  The format must be a string literal (it
+ *  is kept by pointer).
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _ASYNC_LOG_H_
+#define _ASYNC_LOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+// lowest level compiled in: 0 trace, 1 debug, 2 info, 3 warn, 4 error, 5 off
+#ifndef MPL_LOG_COMPILE_LEVEL
+#define MPL_LOG_COMPILE_LEVEL 1
+#endif
+
+#define MPL_LOG(level, ...)                                      \
+    do                                                           \
+    {                                                            \
+        if constexpr ((int)(level) >= MPL_LOG_COMPILE_LEVEL)     \
+        {                                                        \
+            if (CSE384::AsyncLog::Enabled(level))                \
+                CSE384::AsyncLog::Write((level), __VA_ARGS__);   \
+        }                                                        \
+    } while (0)
+
+#define MPL_LOG_TRACE(...) MPL_LOG(CSE384::LogLevel::Trace, __VA_ARGS__)
+#define MPL_LOG_DEBUG(...) MPL_LOG(CSE384::LogLevel::Debug, __VA_ARGS__)
+#define MPL_LOG_INFO(...) MPL_LOG(CSE384::LogLevel::Info, __VA_ARGS__)
+#define MPL_LOG_WARN(...) MPL_LOG(CSE384::LogLevel::Warn, __VA_ARGS__)
+#define MPL_LOG_ERROR(...) MPL_LOG(CSE384::LogLevel::Error, __VA_ARGS__)
+
+namespace CSE384
+{
+    enum class LogLevel
+    {
+        Trace,
+        Debug,
+        Info,
+        Warn,
+        Error,
+        Off
+    };
+
+    // string argument, copied (longer text is cut at MAX_LEN characters)
+    struct LogText
+    {
+        static const size_t MAX_LEN = 62;
+        unsigned char len;
+        char text[MAX_LEN + 1];
+    };
+
+    std::ostream &operator<<(std::ostream &out, const LogText &t);
+
+    // how an argument is stored in a record: numbers, enums and pointers as
+    // they are, strings as LogText
+    template <typename T, typename Enable = void>
+    struct LogArg
+    {
+        static_assert(std::is_arithmetic<T>::value, "MPL_LOG: unsupported argument type (numbers, enums, pointers and strings only)");
+        using type = T;
+        static type Convert(const T &v) { return v; }
+    };
+
+    template <typename T>
+    struct LogArg<T, typename std::enable_if<std::is_enum<T>::value>::type>
+    {
+        using type = typename std::underlying_type<T>::type;
+        static type Convert(const T &v) { return (type)v; }
+    };
+
+    template <typename T>
+    struct LogArg<T *, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    {
+        using type = const void *;
+        static type Convert(T *v) { return v; }
+    };
+
+    inline LogText MakeLogText(const char *s, size_t n)
+    {
+        LogText t;
+        t.len = (unsigned char)(n < LogText::MAX_LEN ? n : LogText::MAX_LEN);
+        std::memcpy(t.text, s, t.len);
+        return t;
+    }
+
+    template <>
+    struct LogArg<const char *>
+    {
+        using type = LogText;
+        static type Convert(const char *s) { return MakeLogText(s, (s != nullptr) ? std::strlen(s) : 0); }
+    };
+
+    template <>
+    struct LogArg<char *> : LogArg<const char *>
+    {
+    };
+
+    template <>
+    struct LogArg<std::string>
+    {
+        using type = LogText;
+        static type Convert(const std::string &s) { return MakeLogText(s.data(), s.size()); }
+    };
+
+    template <typename T>
+    using LogStored = typename LogArg<typename std::decay<T>::type>::type;
+
+    struct LogRecord
+    {
+        static const size_t PAYLOAD_SIZE = 192;
+        using FormatFn = void (*)(std::ostream &out, const char *fmt, const unsigned char *payload);
+
+        int64_t nanos;      // system clock
+        LogLevel level;
+        const char *fmt;
+        FormatFn format;    // knows the argument types
+        alignas(8) unsigned char payload[PAYLOAD_SIZE];
+    };
+
+    class AsyncLog
+    {
+    public:
+        // records each logging thread can have queued
+        static const size_t RING_CAPACITY = 1024;
+
+        static void Attach(std::ostream *out);
+        // start the logger thread, logging level and above
+        static void Start(LogLevel level = LogLevel::Info);
+        // everything logged before the call is written, then the thread exits
+        static void Stop();
+        // returns once everything logged before the call is written
+        static void Flush();
+
+        static void Level(LogLevel level);
+        static LogLevel Level();
+        static bool Enabled(LogLevel level);
+        // records lost to a full ring
+        static uint64_t Dropped();
+        // registered thread rings: a thread's ring is released once the thread
+        // has exited and the logger thread has written its records
+        static size_t Rings();
+
+        template <typename... Args>
+        static void Write(LogLevel level, const char *fmt, const Args &... args);
+
+    private:
+        // queue rec on the calling thread's ring
+        static void Post(const LogRecord &rec);
+        // writes fmt up to the next "{}", returns the text after it
+        static const char *FormatUpTo(std::ostream &out, const char *fmt);
+
+        template <typename... Ts>
+        static void Format(std::ostream &out, const char *fmt, const unsigned char *payload);
+
+        template <typename T>
+        static void Pack(unsigned char *payload, size_t &offset, const T &value);
+        template <typename T>
+        static T Unpack(const unsigned char *payload, size_t &offset);
+
+        // level while started, Off otherwise
+        static std::atomic<int> threshold_;
+    };
+
+    inline bool AsyncLog::Enabled(LogLevel level)
+    {
+        return (int)level >= threshold_.load(std::memory_order_relaxed);
+    }
+
+    template <typename T>
+    inline void AsyncLog::Pack(unsigned char *payload, size_t &offset, const T &value)
+    {
+        std::memcpy(payload + offset, &value, sizeof(T));
+        offset += sizeof(T);
+    }
+
+    template <typename T>
+    inline T AsyncLog::Unpack(const unsigned char *payload, size_t &offset)
+    {
+        T value;
+        std::memcpy(&value, payload + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    template <typename... Ts>
+    void AsyncLog::Format(std::ostream &out, const char *fmt, const unsigned char *payload)
+    {
+        size_t offset = 0;
+        // left to right: each argument replaces the next "{}"
+        int expand[] = {0, (fmt = FormatUpTo(out, fmt), out << Unpack<Ts>(payload, offset), 0)...};
+        (void)expand;
+        (void)payload;
+        (void)offset;
+        out << fmt;
+    }
+
+    template <typename... Args>
+    void AsyncLog::Write(LogLevel level, const char *fmt, const Args &... args)
+    {
+        static_assert((sizeof(LogStored<Args>) + ... + 0) <= LogRecord::PAYLOAD_SIZE, "MPL_LOG: too many arguments");
+
+        LogRecord rec;
+        rec.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+        rec.level = level;
+        rec.fmt = fmt;
+        rec.format = &Format<LogStored<Args>...>;
+        size_t offset = 0;
+        int expand[] = {0, (Pack(rec.payload, offset, LogArg<typename std::decay<Args>::type>::Convert(args)), 0)...};
+        (void)expand;
+        (void)offset;
+        Post(rec);
+    }
+}
+
+#endif
@@ -6,11 +6,18 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <vector>
 
 #include "EndPoint.h"
 #include "TCPSocket.h"
 #include "Cpp11-BlockingQueue.h"
 #include "Message.h"
+#include "ReceiveRingBuffer.h"
+#include "Reactor.h"
+#include "LockFreeQueue.h"
+#include "ThreadPlacement.h"
+#include "InProc.h"
+#include "FileMessage.h"
 
 ////////////////////////////////////////////////////////////////////////////
 // ClientHandler.h - Defines customizable server side processing          //
@@ -33,14 +40,23 @@
  * "Clone()" provides the creation function for creating the ClientHandler instances 
  * used to service client requests.  The clients implements AppProc()" 
  * to define the application specific processing code.
+ *
+ * In-process clients ("inproc:name" responders, see InProc.h) have no socket
+ * and no send/receive threads: GetMessage()/ReceiveMessage() take the
+ * client's MessagePtrs as sent, PostMessage()/SendMessage() hand replies back.
  * 
  * See Receiver test stub for build information and testing
  */
 
 namespace CSE384
 {
+    class TCPResponder;
+
+    // stable identifier of a connected client (assigned by TCPResponder, never reused)
+    using ClientId = uint64_t;
+
     // ClientHandler Interface: subclass this to get custom behavior
-    class ClientHandler
+    class ClientHandler : public ReactorChannel
     {
        public: 
          friend class TCPResponder; // let TCPResponder access private state
@@ -52,9 +68,25 @@ namespace CSE384
          TCPSocket&  GetDataSocket(); 
          MessagePtr GetMessage();
          MessagePtr ReceiveMessage();
+         const ReceiveRingBuffer* GetReceiveBuffer() const;
          void PostMessage(const MessagePtr& m);
          void SendMessage(const MessagePtr& m);
 
+         // file messages (see FileMessage.h), direct like SendMessage() and
+         // ReceiveMessage(): not while a send (receive) thread uses the socket.
+         // the body is len bytes of file_fd from offset, moved by the kernel
+         // (variable size messages, not FixedSizeMsgClientHander)
+         void SendFileMessage(int type, int file_fd, long long offset, size_t len);
+         // the next message: a file_type body is written to file_fd at offset
+         // (written: its length, the message returned has no data; EMSGSIZE,
+         // nothing written, when the body exceeds max_len)
+         MessagePtr ReceiveFileMessage(int file_type, int file_fd, long long offset, size_t& written,
+                                       size_t max_len = SIZE_MAX);
+
+         // number of messages waiting in the send queue
+         size_t SendQueueDepth();
+         ClientId GetClientId() const;
+
          EndPoint& GetServiceEndPoint();
 
          EndPoint RemoteEP();
@@ -62,6 +94,11 @@ namespace CSE384
          // pure virtual function: must implement 
          virtual void AppProc() = 0;
          virtual ClientHandler* Clone() = 0;
+
+         // reactor mode (TCPResponder::UseReactor): AppProc() is not called, instead
+         // every received message is dispatched here on a shared I/O thread (a
+         // DISCONNECT message comes last). must not block: reply with PostMessage()
+         virtual void OnMessage(const MessagePtr& msg);
          
          virtual ~ClientHandler();
 
@@ -69,6 +106,10 @@ namespace CSE384
         ClientHandler(const ClientHandler&) = delete;
         ClientHandler& operator=(ClientHandler&) = delete;
         
+       protected:
+         // receive buffer in use (nullptr when receiving directly from the socket)
+         ReceiveRingBuffer* RecvRingBuffer();
+
        private:
          void StartSending();
          void StartReceiving();
@@ -81,15 +122,53 @@ namespace CSE384
          virtual void SendProc();  
          virtual MessagePtr RecvSocketMessage();
          virtual void SendSocketMessage(const MessagePtr& msg);
+         virtual void SendSocketMessages(const std::vector<MessagePtr>& batch);
+         // gather list (2 entries per message) for sending count messages
+         virtual void GatherMessages(const MessagePtr* msgs, size_t count, IOVEC* iov);
+         // decode one buffered message (nullptr if incomplete): reactor mode receive
+         virtual MessagePtr DecodeMessage(ReceiveRingBuffer& rb);
+
+         // reactor mode (see Reactor.h)
+         virtual TCPSocket& ChannelSocket();
+         virtual BlockingQueue<MessagePtr>& ChannelSendQueue();
+         virtual void ChannelClosed();
         
          void IsReceiving(bool receiving);  
          void IsSending(bool issending);
 
+         // drain mode: the send thread flushes every queued message with one gather send
+         void UseSendDrain(bool use_drain);
+         bool UseSendDrain() const;
+
+         // receive buffer: decode many frames per recv() (allocated on demand)
+         void UseReceiveBuffer(bool use_buf);
+
+         // larger received messages are refused (TCPResponder::MaxClientFrameSize)
+         void MaxFrameSize(size_t max_frame);
+         size_t MaxFrameSize() const;
+
+         // bounded lock-free send (MPSC) and receive (SPSC) rings instead of the
+         // blocking queues (allocated on demand, before the threads start)
+         void UseLockFreeQueues(bool use_lockfree);
+         // server push: queue msg unless the send ring is full (never waits)
+         bool TryPostMessage(const MessagePtr& msg);
+         // send thread: the next message (waits), false once sending is stopped
+         bool NextSend(MessagePtr& msg);
+         // drain mode: every queued message, up to MAX_SEND_BATCH (waits for the
+         // first), false once sending is stopped
+         bool NextSendBatch(std::vector<MessagePtr>& batch);
+
          void ShutdownRecv();
          void ShutdownSend();
         
        
          void SetServiceEndPoint(const EndPoint& ep);
+         void SetClientId(ClientId id);
+
+         // disconnect from another thread (TCPResponder queue depth limit): the
+         // pending sends fail and AppProc() sees the connection close
+         void Drop();
+         bool IsDropped() const;
 
          std::thread recvThread;
          std::thread sendThread;
@@ -97,21 +176,51 @@ namespace CSE384
          TCPSocket data_socket;
          std::atomic<bool> isReceiving_;
          std::atomic<bool> isSending_;
+         std::atomic<bool> useSendDrain_;
+         std::unique_ptr<ReceiveRingBuffer> recv_ring_;
+         size_t max_frame_size_;
+         ClientId client_id_;
+         std::atomic<bool> dropped_;
+         Reactor* reactor_;   // reactor mode: I/O thread serving this client
+         TCPResponder* responder_;
+         // thread mode: the responder's placement, for the send/receive threads
+         ThreadPlacement placement_;
+         // in-process client (see InProc.h), else nullptr
+         std::shared_ptr<InProcConnection> inproc_;
+
+         // max messages flushed by one drain mode send (2 buffers per message)
+         static const size_t MAX_SEND_BATCH = IOVEC_MAX / 2;
+         // slots in each lock-free ring
+         static const size_t LOCKFREE_QUEUE_CAPACITY = 4096;
          
          BlockingQueue<MessagePtr> recv_queue_;
          BlockingQueue<MessagePtr> send_bq_;
+         std::unique_ptr<SPSCQueue<MessagePtr>> recv_lfq_;
+         std::unique_ptr<MPSCQueue<MessagePtr>> send_lfq_;
          EndPoint ServiceEP;
     };
     
     
     inline ClientHandler::ClientHandler(): isReceiving_(false),
-                                           isSending_(false)                         
+                                           isSending_(false),
+                                           useSendDrain_(false),
+                                           max_frame_size_(MSGHEADER::DEFAULT_MAX_FRAME),
+                                           client_id_(0),
+                                           dropped_(false),
+                                           reactor_(nullptr),
+                                           responder_(nullptr)
     {}
 
     inline int ClientHandler::Close()
     {   
        //data_socket.ShutdownSend();
        //data_socket.ShutdownRecv();
+       if (inproc_)
+       {
+          inproc_->Close();
+          inproc_.reset();
+          return 0;
+       }
        return data_socket.Close();
     }
 
@@ -127,6 +236,8 @@ namespace CSE384
 
     inline EndPoint ClientHandler::RemoteEP()
     {
+       if (inproc_)
+          return EndPoint(EndPoint::INPROC_PREFIX, 0);
        return data_socket.RemoteEP();
     }
 
@@ -149,22 +260,69 @@ namespace CSE384
 
     inline MessagePtr ClientHandler::GetMessage()
     {
-       return recv_queue_.deQ();
+       if (inproc_)
+       {
+          MessagePtr msg;
+          if (inproc_->to_server.Take(msg))
+             return msg;
+          // the client closed (or the handler was dropped)
+          return Message::CreateMessage(nullptr, 0, DISCONNECT);
+       }
+
+       if (recv_lfq_)
+       {
+          MessagePtr msg;
+          if (recv_lfq_->deQ(msg))
+             return msg;
+          // closed and drained: the connection is gone
+          return Message::CreateMessage(nullptr, 0, DISCONNECT);
+       }
+
+       MessagePtr msg;
+       if (recv_queue_.deQ(msg))
+          return msg;
+       // the receive thread failed (closed without a DISCONNECT)
+       return Message::CreateMessage(nullptr, 0, DISCONNECT);
     }
 
     inline MessagePtr ClientHandler::ReceiveMessage()
     {
+       if (inproc_)
+          return GetMessage();
        return RecvSocketMessage();
     }
 
-    inline void ClientHandler::PostMessage(const MessagePtr& msg)
+    inline const ReceiveRingBuffer* ClientHandler::GetReceiveBuffer() const
+    {
+       return recv_ring_.get();
+    }
+
+    inline ReceiveRingBuffer* ClientHandler::RecvRingBuffer()
+    {
+       return recv_ring_.get();
+    }
+
+
+    inline size_t ClientHandler::SendQueueDepth()
     {
-       return send_bq_.enQ(msg);
+       if (inproc_)
+          return inproc_->to_client.Depth();
+       return send_lfq_ ? send_lfq_->size() : send_bq_.size();
     }
 
-    inline void ClientHandler::SendMessage(const MessagePtr& msg)
+    inline ClientId ClientHandler::GetClientId() const
     {
-       SendSocketMessage(msg);
+       return client_id_;
+    }
+
+    inline void ClientHandler::SetClientId(ClientId id)
+    {
+       client_id_ = id;
+    }
+
+    inline bool ClientHandler::IsDropped() const
+    {
+       return dropped_.load();
     }
     
     inline void ClientHandler::SetSocket(TCPSocket& sock)
@@ -192,6 +350,41 @@ namespace CSE384
        return isSending_.load();
     }
 
+    inline void ClientHandler::UseSendDrain(bool use_drain)
+    {
+       useSendDrain_.store(use_drain);
+    }
+
+    inline bool ClientHandler::UseSendDrain() const
+    {
+       return useSendDrain_.load();
+    }
+
+    inline void ClientHandler::UseReceiveBuffer(bool use_buf)
+    {
+       recv_ring_.reset(use_buf ? new ReceiveRingBuffer() : nullptr);
+       if (recv_ring_)
+          recv_ring_->MaxFrameSize(max_frame_size_);
+    }
+
+    inline void ClientHandler::MaxFrameSize(size_t max_frame)
+    {
+       max_frame_size_ = max_frame;
+       if (recv_ring_)
+          recv_ring_->MaxFrameSize(max_frame);
+    }
+
+    inline size_t ClientHandler::MaxFrameSize() const
+    {
+       return max_frame_size_;
+    }
+
+    inline void ClientHandler::UseLockFreeQueues(bool use_lockfree)
+    {
+       recv_lfq_.reset(use_lockfree ? new SPSCQueue<MessagePtr>(LOCKFREE_QUEUE_CAPACITY) : nullptr);
+       send_lfq_.reset(use_lockfree ? new MPSCQueue<MessagePtr>(LOCKFREE_QUEUE_CAPACITY) : nullptr);
+    }
+
     ////////////////////////////////////////
     //  fix size message client handler   //
     ///////////////////////////////////////
@@ -206,6 +399,8 @@ namespace CSE384
           // only one send and recv system call
           virtual MessagePtr RecvSocketMessage();
           virtual void SendSocketMessage(const MessagePtr& msg);
+          virtual void GatherMessages(const MessagePtr* msgs, size_t count, IOVEC* iov);
+          virtual MessagePtr DecodeMessage(ReceiveRingBuffer& rb);
     };
 
     inline int FixedSizeMsgClientHander::GetMessageSize() const
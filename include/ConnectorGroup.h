@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////////////
+// ConnectorGroup.h - many TCPConnectors serviced by a few epoll threads   //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  A TCPConnector normally runs its own send and receive threads.  For
+ *  clients holding many connections (e.g. fanning out to many servers) a
+ *  ConnectorGroup services all of its connectors from a fixed number of
+ *  Reactor (epoll) threads, so the thread count does not grow with the
+ *  connection count.  Per connection behavior is unchanged: PostMessage()
+ *  queues (the group's thread sends), GetMessage() returns the received
+ *  messages (DISCONNECT when the server closes) and Close() flushes the
+ *  queued sends before closing.
+ *
+ *  USAGE:  ConnectorGroup group(2);
+ *          TCPConnector conn;
+ *          conn.UseConnectorGroup(&group);   // before Connect
+ *          conn.Connect(ep);
+ *
+ *  The group must outlive its connectors (close them first).  Linux only
+ *  (epoll): elsewhere the connectors keep using their own threads.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _CONNECTOR_GROUP_H_
+#define _CONNECTOR_GROUP_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "Reactor.h"
+
+namespace CSE384
+{
+    class ConnectorGroup
+    {
+    public:
+        // reactor thread i applies placement with index i
+        ConnectorGroup(int num_threads = 1, const ThreadPlacement &placement = ThreadPlacement());
+        ~ConnectorGroup();
+
+        int NumThreads() const;
+        // connections currently serviced by the group
+        size_t NumConnections() const;
+
+        ConnectorGroup(const ConnectorGroup &) = delete;
+        ConnectorGroup &operator=(const ConnectorGroup &) = delete;
+
+    private:
+        friend class TCPConnector;
+
+        // round robin (nullptr when the platform has no reactor)
+        Reactor *NextReactor();
+
+        std::vector<std::unique_ptr<Reactor>> reactors_;
+        std::atomic<size_t> next_;
+    };
+
+    inline int ConnectorGroup::NumThreads() const
+    {
+        return (int)reactors_.size();
+    }
+}
+
+#endif
@@ -14,6 +14,15 @@
  * std::condition_variable and std::mutex.  The underlying storage
  * is provided by the non-thread-safe std::queue<T>.
  *
+ * Besides the blocking deQ(): try_deQ() never waits, deQ_for() waits
+ * at most a timeout, and deQ_bulk() / try_deQ_bulk() take up to max
+ * items under one lock (one wakeup, one batch).  close() wakes every
+ * waiter: consumers still get the items queued, then the waiting
+ * operations return "empty" (false / 0 / T()) instead of blocking, so
+ * a consumer thread can be stopped without a sentinel item.  try_enQ()
+ * refuses items once the queue is closed (enQ() still queues them).
+ * reopen() makes the queue blocking again.
+ *
  * Required Files:
  * ---------------
  * Cpp11-BlockingQueue.h
@@ -31,6 +40,10 @@
  *
  * Maintenance History:
  * --------------------
+ * ver 1.5 : 18 Oct 2026
+ * - added enQ(T&&), try_enQ(), emplace(), deQ(T&), try_deQ(), deQ_for(),
+ *   deQ_bulk(), try_deQ_bulk(), close(), reopen() and closed()
+ * - move ctor and move assignment carry the closed state
  * ver 1.4:  04 Jul 2020
  * - removed unnecessary includes and tested on Linux (Mike C.)
  * ver 1.3 : 04 Mar 2016
@@ -51,33 +64,63 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <vector>
+#include <chrono>
 #include <exception>
 
 template <typename T>
 class BlockingQueue {
 public:
-  BlockingQueue() {}
+  BlockingQueue() : closed_(false) {}
   BlockingQueue(BlockingQueue<T>&& bq);
   BlockingQueue<T>& operator=(BlockingQueue<T>&& bq);
   BlockingQueue(const BlockingQueue<T>&) = delete;
   BlockingQueue<T>& operator=(const BlockingQueue<T>&) = delete;
+  // waits for an item: T() once the queue is closed and empty
   T deQ();
+  // waits for an item: false once the queue is closed and empty
+  bool deQ(T& t);
+  // never waits: false if the queue is empty
+  bool try_deQ(T& t);
+  // waits at most timeout: false on timeout (or closed and empty)
+  template <typename Rep, typename Period>
+  bool deQ_for(T& t, const std::chrono::duration<Rep, Period>& timeout);
+  // waits for an item, then appends up to max items to out under one lock:
+  // returns the number appended, 0 once the queue is closed and empty
+  size_t deQ_bulk(std::vector<T>& out, size_t max);
+  // like deQ_bulk() but never waits (0 if the queue is empty)
+  size_t try_deQ_bulk(std::vector<T>& out, size_t max);
   void enQ(const T& t);
+  void enQ(T&& t);
+  // false (t is not queued) once the queue is closed
+  bool try_enQ(const T& t);
+  bool try_enQ(T&& t);
+  template <typename... Args>
+  void emplace(Args&&... args);
+  // wake every waiter: see Package Operations
+  void close();
+  void reopen();
+  bool closed();
   T& front();
   void clear();
   size_t size();
 private:
+  // move up to max items to out (lock held)
+  size_t takeBulk(std::vector<T>& out, size_t max);
+
   std::queue<T> q_;
   std::mutex mtx_;
   std::condition_variable cv_;
+  bool closed_;
 };
 //----< move constructor >---------------------------------------------
 
 template<typename T>
-BlockingQueue<T>::BlockingQueue(BlockingQueue<T>&& bq) // need to lock so can't initialize
+BlockingQueue<T>::BlockingQueue(BlockingQueue<T>&& bq) : closed_(false) // need to lock so can't initialize
 {
   std::lock_guard<std::mutex> l(mtx_);
   q_ = bq.q_;
+  closed_ = bq.closed_;
   while (bq.q_.size() > 0)  // clear bq
     bq.q_.pop();
   /* can't copy  or move mutex or condition variable, so use default members */
@@ -90,6 +133,7 @@ BlockingQueue<T>& BlockingQueue<T>::operator=(BlockingQueue<T>&& bq)
   if (this == &bq) return *this;
   std::lock_guard<std::mutex> l(mtx_);
   q_ = bq.q_;
+  closed_ = bq.closed_;
   while (bq.q_.size() > 0)  // clear bq
     bq.q_.pop();
   /* can't move assign mutex or condition variable so use target's */
@@ -99,6 +143,14 @@ BlockingQueue<T>& BlockingQueue<T>::operator=(BlockingQueue<T>&& bq)
 
 template<typename T>
 T BlockingQueue<T>::deQ()
+{
+  T temp = T();
+  deQ(temp);
+  return temp;
+}
+
+template<typename T>
+bool BlockingQueue<T>::deQ(T& t)
 {
   std::unique_lock<std::mutex> l(mtx_);
   /* 
@@ -111,20 +163,71 @@ T BlockingQueue<T>::deQ()
        signaled state.
      std::lock_quard does not have public lock and unlock functions.
    */
-  if(q_.size() > 0)
-  {
-    T temp = q_.front();
-    q_.pop();
-    return temp;
-  }
   
-  // may have spurious returns so loop on !condition
-  while (q_.size() == 0)
-    cv_.wait(l, [this] () { return q_.size() > 0; });
+  // may have spurious returns so wait on !condition
+  cv_.wait(l, [this] () { return q_.size() > 0 || closed_; });
+  if (q_.size() == 0)
+    return false;
   
-  T temp = q_.front();
+  t = std::move(q_.front());
   q_.pop();
-  return temp;
+  return true;
+}
+//----< remove element from front of queue if there is one >-----------
+
+template<typename T>
+bool BlockingQueue<T>::try_deQ(T& t)
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  if (q_.size() == 0)
+    return false;
+
+  t = std::move(q_.front());
+  q_.pop();
+  return true;
+}
+//----< remove element from front of queue, waiting at most timeout >--
+
+template<typename T>
+template<typename Rep, typename Period>
+bool BlockingQueue<T>::deQ_for(T& t, const std::chrono::duration<Rep, Period>& timeout)
+{
+  std::unique_lock<std::mutex> l(mtx_);
+  if (!cv_.wait_for(l, timeout, [this] () { return q_.size() > 0 || closed_; }) || q_.size() == 0)
+    return false;
+
+  t = std::move(q_.front());
+  q_.pop();
+  return true;
+}
+//----< remove up to max elements with one lock >----------------------
+
+template<typename T>
+size_t BlockingQueue<T>::takeBulk(std::vector<T>& out, size_t max)
+{
+  size_t n = 0;
+  while (n < max && q_.size() > 0)
+  {
+    out.push_back(std::move(q_.front()));
+    q_.pop();
+    ++n;
+  }
+  return n;
+}
+
+template<typename T>
+size_t BlockingQueue<T>::deQ_bulk(std::vector<T>& out, size_t max)
+{
+  std::unique_lock<std::mutex> l(mtx_);
+  cv_.wait(l, [this] () { return q_.size() > 0 || closed_; });
+  return takeBulk(out, max);
+}
+
+template<typename T>
+size_t BlockingQueue<T>::try_deQ_bulk(std::vector<T>& out, size_t max)
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  return takeBulk(out, max);
 }
 //----< push element onto back of queue >------------------------------
 
@@ -137,6 +240,80 @@ void BlockingQueue<T>::enQ(const T& t)
   }
   cv_.notify_one();
 }
+
+template<typename T>
+void BlockingQueue<T>::enQ(T&& t)
+{
+  {
+    std::unique_lock<std::mutex> l(mtx_);
+    q_.push(std::move(t));
+  }
+  cv_.notify_one();
+}
+//----< push element unless the queue is closed >----------------------
+
+template<typename T>
+bool BlockingQueue<T>::try_enQ(const T& t)
+{
+  {
+    std::unique_lock<std::mutex> l(mtx_);
+    if (closed_)
+      return false;
+    q_.push(t);
+  }
+  cv_.notify_one();
+  return true;
+}
+
+template<typename T>
+bool BlockingQueue<T>::try_enQ(T&& t)
+{
+  {
+    std::unique_lock<std::mutex> l(mtx_);
+    if (closed_)
+      return false;
+    q_.push(std::move(t));
+  }
+  cv_.notify_one();
+  return true;
+}
+//----< construct element in place at back of queue >------------------
+
+template<typename T>
+template<typename... Args>
+void BlockingQueue<T>::emplace(Args&&... args)
+{
+  {
+    std::unique_lock<std::mutex> l(mtx_);
+    q_.emplace(std::forward<Args>(args)...);
+  }
+  cv_.notify_one();
+}
+//----< wake all waiters: no more blocking once empty >----------------
+
+template<typename T>
+void BlockingQueue<T>::close()
+{
+  {
+    std::lock_guard<std::mutex> l(mtx_);
+    closed_ = true;
+  }
+  cv_.notify_all();
+}
+
+template<typename T>
+void BlockingQueue<T>::reopen()
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  closed_ = false;
+}
+
+template<typename T>
+bool BlockingQueue<T>::closed()
+{
+  std::lock_guard<std::mutex> l(mtx_);
+  return closed_;
+}
 //----< peek at next item to be popped >-------------------------------
 
 template <typename T>
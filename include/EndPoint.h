@@ -14,6 +14,13 @@
  * end point class that wraps IP address and ports
  * for convenience in working the TCP (socket-based) messaging
  *
+ * same host peers: an "unix:/path" address selects a Unix domain (AF_UNIX)
+ * stream socket bound to /path instead of TCP (the port is ignored):
+ *    EndPoint ep("unix:/tmp/mpl.sock");      (or EndPoint("unix:/tmp/mpl.sock", 0))
+ * and "shm:/path" a shared memory channel, set up over a Unix domain socket
+ * at /path (see ShmChannel.h).  "inproc:name" connects threads of the same
+ * process, MessagePtrs are handed over without a socket (see InProc.h)
+ *
  * Required Files:
  * ==============
  * EndPoint.h, EndPoint.cpp
@@ -28,6 +35,9 @@
  * ===========
  *  ver 1.0 : 29 March 2019
  *     -- first release
+ *  ver 1.1 : "unix:/path" (Unix domain socket) end points
+ *  ver 1.2 : "shm:/path" (shared memory) end points
+ *  ver 1.3 : "inproc:name" (in-process) end points
  *
 */
 
@@ -72,6 +82,18 @@ namespace CSE384
       const char* IP_STR() const;
       unsigned int Port() const;
       std::string ToString() const;
+      // "unix:/path" end point (AF_UNIX), "shm:/path" end point (shared
+      // memory), either of them (IsLocal), and the socket /path of both
+      bool IsUnix() const;
+      bool IsShm() const;
+      bool IsLocal() const;
+      std::string UnixPath() const;
+      // "inproc:name" end point (same process), and its name
+      bool IsInProc() const;
+      std::string InProcName() const;
+      static const std::string UNIX_PREFIX;
+      static const std::string SHM_PREFIX;
+      static const std::string INPROC_PREFIX;
     private:
       std::string _ip;
       unsigned int _port;
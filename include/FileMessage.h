@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////////////
+// FileMessage.h - messages whose body moves between a file and a socket   //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  File transfers without copying the file through user space: a file
+ *  message is an ordinary (variable size) message on the wire, but only its
+ *  header is built in memory.
+ *  - Send writes the header, then the kernel moves the body from the file
+ *    to the socket (TCPSocket::SendFile: sendfile)
+ *  - Receive reads the next header: the body of a message of the expected
+ *    type is moved by the kernel from the socket into the file
+ *    (TCPSocket::RecvFile: splice), any other message is received as usual
+ *  The peer may send or receive file messages either way (e.g. with
+ *  PostMessage / GetMessage).
+ *
+ *  Load/Store do the same through a message, for connections whose bytes do
+ *  not come straight from a socket (in-process, receive buffer).
+ *
+ *  USAGE:  ClientHandler / TCPConnector::SendFileMessage() and
+ *          ReceiveFileMessage() (direct mode: see there)
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _FILE_MESSAGE_H_
+#define _FILE_MESSAGE_H_
+
+#include "Message.h"
+#include "TCPSocket.h"
+
+namespace CSE384
+{
+    class FileMessage
+    {
+    public:
+        // one message of type whose body is len bytes of file_fd from offset
+        // (SenderTransmitMessageDataException on socket or file errors, EIO when
+        // the file ends before len bytes)
+        static void Send(TCPSocket &sock, int type, int file_fd, long long offset, size_t len);
+
+        // the next message: when its type is file_type, its body is written to
+        // file_fd at offset (written: the body length) and the message returned
+        // has no data, EMSGSIZE (nothing written) when the body exceeds max_len;
+        // any other message is returned whole (written: 0), EMSGSIZE when its
+        // body exceeds max_frame (see Message.h).
+        // DISCONNECT when the peer shuts down, ReceiverException on errors
+        static MessagePtr Receive(TCPSocket &sock, int file_type, int file_fd, long long offset,
+                                  size_t &written, size_t max_len = SIZE_MAX,
+                                  size_t max_frame = MSGHEADER::DEFAULT_MAX_FRAME);
+
+        // a message of type with len bytes of file_fd from offset as its body
+        static MessagePtr Load(int type, int file_fd, long long offset, size_t len);
+        // write the body of msg to file_fd at offset: the bytes written
+        // (EMSGSIZE, nothing written, when the body exceeds max_len)
+        static size_t Store(const MessagePtr &msg, int file_fd, long long offset, size_t max_len = SIZE_MAX);
+    };
+}
+
+#endif
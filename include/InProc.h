@@ -0,0 +1,122 @@
+/////////////////////////////////////////////////////////////////////////////
+// InProc.h - in-process transport: MessagePtrs handed between threads     //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  The transport behind "inproc:name" end points (see EndPoint.h): a
+ *  TCPResponder and its TCPConnectors in the same process exchange MessagePtrs
+ *  directly, without sockets, serialization or byte order conversion.
+ *  - a responder started on inproc:name registers an InProcListener under
+ *    that name (names are process wide, like ports)
+ *  - TCPConnector::Connect(inproc:name) queues a new InProcConnection for the
+ *    listener: two InProcPipes, one per direction
+ *  - PostMessage/SendMessage put the message (the same MessagePtr, shared,
+ *    not copied) into a pipe, GetMessage/ReceiveMessage take it out: no send
+ *    or receive threads are started
+ *
+ *  Closing the writing side of a pipe lets the reader take what is queued,
+ *  then see the end (a DISCONNECT message).  Closing the reading side makes
+ *  later puts fail, like a send to a closed socket.
+ *
+ *  USAGE:  TCPResponder responder(EndPoint("inproc:echo"));
+ *          ... responder.Start();
+ *          TCPConnector conn;
+ *          conn.Connect(EndPoint("inproc:echo"));
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _IN_PROC_H_
+#define _IN_PROC_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "Cpp11-BlockingQueue.h"
+#include "Message.h"
+
+namespace CSE384
+{
+    // one direction of an in-process connection
+    class InProcPipe
+    {
+    public:
+        InProcPipe() : read_closed_(false) {}
+
+        // false once either side is closed (msg is not queued)
+        bool Put(const MessagePtr &msg);
+        // waits for a message: false once the writing side is closed and every
+        // message is taken, or the reading side is closed
+        bool Take(MessagePtr &msg);
+        void CloseWrite();
+        // queued messages are discarded
+        void CloseRead();
+        // messages queued, not yet taken
+        size_t Depth();
+        // either side is closed
+        bool Closed();
+
+    private:
+        BlockingQueue<MessagePtr> q_;
+        std::atomic<bool> read_closed_;
+    };
+
+    struct InProcConnection
+    {
+        InProcPipe to_server;
+        InProcPipe to_client;
+
+        // server side close: the client sees the end, its sends fail
+        void Close();
+    };
+
+    class InProcListener
+    {
+    public:
+        // registers name: nullptr when another listener has it
+        static std::shared_ptr<InProcListener> Listen(const std::string &name);
+        // a new connection, queued for the listener registered as name
+        // (nullptr when there is none)
+        static std::shared_ptr<InProcConnection> Connect(const std::string &name);
+
+        ~InProcListener();
+
+        // waits for the next connection: nullptr once closed
+        std::shared_ptr<InProcConnection> Accept();
+        // unregisters the name: Accept() returns nullptr, the connections not
+        // accepted yet are closed
+        void Close();
+
+        InProcListener(const InProcListener &) = delete;
+        InProcListener &operator=(const InProcListener &) = delete;
+
+    private:
+        InProcListener(const std::string &name) : name_(name), closed_(false) {}
+
+        std::string name_;
+        BlockingQueue<std::shared_ptr<InProcConnection>> pending_;
+        std::atomic<bool> closed_;
+    };
+
+    inline size_t InProcPipe::Depth()
+    {
+        return q_.size();
+    }
+
+    inline bool InProcPipe::Closed()
+    {
+        return q_.closed();
+    }
+}
+
+#endif
@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////////
+// IoUring.h - minimal io_uring submission/completion ring (Linux)          //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  IoUring wraps the kernel io_uring interface (raw system calls, no
+ *  liburing dependency).  Operations are queued in the shared submission ring
+ *  with the Prep...() functions (no system call), handed to the kernel with
+ *  one Submit() (io_uring_enter) and their results are harvested from the
+ *  completion ring with Reap() (no system call).  Queuing the sends/receives
+ *  of many connections, or many file blocks, and submitting them together
+ *  replaces one system call per operation with one per batch.  Registered
+ *  (fixed) buffers avoid mapping the user pages on every operation.
+ *
+ *  Availability is detected at runtime (old kernels, seccomp filters and the
+ *  kernel.io_uring_disabled sysctl all make io_uring_setup fail): Init()
+ *  returns false and the caller keeps using the plain system calls.
+ *
+ *  TCPSocket::UseIoUring(true) routes the blocking socket calls (send, recv,
+ *  sendmsg, accept) through a per thread ring (see ThreadRing()), falling back
+ *  to the plain calls when io_uring is not available.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _IO_URING_H_
+#define _IO_URING_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "Platform.h"
+
+// kernel ring entries (<linux/io_uring.h>, only included by IoUring.cpp)
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct msghdr;
+
+namespace CSE384
+{
+    class IoUring
+    {
+    public:
+        struct Completion
+        {
+            uint64_t user_data;
+            int result;   // bytes transferred / new descriptor, or -errno
+        };
+
+        IoUring();
+        ~IoUring();
+
+        // set up a ring with (at least) entries submission slots: false when the
+        // kernel does not provide io_uring
+        bool Init(unsigned entries);
+        bool IsReady() const;
+
+        // runtime detection (probed once per process)
+        static bool Available();
+
+        // ring used by TCPSocket (one per thread, nullptr if io_uring is not available)
+        static IoUring *ThreadRing();
+
+        // registered buffers for ReadFixed/WriteFixed (buffer index = position in iov)
+        int RegisterBuffers(const IOVEC *iov, unsigned count);
+        int UnregisterBuffers();
+
+        // queue an operation: false when the submission ring is full (Submit first)
+        bool PrepSend(int fd, const void *buf, size_t len, int flags, uint64_t user_data);
+        bool PrepRecv(int fd, void *buf, size_t len, int flags, uint64_t user_data);
+        bool PrepSendMsg(int fd, const struct msghdr *mh, int flags, uint64_t user_data);
+        bool PrepAccept(int fd, uint64_t user_data);
+        // file (offset) or socket (offset ignored) reads and writes
+        bool PrepRead(int fd, void *buf, size_t len, uint64_t offset, uint64_t user_data);
+        bool PrepWrite(int fd, const void *buf, size_t len, uint64_t offset, uint64_t user_data);
+        bool PrepReadFixed(int fd, void *buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data);
+        bool PrepWriteFixed(int fd, const void *buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data);
+
+        // hand the queued operations to the kernel and wait for at least wait_nr
+        // completions (one io_uring_enter): returns the number submitted or -1
+        int Submit(unsigned wait_nr = 0);
+
+        // harvest up to max completions (no system call)
+        size_t Reap(Completion *out, size_t max);
+
+        // queued operations not yet submitted
+        unsigned Queued() const;
+        // io_uring_enter calls made (for measuring system calls per operation)
+        uint64_t EnterCalls() const;
+
+        // one operation, submitted and completed (the ring must have nothing else
+        // in flight): the system call contract, -1 with errno set on failure
+        long long Send(int fd, const void *buf, size_t len, int flags);
+        long long Recv(int fd, void *buf, size_t len, int flags);
+        long long SendMsg(int fd, const struct msghdr *mh, int flags);
+        int Accept(int fd);
+
+        IoUring(const IoUring &) = delete;
+        IoUring &operator=(const IoUring &) = delete;
+
+    private:
+        // next free submission entry (nullptr when full), opcode and fd filled in
+        struct io_uring_sqe *NextSqe(int opcode, int fd, uint64_t user_data);
+        long long Complete();
+        void Release();
+
+        int ring_fd_;
+        unsigned *sq_head_;
+        unsigned *sq_tail_;
+        unsigned sq_mask_;
+        unsigned sq_entries_;
+        unsigned *sq_array_;
+        struct io_uring_sqe *sqes_;
+        unsigned *cq_head_;
+        unsigned *cq_tail_;
+        unsigned cq_mask_;
+        struct io_uring_cqe *cqes_;
+
+        void *sq_ring_;
+        size_t sq_ring_size_;
+        void *cq_ring_;
+        size_t cq_ring_size_;
+        size_t sqes_size_;
+
+        unsigned queued_;
+        uint64_t enter_calls_;
+    };
+
+    inline bool IoUring::IsReady() const
+    {
+        return ring_fd_ != -1;
+    }
+
+    inline unsigned IoUring::Queued() const
+    {
+        return queued_;
+    }
+
+    inline uint64_t IoUring::EnterCalls() const
+    {
+        return enter_calls_;
+    }
+}
+
+#endif
@@ -0,0 +1,507 @@
+/////////////////////////////////////////////////////////////////////////////
+// LockFreeQueue.h - bounded lock-free message queues (MPSC and SPSC)      //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  Two bounded ring queues for handing messages between threads without a
+ *  mutex on the fast path:
+ *
+ *  SPSCQueue<T>: one producer thread, one consumer thread (e.g. a receive
+ *  thread feeding GetMessage()).  Head and tail are each written by one side
+ *  only, so an operation is a couple of loads and one release store.
+ *
+ *  MPSCQueue<T>: any number of producer threads, one consumer thread (e.g.
+ *  application threads posting to a send thread).  Bounded ring with a
+ *  sequence number per slot: producers claim a slot with one compare and swap
+ *  on the tail, the consumer needs no atomic read-modify-write at all.
+ *
+ *  Waiting (SpinParkWait): a consumer finding the queue empty (a producer
+ *  finding it full) first spins briefly, then yields, and only then parks on
+ *  a condition variable.  A hand over to a busy consumer never enters the
+ *  kernel; an idle consumer costs no CPU.  Producers only touch the mutex
+ *  when somebody is parked.
+ *
+ *  The queues are bounded: enQ() waits while the queue is full (back
+ *  pressure), try_enQ() fails instead.  close() ends all waiting: blocked
+ *  and later producers fail instead of waiting for room, and consumers fail
+ *  once the queue is empty instead of waiting for more.  An item enqueued
+ *  while another thread closes the queue is either refused (false) or still
+ *  taken by the consumer, never dropped silently.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _LOCKFREE_QUEUE_H_
+#define _LOCKFREE_QUEUE_H_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace CSE384
+{
+    // spin, then yield, then park until a condition holds
+    class SpinParkWait
+    {
+    public:
+        SpinParkWait() : waiters_(0), parks_(0) {}
+
+        // returns once ready() is true
+        template <typename Pred>
+        void Wait(Pred ready)
+        {
+            for (int i = 0; i < SPIN_LIMIT; ++i)
+            {
+                if (ready())
+                    return;
+                CpuRelax();
+            }
+            for (int i = 0; i < YIELD_LIMIT; ++i)
+            {
+                if (ready())
+                    return;
+                std::this_thread::yield();
+            }
+
+            // announce the waiter before the last check: a Notify() after the
+            // condition became true either sees the waiter or is seen by it
+            waiters_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                if (!ready())
+                {
+                    ++parks_;
+                    cv_.wait(lock, ready);
+                }
+            }
+            waiters_.fetch_sub(1);
+        }
+
+        // wake the parked waiters (no system call when nobody is parked)
+        void Notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters_.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                cv_.notify_all();
+            }
+        }
+
+        // times a waiter had to park (kernel wait)
+        uint64_t Parks() const { return parks_.load(std::memory_order_relaxed); }
+
+    private:
+        static const int SPIN_LIMIT = 128;
+        static const int YIELD_LIMIT = 8;
+
+        static void CpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#elif defined(_MSC_VER)
+            _mm_pause();
+#endif
+        }
+
+        std::atomic<int> waiters_;
+        std::atomic<uint64_t> parks_;
+        std::mutex mtx_;
+        std::condition_variable cv_;
+    };
+
+    inline size_t RoundUpPow2(size_t n)
+    {
+        size_t cap = 2;
+        while (cap < n)
+            cap <<= 1;
+        return cap;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // SPSCQueue: single producer, single consumer ring
+
+    template <typename T>
+    class SPSCQueue
+    {
+    public:
+        // capacity is rounded up to a power of two
+        explicit SPSCQueue(size_t capacity);
+
+        // never waits: false if the queue is full or closed
+        bool try_enQ(const T &t);
+        // waits while full: false if the queue was closed
+        bool enQ(const T &t);
+        bool try_deQ(T &t);
+        // waits while empty: false once the queue is closed and empty
+        bool deQ(T &t);
+
+        void close();
+        bool closed() const;
+        // approximate while other threads are running
+        size_t size() const;
+        size_t capacity() const;
+        // times a consumer / producer parked (see SpinParkWait)
+        uint64_t Parks() const;
+
+        SPSCQueue(const SPSCQueue &) = delete;
+        SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    private:
+        std::vector<T> slots_;
+        const size_t mask_;
+        std::atomic<bool> closed_;
+        // the producer is between writing a slot and publishing (or refusing) it
+        std::atomic<bool> enqueuing_;
+        SpinParkWait not_empty_;
+        SpinParkWait not_full_;
+
+        // consumer side (head) and producer side (tail) on separate cache lines
+        alignas(64) std::atomic<size_t> head_;
+        size_t cached_tail_;
+        alignas(64) std::atomic<size_t> tail_;
+        size_t cached_head_;
+    };
+
+    template <typename T>
+    SPSCQueue<T>::SPSCQueue(size_t capacity) : slots_(RoundUpPow2(capacity)),
+                                               mask_(slots_.size() - 1),
+                                               closed_(false),
+                                               enqueuing_(false),
+                                               head_(0),
+                                               cached_tail_(0),
+                                               tail_(0),
+                                               cached_head_(0)
+    {
+    }
+
+    template <typename T>
+    bool SPSCQueue<T>::try_enQ(const T &t)
+    {
+        if (closed())
+            return false;
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == slots_.size())
+        {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == slots_.size())
+                return false;
+        }
+
+        slots_[tail & mask_] = t;
+
+        // closed while the slot was written: take it back.  Otherwise a
+        // consumer seeing the close also sees enqueuing_ (or the item)
+        enqueuing_.store(true);
+        if (closed())
+        {
+            slots_[tail & mask_] = T();
+            enqueuing_.store(false, std::memory_order_release);
+            return false;
+        }
+        tail_.store(tail + 1, std::memory_order_release);
+        enqueuing_.store(false, std::memory_order_release);
+        not_empty_.Notify();
+        return true;
+    }
+
+    template <typename T>
+    bool SPSCQueue<T>::enQ(const T &t)
+    {
+        while (!try_enQ(t))
+        {
+            if (closed())
+                return false;
+            not_full_.Wait([this]() { return size() < slots_.size() || closed(); });
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool SPSCQueue<T>::try_deQ(T &t)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_)
+        {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_)
+                return false;
+        }
+
+        // move out: the slot keeps no reference to the item
+        t = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        not_full_.Notify();
+        return true;
+    }
+
+    template <typename T>
+    bool SPSCQueue<T>::deQ(T &t)
+    {
+        while (!try_deQ(t))
+        {
+            if (closed())
+            {
+                // an item being enqueued is published or refused shortly
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (enqueuing_.load())
+                    continue;
+                if (size() == 0)
+                    return false;
+            }
+            not_empty_.Wait([this]() { return size() > 0 || closed(); });
+        }
+        return true;
+    }
+
+    template <typename T>
+    void SPSCQueue<T>::close()
+    {
+        closed_.store(true);
+        not_empty_.Notify();
+        not_full_.Notify();
+    }
+
+    template <typename T>
+    inline bool SPSCQueue<T>::closed() const
+    {
+        return closed_.load();
+    }
+
+    template <typename T>
+    inline size_t SPSCQueue<T>::size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    template <typename T>
+    inline size_t SPSCQueue<T>::capacity() const
+    {
+        return slots_.size();
+    }
+
+    template <typename T>
+    inline uint64_t SPSCQueue<T>::Parks() const
+    {
+        return not_empty_.Parks() + not_full_.Parks();
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    // MPSCQueue: multiple producers, single consumer ring
+
+    template <typename T>
+    class MPSCQueue
+    {
+    public:
+        // capacity is rounded up to a power of two
+        explicit MPSCQueue(size_t capacity);
+
+        // never waits: false if the queue is full or closed
+        bool try_enQ(const T &t);
+        // waits while full: false if the queue was closed
+        bool enQ(const T &t);
+        bool try_deQ(T &t);
+        // waits while empty: false once the queue is closed and empty
+        bool deQ(T &t);
+
+        void close();
+        bool closed() const;
+        // approximate while other threads are running
+        size_t size() const;
+        size_t capacity() const;
+        // times a consumer / producer parked (see SpinParkWait)
+        uint64_t Parks() const;
+
+        MPSCQueue(const MPSCQueue &) = delete;
+        MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+    private:
+        // seq == position: free for the producer claiming position,
+        // seq == position + 1: filled, ready for the consumer (or refused:
+        // the queue was closed after the position was claimed, skipped)
+        struct Cell
+        {
+            std::atomic<size_t> seq;
+            bool refused = false;
+            T data;
+        };
+
+        bool Readable() const;
+
+        std::unique_ptr<Cell[]> cells_;
+        const size_t capacity_;
+        const size_t mask_;
+        std::atomic<bool> closed_;
+        SpinParkWait not_empty_;
+        SpinParkWait not_full_;
+
+        alignas(64) std::atomic<size_t> head_;
+        alignas(64) std::atomic<size_t> tail_;
+    };
+
+    template <typename T>
+    MPSCQueue<T>::MPSCQueue(size_t capacity) : cells_(new Cell[RoundUpPow2(capacity)]),
+                                               capacity_(RoundUpPow2(capacity)),
+                                               mask_(capacity_ - 1),
+                                               closed_(false),
+                                               head_(0),
+                                               tail_(0)
+    {
+        for (size_t i = 0; i < capacity_; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    template <typename T>
+    bool MPSCQueue<T>::try_enQ(const T &t)
+    {
+        if (closed())
+            return false;
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                // claim the position (on failure pos is reloaded); the claim
+                // counts in size() before closed_ is looked at again below
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;   // the consumer has not freed this cell yet: full
+            else
+                pos = tail_.load(std::memory_order_relaxed);
+        }
+
+        // closed since the check above: the position cannot be given back
+        // (later ones may be claimed), so it is handed on as refused
+        bool refused = closed();
+        if (refused)
+            cell->refused = true;
+        else
+            cell->data = t;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        not_empty_.Notify();
+        return !refused;
+    }
+
+    template <typename T>
+    bool MPSCQueue<T>::enQ(const T &t)
+    {
+        while (!try_enQ(t))
+        {
+            if (closed())
+                return false;
+            not_full_.Wait([this]() { return size() < capacity_ || closed(); });
+        }
+        return true;
+    }
+
+    template <typename T>
+    inline bool MPSCQueue<T>::Readable() const
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        return cells_[head & mask_].seq.load(std::memory_order_acquire) == head + 1;
+    }
+
+    template <typename T>
+    bool MPSCQueue<T>::try_deQ(T &t)
+    {
+        for (;;)
+        {
+            size_t head = head_.load(std::memory_order_relaxed);
+            Cell *cell = &cells_[head & mask_];
+            if (cell->seq.load(std::memory_order_acquire) != head + 1)
+                return false;
+
+            // move out, then hand the cell to the producer one lap ahead
+            bool refused = cell->refused;
+            if (refused)
+                cell->refused = false;
+            else
+                t = std::move(cell->data);
+            cell->seq.store(head + capacity_, std::memory_order_release);
+            head_.store(head + 1, std::memory_order_release);
+            not_full_.Notify();
+            if (!refused)
+                return true;
+        }
+    }
+
+    template <typename T>
+    bool MPSCQueue<T>::deQ(T &t)
+    {
+        while (!try_deQ(t))
+        {
+            // a claimed but unfilled cell counts in size(): wait for it
+            if (closed())
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (size() == 0)
+                    return false;
+            }
+            not_empty_.Wait([this]() { return Readable() || closed(); });
+        }
+        return true;
+    }
+
+    template <typename T>
+    void MPSCQueue<T>::close()
+    {
+        closed_.store(true);
+        not_empty_.Notify();
+        not_full_.Notify();
+    }
+
+    template <typename T>
+    inline bool MPSCQueue<T>::closed() const
+    {
+        return closed_.load();
+    }
+
+    template <typename T>
+    inline size_t MPSCQueue<T>::size() const
+    {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return (tail > head) ? tail - head : 0;
+    }
+
+    template <typename T>
+    inline size_t MPSCQueue<T>::capacity() const
+    {
+        return capacity_;
+    }
+
+    template <typename T>
+    inline uint64_t MPSCQueue<T>::Parks() const
+    {
+        return not_empty_.Parks() + not_full_.Parks();
+    }
+}
+
+#endif
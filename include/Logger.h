@@ -18,7 +18,9 @@
 * This package supports logging for multiple concurrent clients to a
 * single std::ostream.  It does this be enqueuing messages in a
 * blocking queue and dequeuing with a single thread that writes to
-* the std::ostream.
+* the std::ostream.  The writer thread takes every queued message on
+* each wakeup (BlockingQueue::deQ_bulk) and stop() closes the queue, so
+* no "quit" message is needed.
 *
 * Build Process:
 * --------------
@@ -38,6 +40,8 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
+#include <atomic>
 #include "Cpp11-BlockingQueue.h"
 
 class Logger
@@ -56,7 +60,9 @@ private:
   std::thread* _pThr;
   std::ostream* _pOut;
   BlockingQueue<std::string> _queue;
-  bool _ThreadRunning = false;
+  std::atomic<bool> _ThreadRunning{ false };
+  // messages written per wakeup of the logging thread (at most)
+  static const size_t MAX_BATCH = 256;
 };
 
 template<int i>
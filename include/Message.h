@@ -5,7 +5,10 @@
 #include <string>
 #include <cstring>
 #include <memory>
+#include <cstdint>
+#include <stdexcept>
 #include "Platform.h"
+#include "MessagePool.h"
 
 
 namespace CSE384
@@ -17,9 +20,23 @@ namespace CSE384
                              DISCONNECT = -1,
                              STOP_SENDING = -2,
                              STRING = -3, 
-                             BINARY = -4};
+                             BINARY = -4,
+                             EXTENDED_HEADER = -5}; // reserved: marks an extended wire header
 
   // binary message structure: (wire protocol as used by messaging interface)
+  //
+  // legacy header (4 bytes):   [ len:16 | type:16 ]
+  //
+  // extended header (12 or 16 bytes), used when the body exceeds 65535 bytes
+  // or the type does not fit in 16 bits:
+  //   [ version:8 flags:8 | EXTENDED_HEADER:16 ] [ type:32 ] [ len:32 or len:64 ]
+  //   the legacy word keeps type() == EXTENDED_HEADER so the receiver knows an
+  //   extension follows; flags bit EXT_LEN64 selects a 64-bit length field.
+  //   the extension words are always stored big endian (network byte order)
+  //
+  // the length is peer supplied: receivers refuse a frame whose body exceeds
+  // their max frame size (TCPConnector::MaxFrameSize, TCPResponder::MaxClientFrameSize,
+  // default DEFAULT_MAX_FRAME) with EMSGSIZE, before allocating the body
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__) || defined(_WIN64)
 #pragma pack(1) // https://docs.microsoft.com/en-us/cpp/preprocessor/pack?view=vs-2019
 #endif
@@ -61,6 +78,84 @@ namespace CSE384
 
     inline static size_t SIZE() { return sizeof(MSGHEADER); }
 
+    // extended header support (see wire protocol above)
+    static const unsigned int EXT_VERSION = 1;
+    static const unsigned int EXT_LEN64 = 0x01;
+    static const size_t MAX_EXT_SIZE = 12;  // type:32 + len:64
+    static const size_t DEFAULT_MAX_FRAME = 256 * 1024 * 1024;  // body bytes
+
+    inline static constexpr size_t MAX_SIZE() { return sizeof(MSGHEADER) + MAX_EXT_SIZE; }
+
+    inline bool IsExtended() const
+    {
+      return type() == EXTENDED_HEADER;
+    }
+
+    inline unsigned int ExtVersion() const
+    {
+      return len() >> 8;
+    }
+
+    inline unsigned int ExtFlags() const
+    {
+      return len() & 0xFF;
+    }
+
+    // number of extension bytes following the legacy word on the wire
+    inline size_t ExtSize() const
+    {
+      return IsExtended() ? (4 + ((ExtFlags() & EXT_LEN64) ? 8 : 4)) : 0;
+    }
+
+    // total header size needed to describe a body of "length" bytes of "type"
+    inline static size_t SizeFor(size_t length, int type)
+    {
+      if (length <= 0xFFFF && type >= INT16_MIN && type <= INT16_MAX && type != EXTENDED_HEADER)
+        return SIZE();
+      return SIZE() + 4 + ((length > 0xFFFFFFFF) ? 8 : 4);
+    }
+
+    // encode a header of hdr_size bytes (as chosen by SizeFor) into "out"
+    // note: the legacy word is written in host byte order (see ToNetorkByteOrder)
+    inline static void Encode(char *out, size_t hdr_size, size_t length, int type)
+    {
+      if (hdr_size == SIZE())
+      {
+        new (out) MSGHEADER((uint32_t)length, type);
+        return;
+      }
+
+      bool len64 = (hdr_size == SIZE() + 12);
+      new (out) MSGHEADER((EXT_VERSION << 8) | (len64 ? EXT_LEN64 : 0), EXTENDED_HEADER);
+      unsigned char *ext = (unsigned char *)(out + SIZE());
+      PutBE(ext, (uint32_t)type, 4);
+      PutBE(ext + 4, (uint64_t)length, len64 ? 8 : 4);
+    }
+
+    // decode the extension bytes that follow an extended (host order) legacy word
+    inline void DecodeExt(const char *ext, size_t &length, int &t) const
+    {
+      const unsigned char *p = (const unsigned char *)ext;
+      t = (int32_t)(uint32_t)GetBE(p, 4);
+      length = (size_t)GetBE(p + 4, (ExtFlags() & EXT_LEN64) ? 8 : 4);
+    }
+
+  private:
+    inline static void PutBE(unsigned char *p, uint64_t v, int n)
+    {
+      for (int i = n - 1; i >= 0; --i, v >>= 8)
+        p[i] = (unsigned char)(v & 0xFF);
+    }
+
+    inline static uint64_t GetBE(const unsigned char *p, int n)
+    {
+      uint64_t v = 0;
+      for (int i = 0; i < n; ++i)
+        v = (v << 8) | p[i];
+      return v;
+    }
+  public:
+
 #if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
   } __attribute__((__packed__)); // <--need to override compiler memory boundary alignment
 #else
@@ -72,24 +167,37 @@ namespace CSE384
   public:
     Message(const std::string &str, int type);  
     Message(const char *data, size_t length, int type);
+    // receive constructors: the body is left uninitialized (the receive fills it)
     Message(const MSGHEADER &mhdr);
+    Message(const MSGHEADER &mhdr, const char *ext);
     Message(size_t fixed_size, const char* data, size_t length, int type);
-    Message(size_t fixed_size, size_t length, int type);
+    Message(size_t fixed_size, size_t length, int type, bool zero_fill = true);
+    // adopt a caller owned body without copying (released through the shared_ptr deleter)
+    Message(const std::shared_ptr<char> &body, size_t length, int type);
+    // share the storage of msg (see Clone)
+    Message(const Message &msg, const std::shared_ptr<char> &storage);
     Message &operator=(const Message &msg); 
     Message &operator=(Message &&msg);
     
     Message(const Message &msg);
     Message(Message &&msg);
 
-    //static MessagePtr AllocateEmptyFixedSizeMessage(int msg_size);
     static MessagePtr CreateMessage(const MSGHEADER &mhdr);
+    static MessagePtr CreateMessage(const MSGHEADER &mhdr, const char *ext);
     static MessagePtr CreateMessage(const char *data, size_t length, int type);
     static MessagePtr CreateMessage(const std::string &str, int type); 
+    static MessagePtr AdoptMessage(const std::shared_ptr<char> &body, size_t length, int type);
 
     static MessagePtr CreateFixedSizeMessage(size_t msg_size, const char *data, size_t length, int type);
     static MessagePtr CreateFixedSizeMessage(size_t msg_size, const std::string &str, int type);
     static MessagePtr CreateEmptyFixedSizeMessage(size_t msg_size);
+    // fixed size message with an uninitialized body, for receiving into GetRawMsg()
+    static MessagePtr AllocateFixedSizeMessage(size_t msg_size);
     
+    // returns a message sharing this message's buffer (no copy). copy on write: the
+    // non const operator[] and GetHeader() give a shared message its own copy first,
+    // writes through GetData()/GetRawMsg() are seen by every clone.
+    // use the copy constructor for an independent (deep) copy
     MessagePtr Clone();
 
     char& operator[](int index);
@@ -101,29 +209,90 @@ namespace CSE384
     std::string ToString() const;
 
     int HeaderSize() const;
-    int Length() const;
+    size_t Length() const;
     MessageType GetType() const;
     char *GetData() const;
     MSGHEADER *GetHeader();
 
+    // re-read length and type from the (host byte order) raw header after
+    // a raw receive into GetRawMsg(); returns false if the header does not
+    // describe a body that fits this message. also re-encodes the wire header,
+    // so call it after any change made to the raw header through GetHeader()
+    bool ParseHeader();
+
+    // the header as it goes on the wire (network byte order, HeaderSize() bytes):
+    // encoded once when the message is built and never modified by the send
+    // paths, so one message can be sent on any number of connections at once
+    const char *GetWireHeader() const;
+
+    // header + body: contiguous in memory, except for adopted bodies (see AdoptMessage)
     size_t RawMsgLength() const;
     char* GetRawMsg() const;
+
+    // header size used by fixed size messages: determined by the fixed size
+    // alone, so that both peers agree on the raw message length
+    static size_t FixedHeaderSize(size_t fixed_size);
+
+    // build the gather list (2 entries per message: wire header, body) for sending
+    // "count" messages with one system call. the messages are only read.
+    // "raw" sends the whole (fixed size) body, otherwise Length() bytes of body are sent
+    static void GatherFrames(const MessagePtr *msgs, size_t count, bool raw, IOVEC *iov);
     
   private:  
+    // allocate the Message and its shared_ptr control block from the MessagePool:
+    // both (and the raw buffer, see ~Message) are recycled when the last MessagePtr drops
+    template <typename... Args>
+    static MessagePtr Make(Args &&... args);
+
+    // give a shared message its own (contiguous, pooled) copy of the buffer
+    void Detach();
+    void Release();
+    // (re)compute wire_hdr_ from the raw header
+    void EncodeWireHeader();
+    // raw length of a fixed size message: std::length_error (before anything
+    // is allocated) when length does not fit in fixed_size
+    static size_t FixedRawLength(size_t fixed_size, size_t length);
+
     size_t raw_len_;
-    char *raw_msg_; 
-    MSGHEADER shadow_hdr;
+    char *raw_msg_;  // header, followed by the body unless the body is adopted
+    size_t hdr_size_;
+
+    // local copy of the header fields: the raw header must be logically immutable
+    // (socket Send/Receive perform endianess conversions in place)
+    size_t len_;
+    int type_;
+
+    char *data_;
+
+    // owner of shared (Clone) or adopted storage. when empty, raw_msg_ is a
+    // MessagePool buffer of raw_len_ bytes owned by this message alone
+    std::shared_ptr<char> shared_;
+
+    // header storage for messages with an adopted body
+    char hdr_buf_[MSGHEADER::MAX_SIZE()];
+
+    // network byte order copy of the header (see GetWireHeader)
+    char wire_hdr_[MSGHEADER::MAX_SIZE()];
   };
 
 
+  template <typename... Args>
+  inline MessagePtr Message::Make(Args &&... args)
+  {
+     return std::allocate_shared<Message>(PoolAllocator<Message>(), std::forward<Args>(args)...);
+  }
+
    inline MessagePtr Message::Clone()
    {
-      return MessagePtr(new Message(*this));
+      // the first clone hands the pool buffer over to a shared owner
+      if (!shared_)
+         shared_ = std::shared_ptr<char>(raw_msg_, PoolDeleter(raw_len_), PoolAllocator<char>());
+      return Make(*this, shared_);
    }
 
   inline MessagePtr Message::CreateFixedSizeMessage(size_t msg_size, const char *data, size_t length, int type)
   {
-     return MessagePtr (new Message(msg_size, data, length, type));
+     return Make(msg_size, data, length, type);
   }
 
   inline MessagePtr Message::CreateFixedSizeMessage(size_t msg_size, const std::string &str, int type)
@@ -133,52 +302,93 @@ namespace CSE384
 
   inline MessagePtr Message::CreateEmptyFixedSizeMessage(size_t msg_size)
   {
-      return MessagePtr(new Message(msg_size, msg_size,DEFAULT));
+      return Make(msg_size, msg_size, DEFAULT);
+  }
+
+  inline MessagePtr Message::AllocateFixedSizeMessage(size_t msg_size)
+  {
+      return Make(msg_size, msg_size, DEFAULT, false);
   }
 
   inline MessagePtr Message::CreateMessage(const MSGHEADER &mhdr)
   {
-     return MessagePtr(new Message(mhdr));
+     return Make(mhdr);
+  }
+
+  inline MessagePtr Message::CreateMessage(const MSGHEADER &mhdr, const char *ext)
+  {
+     return Make(mhdr, ext);
   }
 
   inline MessagePtr Message::CreateMessage(const std::string &str, int type)
   {
-     return MessagePtr(new Message(str, type));
+     return Make(str, type);
   } 
 
   inline MessagePtr Message::CreateMessage(const char *data, size_t length, int type)
   {
-     return MessagePtr(new Message(data, length, type));
+     return Make(data, length, type);
   }
 
-  inline Message::Message(size_t fixed_size, size_t length, int type): raw_len_(sizeof(MSGHEADER) + fixed_size),
-                                                                 raw_msg_(new char[raw_len_])
+  inline MessagePtr Message::AdoptMessage(const std::shared_ptr<char> &body, size_t length, int type)
   {
-    // use placement new to init MSG_HDR in raw_msg_ memory space
-    // shadow hdr is a local copy of the hdr, becuase MSGHDR must be logically immutable
-    shadow_hdr =  *(new (raw_msg_) MSGHEADER( (uint32_t) length, type));
-    std::memset((raw_msg_ + sizeof(MSGHEADER)), 0, fixed_size);
+     return Make(body, length, type);
   }
 
-  inline Message::Message(size_t fixed_size, const char* data, size_t length, int type): raw_len_(sizeof(MSGHEADER) + fixed_size),
-                                                                                   raw_msg_(new char[raw_len_])
+  inline size_t Message::FixedHeaderSize(size_t fixed_size)
   {
-    // use placement new to init MSG_HDR in raw_msg_ memory space
-     // shadow hdr is a local copy of the hdr, becuase MSGHDR must be logically immutable
-    shadow_hdr =  *(new (raw_msg_) MSGHEADER( (uint32_t) length, type));
-    std::memset((raw_msg_ + sizeof(MSGHEADER)), 0, fixed_size);
-    std::memcpy((raw_msg_ + sizeof(MSGHEADER)), data, length);
+     return MSGHEADER::SizeFor(fixed_size, DEFAULT);
   }
 
-  inline Message::Message(const char *data, size_t length, int type) : raw_len_(sizeof(MSGHEADER) + (int) length),
-                                                                             raw_msg_(new char[raw_len_])
+  inline size_t Message::FixedRawLength(size_t fixed_size, size_t length)
   {
-    // use placement new to instantiate MSG_HDR in raw_msg_ memory space
-     // shadow hdr is a local copy of the hdr, becuase MSGHDR must be logically immutable
-    shadow_hdr =  *(new (raw_msg_) MSGHEADER((uint32_t)length, type));
+     if (length > fixed_size)
+        throw std::length_error("message length exceeds the fixed message size");
+     return FixedHeaderSize(fixed_size) + fixed_size;
+  }
+
+  inline Message::Message(size_t fixed_size, size_t length, int type, bool zero_fill): raw_len_(FixedRawLength(fixed_size, length)),
+                                                                 raw_msg_(MessagePool::Allocate(raw_len_)),
+                                                                 hdr_size_(FixedHeaderSize(fixed_size)),
+                                                                 len_(length),
+                                                                 type_(type),
+                                                                 data_(raw_msg_ + hdr_size_)
+  {
+    // encode the wire header (legacy or extended) into the raw_msg_ memory space
+    MSGHEADER::Encode(raw_msg_, hdr_size_, length, type);
+    EncodeWireHeader();
+    if (zero_fill)
+      std::memset(data_, 0, fixed_size);
+  }
+
+  inline Message::Message(size_t fixed_size, const char* data, size_t length, int type): raw_len_(FixedRawLength(fixed_size, length)),
+                                                                                   raw_msg_(MessagePool::Allocate(raw_len_)),
+                                                                                   hdr_size_(FixedHeaderSize(fixed_size)),
+                                                                                   len_(length),
+                                                                                   type_(type),
+                                                                                   data_(raw_msg_ + hdr_size_)
+  {
+    // encode the wire header (legacy or extended) into the raw_msg_ memory space
+    MSGHEADER::Encode(raw_msg_, hdr_size_, length, type);
+    EncodeWireHeader();
+    // copy the message, zero only the unused part of the fixed size body
+    std::memcpy(data_, data, length);
+    std::memset(data_ + length, 0, fixed_size - length);
+  }
+
+  inline Message::Message(const char *data, size_t length, int type) : raw_len_(MSGHEADER::SizeFor(length, type) + length),
+                                                                       raw_msg_(MessagePool::Allocate(raw_len_)),
+                                                                       hdr_size_(MSGHEADER::SizeFor(length, type)),
+                                                                       len_(length),
+                                                                       type_(type),
+                                                                       data_(raw_msg_ + hdr_size_)
+  {
+    // encode the wire header (legacy or extended) into the raw_msg_ memory space
+    MSGHEADER::Encode(raw_msg_, hdr_size_, length, type);
+    EncodeWireHeader();
 
     // copy the message into the data portion of the raw message
-    std::memcpy((raw_msg_ + sizeof(MSGHEADER)), data, length);
+    std::memcpy(data_, data, length);
   }
 
   inline Message::Message(const std::string &str, int type) : Message(str.c_str(), str.length(), type)
@@ -186,12 +396,62 @@ namespace CSE384
   }
  
   inline Message::Message(const MSGHEADER &hdr) :  raw_len_(sizeof(MSGHEADER) + hdr.len()),
-                                                   raw_msg_(new char[raw_len_])
+                                                   raw_msg_(MessagePool::Allocate(raw_len_)),
+                                                   hdr_size_(sizeof(MSGHEADER)),
+                                                   len_(hdr.len()),
+                                                   type_(hdr.type()),
+                                                   data_(raw_msg_ + hdr_size_)
   {
     // use placement new to instantiate MSG_HDR in raw_msg_ memory space
-    // shadow hdr is a local copy of the hdr, becuase MSGHDR must be logically immutable
-    shadow_hdr =  *(new (raw_msg_) MSGHEADER(hdr.len(), hdr.type()));
-    std::memset((raw_msg_ + sizeof(MSGHEADER)), 0, Length());
+    new (raw_msg_) MSGHEADER(hdr.len(), hdr.type());
+    EncodeWireHeader();
+  }
+
+  inline Message::Message(const MSGHEADER &hdr, const char *ext) : raw_len_(0),
+                                                                   raw_msg_(nullptr),
+                                                                   hdr_size_(0),
+                                                                   len_(0),
+                                                                   type_(DEFAULT),
+                                                                   data_(nullptr)
+  {
+    // decode the length and type carried by the extended header
+    hdr.DecodeExt(ext, len_, type_);
+    hdr_size_ = MSGHEADER::SizeFor(len_, type_);
+    raw_len_ = hdr_size_ + len_;
+    raw_msg_ = MessagePool::Allocate(raw_len_);
+    data_ = raw_msg_ + hdr_size_;
+    MSGHEADER::Encode(raw_msg_, hdr_size_, len_, type_);
+    EncodeWireHeader();
+  }
+
+  inline Message::Message(const std::shared_ptr<char> &body, size_t length, int type) : raw_len_(MSGHEADER::SizeFor(length, type) + length),
+                                                                                         raw_msg_(hdr_buf_),
+                                                                                         hdr_size_(MSGHEADER::SizeFor(length, type)),
+                                                                                         len_(length),
+                                                                                         type_(type),
+                                                                                         data_(body.get()),
+                                                                                         shared_(body)
+  {
+    // the header lives in the message, the body stays where the caller put it
+    MSGHEADER::Encode(raw_msg_, hdr_size_, length, type);
+    EncodeWireHeader();
+  }
+
+  inline Message::Message(const Message &msg, const std::shared_ptr<char> &storage) : raw_len_(msg.raw_len_),
+                                                                                      raw_msg_(msg.raw_msg_),
+                                                                                      hdr_size_(msg.hdr_size_),
+                                                                                      len_(msg.len_),
+                                                                                      type_(msg.type_),
+                                                                                      data_(msg.data_),
+                                                                                      shared_(storage)
+  {
+    // an adopted body's header is stored in the message itself
+    if (msg.raw_msg_ == msg.hdr_buf_)
+    {
+      std::memcpy(hdr_buf_, msg.hdr_buf_, hdr_size_);
+      raw_msg_ = hdr_buf_;
+    }
+    std::memcpy(wire_hdr_, msg.wire_hdr_, hdr_size_);
   }
 
   inline size_t Message::RawMsgLength() const
@@ -206,66 +466,106 @@ namespace CSE384
 
   inline MessageType Message::GetType() const
   {
-    return (MessageType) shadow_hdr.type();
-    //return (MessageType)((MSGHEADER *)raw_msg_)->type();
+    return (MessageType) type_;
   }
 
-  inline int Message::Length() const
+  inline size_t Message::Length() const
   {
-    return shadow_hdr.len();
-   // return ((MSGHEADER *)raw_msg_)->len();
+    return len_;
   }
 
   inline MSGHEADER *Message::GetHeader()
   {
     // must return the actual message hdr (not shadow hdr) because socket Send/Receive will perform endianess conversions
+    if (shared_.use_count() > 1)
+      Detach();
     return ((MSGHEADER *)raw_msg_);
   }
 
   inline char *Message::GetData() const
   {
-    return (raw_msg_ + sizeof(MSGHEADER));
+    return data_;
   }
 
-  inline Message::Message(Message &&msg) : raw_msg_(msg.raw_msg_)
+  inline Message::Message(Message &&msg) : raw_len_(msg.raw_len_),
+                                           raw_msg_(msg.raw_msg_),
+                                           hdr_size_(msg.hdr_size_),
+                                           len_(msg.len_),
+                                           type_(msg.type_),
+                                           data_(msg.data_),
+                                           shared_(std::move(msg.shared_))
   {
-    raw_len_ = msg.raw_len_;
+    if (msg.raw_msg_ == msg.hdr_buf_)
+    {
+      std::memcpy(hdr_buf_, msg.hdr_buf_, hdr_size_);
+      raw_msg_ = hdr_buf_;
+    }
+    std::memcpy(wire_hdr_, msg.wire_hdr_, hdr_size_);
     msg.raw_msg_ = nullptr;
     msg.raw_len_ = 0;
-    shadow_hdr = msg.shadow_hdr;
-    msg.shadow_hdr.data = 0;
+    msg.hdr_size_ = 0;
+    msg.len_ = 0;
+    msg.type_ = DEFAULT;
+    msg.data_ = nullptr;
+  }
+
+  inline Message::Message(const Message &msg) : raw_len_(msg.raw_len_),
+                                                raw_msg_(MessagePool::Allocate(msg.RawMsgLength())),
+                                                hdr_size_(msg.hdr_size_),
+                                                len_(msg.len_),
+                                                type_(msg.type_),
+                                                data_(raw_msg_ + hdr_size_)
+  {
+    // header and body separately: the source body may be adopted (not contiguous)
+    std::memcpy(raw_msg_, msg.raw_msg_, hdr_size_);
+    std::memcpy(data_, msg.data_, raw_len_ - hdr_size_);
+    std::memcpy(wire_hdr_, msg.wire_hdr_, hdr_size_);
+  }
+
+  inline const char *Message::GetWireHeader() const
+  {
+    return wire_hdr_;
+  }
+
+  inline void Message::EncodeWireHeader()
+  {
+    std::memcpy(wire_hdr_, raw_msg_, hdr_size_);
+    ((MSGHEADER *)wire_hdr_)->ToNetorkByteOrder();
   }
 
-  inline Message::Message(const Message &msg) : raw_msg_(new char[msg.RawMsgLength()])
+  inline void Message::Release()
   {
-    std::memcpy(raw_msg_, msg.raw_msg_, msg.RawMsgLength());
-    raw_len_ = msg.raw_len_;
-    shadow_hdr = msg.shadow_hdr;
+    if (shared_)
+      shared_.reset();
+    else
+      MessagePool::Release(raw_msg_, raw_len_);
   }
 
   inline Message::~Message()
   {
-    delete[] raw_msg_;
+    Release();
   }
 
   inline char& Message::operator[](int index)
   {
     // return const_cast<char&>(static_cast<const Message&>(*this)[index]);
-    if(index < 0 || Length() <= index  )
+    if(index < 0 || Length() <= (size_t) index  )
        throw std::invalid_argument("index out of bounds in operator[])");
+    if (shared_.use_count() > 1)
+      Detach();
     return GetData()[index];
   }
 
   inline const char& Message::operator[](int index) const
   {
-    if(index < 0 || Length() <= index  )
+    if(index < 0 || Length() <= (size_t) index  )
        throw std::invalid_argument("index out of bounds in operator[])");
     return GetData()[index];
   }
 
   inline int Message::HeaderSize() const
   {
-    return sizeof(MSGHEADER);
+    return (int) hdr_size_;
   }
 
   std::ostream &operator<<(std::ostream &outs, Message &msg);
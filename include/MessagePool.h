@@ -0,0 +1,127 @@
+/////////////////////////////////////////////////////////////////////////////
+// MessagePool.h - thread caching, size class buffer pool for Messages     //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  MessagePool recycles the raw buffers (header + body) behind Message objects,
+ *  and, through PoolAllocator, the Message object and shared_ptr control block
+ *  behind each MessagePtr (see Message::CreateMessage).
+ *
+ *  Buffers are grouped in power of two size classes for bodies of 64 bytes up
+ *  to 64 KB (each class has room for the largest message header on top).
+ *  Each thread keeps a small cache of free buffers per class, so the common
+ *  allocate/release path takes no lock.  Threads overflow to (and refill from)
+ *  a shared depot.  Requests larger than the biggest class go to the heap.
+ *
+ *  The hit/miss counters report how often a request was served from a free
+ *  list (hit) versus the heap (miss), per size class, to help size the pool.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _MESSAGE_POOL_H_
+#define _MESSAGE_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CSE384
+{
+    class MessagePool
+    {
+    public:
+        static const size_t MIN_CLASS_SIZE = 64;
+        static const size_t MAX_CLASS_SIZE = 64 * 1024;
+        static const int NUM_CLASSES = 11;          // 64B ... 64KB
+        static const size_t CLASS_SLACK = 16;       // room for the largest message header
+
+        // return a buffer of at least size bytes
+        static char *Allocate(size_t size);
+
+        // return a buffer obtained from Allocate(size)
+        static void Release(char *buf, size_t size);
+
+        // size class serving "size" bytes (-1 for oversize requests)
+        static int ClassIndex(size_t size);
+        static size_t ClassSize(int index);
+
+        // counters (summed over all threads)
+        static uint64_t Hits(int index = -1);
+        static uint64_t Misses(int index = -1);
+        static uint64_t Oversize();
+        static void ResetCounters();
+
+        MessagePool() = delete;
+    };
+
+    // standard allocator backed by MessagePool: used with std::allocate_shared so the
+    // Message object and its control block are recycled with the last MessagePtr
+    template <typename T>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+
+        PoolAllocator() = default;
+
+        template <typename U>
+        PoolAllocator(const PoolAllocator<U> &) {}
+
+        T *allocate(size_t n)
+        {
+            return (T *)MessagePool::Allocate(n * sizeof(T));
+        }
+
+        void deallocate(T *p, size_t n)
+        {
+            MessagePool::Release((char *)p, n * sizeof(T));
+        }
+
+        template <typename U>
+        bool operator==(const PoolAllocator<U> &) const { return true; }
+
+        template <typename U>
+        bool operator!=(const PoolAllocator<U> &) const { return false; }
+    };
+
+    // shared_ptr deleter returning a MessagePool buffer
+    class PoolDeleter
+    {
+    public:
+        PoolDeleter(size_t size) : size_(size) {}
+
+        void operator()(char *buf) const
+        {
+            MessagePool::Release(buf, size_);
+        }
+
+    private:
+        size_t size_;
+    };
+
+    inline size_t MessagePool::ClassSize(int index)
+    {
+        return (MIN_CLASS_SIZE << index) + CLASS_SLACK;
+    }
+
+    inline int MessagePool::ClassIndex(size_t size)
+    {
+        for (int i = 0; i < NUM_CLASSES; ++i)
+        {
+            if (size <= ClassSize(i))
+                return i;
+        }
+        return -1;
+    }
+}
+
+#endif
@@ -15,11 +15,19 @@ const int PORTABLE_SOCK_ERR_BUF_SIZE = 512;
   #include <arpa/inet.h>
   #include <errno.h>
   #include <cstring>
+  #include <cstddef>
   #include <cstdio>
   #include <errno.h>
   #include <features.h>
   #include <strings.h>
   #include <locale.h>
+  #include <sys/uio.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/un.h>
+  #include <sys/stat.h>
 
   // for strerror_s on Linux: source: https://en.cppreference.com/w/c/string/byte/strerror
   // #ifndef __STDC_WANT_LIB_EXT1__
@@ -53,6 +61,121 @@ const int PORTABLE_SOCK_ERR_BUF_SIZE = 512;
 	 return close(s);
   }   
 
+  // portable scatter/gather buffer descriptor: struct iovec on Linux, WSABUF on Windows
+  using IOVEC = struct iovec;
+
+  inline void set_iovec_portable(IOVEC &v, const char *base, size_t len)
+  {
+    v.iov_base = (void *)base;
+    v.iov_len = len;
+  }
+
+  inline size_t iovec_len_portable(const IOVEC &v) { return v.iov_len; }
+  inline char *iovec_base_portable(const IOVEC &v) { return (char *)v.iov_base; }
+
+  inline void advance_iovec_portable(IOVEC &v, size_t n)
+  {
+    v.iov_base = (char *)v.iov_base + n;
+    v.iov_len -= n;
+  }
+
+  // non-blocking socket helpers
+  inline int set_nonblocking_portable(SOCKET s, bool nonblocking)
+  {
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags == -1)
+      return -1;
+    return fcntl(s, F_SETFL, nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+  }
+
+  inline bool wouldblock_portable(int error) { return error == EAGAIN || error == EWOULDBLOCK; }
+  inline bool interrupted_portable(int error) { return error == EINTR; }
+  inline void settimedout_portable() { errno = ETIMEDOUT; }
+
+  // wait for the socket to become readable (write: writable): > 0 ready, 0 timed out, -1 error
+  // (timeout_ms -1: no timeout)
+  inline int poll_portable(SOCKET s, bool write, int timeout_ms)
+  {
+    struct pollfd p;
+    p.fd = s;
+    p.events = write ? POLLOUT : POLLIN;
+    p.revents = 0;
+    return poll(&p, 1, timeout_ms);
+  }
+
+  // several sockets bound to one address (set before bind): the kernel spreads
+  // incoming connections over their accept queues
+  inline int set_reuseport_portable(SOCKET s)
+  {
+    int on = 1;
+    return setsockopt(s, SOL_SOCKET, SO_REUSEPORT, (char *)&on, sizeof(on));
+  }
+
+  // Unix domain (AF_UNIX) socket address of path: 0 ok, -1 failed (errno)
+  inline int unix_addr_portable(const char *path, struct sockaddr_storage *addr, socklen_t *addrlen)
+  {
+    struct sockaddr_un *un = (struct sockaddr_un *)addr;
+    size_t len = strlen(path);
+    if (len == 0 || len >= sizeof(un->sun_path))
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+    memset(un, 0, sizeof(*un));
+    un->sun_family = AF_UNIX;
+    memcpy(un->sun_path, path, len + 1);
+    *addrlen = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len + 1);
+    return 0;
+  }
+
+  // remove the socket file at path when no listener is bound to it any more:
+  // a probe connect() must be refused (ECONNREFUSED); any other kind of file
+  // is left alone.  0 removed (or nothing to remove), -1 with EADDRINUSE when
+  // a listener still accepts connections at path
+  inline int unlink_unix_socket_portable(const char *path)
+  {
+    struct stat st;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    if (stat(path, &st) != 0 || !S_ISSOCK(st.st_mode) || unix_addr_portable(path, &addr, &addrlen) != 0)
+      return 0;
+
+    // non-blocking: a live listener with a full backlog fails with EAGAIN
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1)
+      return -1;
+    int refused = (connect(fd, (struct sockaddr *)&addr, addrlen) == -1 && errno == ECONNREFUSED);
+    close(fd);
+    if (!refused)
+    {
+      errno = EADDRINUSE;
+      return -1;
+    }
+    unlink(path);
+    return 0;
+  }
+
+  // run the calling thread on one cpu only: 0 ok, -1 failed
+  inline int pin_thread_portable(int cpu)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) ? 0 : -1;
+  }
+
+  // positioned file reads and writes (TCPSocket::SendFile/RecvFile copies):
+  // the bytes moved, -1 failed (errno)
+  inline long long pread_portable(int fd, char *buf, size_t len, long long offset)
+  {
+    return pread(fd, buf, len, (off_t)offset);
+  }
+
+  inline long long pwrite_portable(int fd, const char *buf, size_t len, long long offset)
+  {
+    return pwrite(fd, buf, len, (off_t)offset);
+  }
+
 #else 
   #ifndef WIN32_LEAN_AND_MEAN  // prevents duplicate includes of core parts of windows.h in winsock2.h 
      #define WIN32_LEAN_AND_MEAN
@@ -63,6 +186,7 @@ const int PORTABLE_SOCK_ERR_BUF_SIZE = 512;
   #include <winsock2.h>     // Windows sockets, ver 2
   #include <WS2tcpip.h>     // support for IPv6 and other things
   #include <IPHlpApi.h>     // ip helpers
+  #include <io.h>           // _read, _write, _lseeki64
 
   #include<atomic>
 
@@ -75,6 +199,88 @@ const int PORTABLE_SOCK_ERR_BUF_SIZE = 512;
   // helper function to get socket errors in a portable way (windows and linux)
   const char* strerror_portable(const char* errbuf, int buflen, int error);
 
+  // portable scatter/gather buffer descriptor: struct iovec on Linux, WSABUF on Windows
+  using IOVEC = WSABUF;
+
+  inline void set_iovec_portable(IOVEC &v, const char *base, size_t len)
+  {
+    v.buf = (CHAR *)base;
+    v.len = (ULONG)len;
+  }
+
+  inline size_t iovec_len_portable(const IOVEC &v) { return v.len; }
+  inline char *iovec_base_portable(const IOVEC &v) { return (char *)v.buf; }
+
+  inline void advance_iovec_portable(IOVEC &v, size_t n)
+  {
+    v.buf += n;
+    v.len -= (ULONG)n;
+  }
+
+  // non-blocking socket helpers
+  inline int set_nonblocking_portable(SOCKET s, bool nonblocking)
+  {
+    u_long mode = nonblocking ? 1 : 0;
+    return ioctlsocket(s, FIONBIO, &mode);
+  }
+
+  inline bool wouldblock_portable(int error) { return error == WSAEWOULDBLOCK; }
+  inline bool interrupted_portable(int error) { return error == WSAEINTR; }
+  inline void settimedout_portable() { WSASetLastError(WSAETIMEDOUT); }
+
+  // wait for the socket to become readable (write: writable): > 0 ready, 0 timed out, -1 error
+  // (timeout_ms -1: no timeout)
+  inline int poll_portable(SOCKET s, bool write, int timeout_ms)
+  {
+    WSAPOLLFD p;
+    p.fd = s;
+    p.events = write ? POLLWRNORM : POLLRDNORM;
+    p.revents = 0;
+    return WSAPoll(&p, 1, timeout_ms);
+  }
+
+  // no SO_REUSEPORT load balancing on Windows
+  inline int set_reuseport_portable(SOCKET s)
+  {
+    WSASetLastError(WSAEOPNOTSUPP);
+    return -1;
+  }
+
+  // Unix domain sockets are not supported here
+  inline int unix_addr_portable(const char *path, struct sockaddr_storage *addr, socklen_t *addrlen)
+  {
+    WSASetLastError(WSAEAFNOSUPPORT);
+    return -1;
+  }
+
+  inline int unlink_unix_socket_portable(const char *path)
+  {
+    return 0;
+  }
+
+  // run the calling thread on one cpu only: 0 ok, -1 failed
+  inline int pin_thread_portable(int cpu)
+  {
+    return (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0) ? 0 : -1;
+  }
+
+  // positioned file reads and writes (TCPSocket::SendFile/RecvFile copies):
+  // the bytes moved, -1 failed (errno).  Seek, then read/write: callers must
+  // not share the descriptor between threads
+  inline long long pread_portable(int fd, char *buf, size_t len, long long offset)
+  {
+    if (_lseeki64(fd, offset, SEEK_SET) == -1)
+      return -1;
+    return _read(fd, buf, (unsigned int)len);
+  }
+
+  inline long long pwrite_portable(int fd, const char *buf, size_t len, long long offset)
+  {
+    if (_lseeki64(fd, offset, SEEK_SET) == -1)
+      return -1;
+    return _write(fd, buf, (unsigned int)len);
+  }
+
   /////////////////////////////////////////////////////////////////////////////
   // SocketSystem class - manages loading and unloading Winsock library
   // Sender and Receiver define an instance of SocketSystem as private member
@@ -112,6 +318,9 @@ const int PORTABLE_SOCK_ERR_BUF_SIZE = 512;
   };
 #endif
 
+// max buffers handed to one scatter/gather system call (Linux IOV_MAX)
+const int IOVEC_MAX = 1024;
+
 #include<thread>
   
 #endif 
@@ -0,0 +1,165 @@
+/////////////////////////////////////////////////////////////////////////////
+// Reactor.h - epoll I/O thread multiplexing many client connections       //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  Reactor is the I/O engine behind TCPResponder::UseReactor(true) and
+ *  ConnectorGroup.  Instead of a receive thread and a send thread for every
+ *  connection, each Reactor is one thread servicing any number of non-blocking
+ *  sockets (ReactorChannels: ClientHandler, TCPConnector) with epoll:
+ *  - readable: read what the socket has (one recv), decode every complete
+ *    frame and dispatch it to the channel's OnMessage().  Partial frames are
+ *    kept per connection until the rest arrives.
+ *  - writable: flush the channel's send queue (PostMessage) with gather sends,
+ *    waiting for EPOLLOUT only while the socket buffer is full.
+ *  Everything about a connection is touched by its own reactor thread only;
+ *  other threads hand over new channels (Add), pending sends (WakeSend) and
+ *  close requests (Shutdown) through a locked list and an eventfd wakeup.
+ *
+ *  Linux only (epoll): on other platforms Start() throws.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "Cpp11-BlockingQueue.h"
+#include "TCPSocket.h"
+#include "Message.h"
+#include "ReceiveRingBuffer.h"
+#include "ThreadPlacement.h"
+
+namespace CSE384
+{
+    // a connection serviced by a Reactor
+    class ReactorChannel
+    {
+    public:
+        virtual ~ReactorChannel() {}
+
+    private:
+        friend class Reactor;
+
+        virtual TCPSocket &ChannelSocket() = 0;
+        virtual BlockingQueue<MessagePtr> &ChannelSendQueue() = 0;
+        // gather list (2 entries per message) for sending count messages
+        virtual void GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov) = 0;
+        // decode one buffered message (nullptr if incomplete)
+        virtual MessagePtr DecodeMessage(ReceiveRingBuffer &rb) = 0;
+        // every received message, a DISCONNECT message last
+        virtual void OnMessage(const MessagePtr &msg) = 0;
+        // no longer serviced (removed from epoll): the channel may delete itself
+        virtual void ChannelClosed() = 0;
+    };
+
+    class Reactor
+    {
+    public:
+        // max events handled per epoll_wait
+        static const int MAX_EVENTS = 256;
+        // max gather sends per connection per wakeup (fairness between clients)
+        static const int MAX_FLUSH_BATCHES = 16;
+        // max messages per gather send (2 buffers per message)
+        static const size_t MAX_SEND_BATCH = IOVEC_MAX / 2;
+
+        Reactor();
+        ~Reactor();
+
+        // the reactor thread applies placement (index: its cpu when spreading)
+        void Start(const ThreadPlacement &placement = ThreadPlacement(), size_t index = 0);
+
+        // hand a connected channel over to this reactor: it is serviced until the
+        // connection ends, then ChannelClosed() is called (on the reactor thread)
+        void Add(ReactorChannel *ch);
+
+        // the channel's send queue has messages (may be called from any thread)
+        void WakeSend(ReactorChannel *ch);
+
+        // flush the queued sends, then shut down the write side: the channel
+        // closes when the peer does
+        void Shutdown(ReactorChannel *ch);
+
+        // stop once every connection has closed, and wait for the thread
+        void Finish();
+
+        size_t NumConnections() const;
+
+        Reactor(const Reactor &) = delete;
+        Reactor &operator=(const Reactor &) = delete;
+
+    private:
+        struct Connection
+        {
+            ReactorChannel *ch;
+            // bytes of an incomplete frame (allocated only while one is pending)
+            std::unique_ptr<ReceiveRingBuffer> partial;
+            // messages being written and their (partially sent) gather list
+            std::vector<MessagePtr> out;
+            std::vector<IOVEC> iov;
+            size_t iov_first;
+            bool want_out;   // registered for EPOLLOUT
+            bool closing;    // peer shut down: flush the sends, then close
+            bool closed;     // deleted at the end of the current event batch
+            bool shutdown;   // Shutdown() requested: shut the write side once flushed
+            bool write_shut;
+        };
+
+        void Run();
+        void AcceptIncoming();
+        void FlushPending();
+        void ShutdownPending();
+        void OnReadable(Connection *c);
+        // write queued messages until done or the socket would block (false on error)
+        bool Flush(Connection *c);
+        void WantOut(Connection *c, bool want_out);
+        // deliver DISCONNECT to the handler, stop reading, close once flushed
+        void Disconnect(Connection *c);
+        void Close(Connection *c);
+        // mtx_ held
+        void Wake();
+
+        int epoll_fd_;
+        int wake_fd_;
+        std::thread thread_;
+        ThreadPlacement placement_;
+        size_t placement_index_;
+        std::atomic<bool> finishing_;
+        std::atomic<size_t> num_conns_;
+
+        // handed over by other threads
+        std::mutex mtx_;
+        std::vector<ReactorChannel *> incoming_;
+        std::vector<ReactorChannel *> pending_;
+        std::vector<ReactorChannel *> shutdowns_;
+        bool woken_;   // eventfd written, lists not yet picked up
+
+        // reactor thread only
+        std::unordered_map<ReactorChannel *, Connection *> conns_;
+        std::vector<Connection *> closed_;
+        ReceiveRingBuffer scratch_;
+    };
+
+    inline size_t Reactor::NumConnections() const
+    {
+        return num_conns_.load();
+    }
+}
+
+#endif
@@ -0,0 +1,143 @@
+/////////////////////////////////////////////////////////////////////////////
+// ReceiveRingBuffer.h - per connection buffered receive / frame parser    //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  ReceiveRingBuffer is an alternative receive strategy for TCPConnector and
+ *  ClientHandler.  Instead of two recv(MSG_WAITALL) calls per message (one for
+ *  the header, one for the body), it reads as much as the socket has available
+ *  into a per connection buffer and then decodes every complete frame from it.
+ *  A partial frame at the end of the buffer is carried over (moved to the front
+ *  of the buffer) and completed by the next read.  Frames larger than the buffer
+ *  are received directly into the message body.
+ *
+ *  USAGE:  TCPConnector::UseReceiveBuffer(true)
+ *          TCPResponder::UseClientReceiveBuffer(true)
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _RECEIVE_RING_BUFFER_H_
+#define _RECEIVE_RING_BUFFER_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "Message.h"
+#include "TCPSocket.h"
+
+namespace CSE384
+{
+    class ReceiveRingBuffer
+    {
+    public:
+        static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+        ReceiveRingBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+        // return the next (variable size) message, reading from the socket only
+        // when no complete frame is buffered. returns a DISCONNECT message when
+        // the peer shuts down, throws a ReceiverException on socket errors
+        MessagePtr NextMessage(TCPSocket &sock);
+
+        // same as NextMessage() for fixed size (msg_size) messages
+        MessagePtr NextFixedSizeMessage(TCPSocket &sock, size_t msg_size);
+
+        // decode one complete frame from the buffered bytes (nullptr if incomplete)
+        MessagePtr Decode();
+        MessagePtr DecodeFixedSize(size_t msg_size);
+
+        // append bytes to the buffer (e.g. data already read by a non-blocking reader)
+        void Append(const char *data, size_t len);
+
+        // one recv call into the free space (no retries, for non-blocking sockets):
+        // returns the bytes read, 0 when the peer shut down, -1 on error / would block
+        // (or when the buffer is full of unread bytes)
+        int ReadSome(TCPSocket &sock);
+
+        // unread (buffered) bytes start here
+        const char *Peek() const;
+
+        size_t Buffered() const;
+        size_t Capacity() const;
+        void Clear();
+
+        // variable size frames with a larger body are refused (see Message.h):
+        // ReceiverReceiveMessageHeaderException (EMSGSIZE)
+        void MaxFrameSize(size_t max_frame);
+        size_t MaxFrameSize() const;
+
+        // counters for measuring system calls per message
+        uint64_t RecvCalls() const;
+        uint64_t MessagesDecoded() const;
+
+        ReceiveRingBuffer(const ReceiveRingBuffer &) = delete;
+        ReceiveRingBuffer &operator=(const ReceiveRingBuffer &) = delete;
+
+    private:
+        // read whatever the socket has into the free space (one recv call)
+        int Fill(TCPSocket &sock);
+        // move the unread (partial frame) bytes to the front of the buffer
+        void Compact();
+        // parse the frame header at the read position: false if not enough bytes
+        bool PeekHeader(MSGHEADER &mhdr, char *ext, size_t &hdr_size, size_t &length) const;
+
+        std::vector<char> buf_;
+        size_t head_;   // read position
+        size_t tail_;   // write position
+        uint64_t recv_calls_;
+        uint64_t decoded_;
+        size_t max_frame_;
+    };
+
+    inline size_t ReceiveRingBuffer::Buffered() const
+    {
+        return tail_ - head_;
+    }
+
+    inline const char *ReceiveRingBuffer::Peek() const
+    {
+        return buf_.data() + head_;
+    }
+
+    inline size_t ReceiveRingBuffer::Capacity() const
+    {
+        return buf_.size();
+    }
+
+    inline void ReceiveRingBuffer::Clear()
+    {
+        head_ = tail_ = 0;
+    }
+
+    inline void ReceiveRingBuffer::MaxFrameSize(size_t max_frame)
+    {
+        max_frame_ = max_frame;
+    }
+
+    inline size_t ReceiveRingBuffer::MaxFrameSize() const
+    {
+        return max_frame_;
+    }
+
+    inline uint64_t ReceiveRingBuffer::RecvCalls() const
+    {
+        return recv_calls_;
+    }
+
+    inline uint64_t ReceiveRingBuffer::MessagesDecoded() const
+    {
+        return decoded_;
+    }
+}
+
+#endif
@@ -146,6 +146,14 @@ class ReceiverGetAddrInfoException : public ReceiverException
 };
 
 
+// reactor mode: creating the epoll / eventfd descriptors failed
+class ReceiverReactorException : public ReceiverException
+{
+  public:
+    ReceiverReactorException(int errnum) : ReceiverException(errnum)
+    {}
+};
+
 class ReceiverNoRegisteredClientHandlerException : public ReceiverException
 {
   public:
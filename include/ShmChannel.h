@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////////////////
+// ShmChannel.h - shared memory byte stream between two local processes    //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  The transport behind "shm:/path" end points (see EndPoint.h): peers on
+ *  the same host exchange bytes through two rings in a shared memory segment
+ *  (memfd), one per direction, instead of the kernel socket layer.
+ *  - the connection starts as a Unix domain socket at /path: the connecting
+ *    side creates the segment and four eventfds and passes them over it
+ *    (SCM_RIGHTS), the accepting side maps the same segment
+ *  - each ring is single producer / single consumer: the writer copies bytes
+ *    in and publishes its position, the reader copies them out.  Neither
+ *    enters the kernel while the other side keeps up
+ *  - a side that must wait (ring empty / full) spins briefly, then announces
+ *    itself and sleeps in poll() on an eventfd, which the other side only
+ *    writes when somebody is waiting.  The poll also watches the Unix socket,
+ *    so a peer that closes (or dies) ends the wait
+ *
+ *  TCPSocket routes Send/SendV/Recv/RecvSome through the channel, so the
+ *  message framing, TCPConnector, ClientHandler and AppProc() code are the
+ *  same as for TCP.  Each direction supports one sending and one receiving
+ *  thread at a time (the connector and client handler send/receive threads).
+ *
+ *  Linux only (elsewhere Connect/Accept fail with EAFNOSUPPORT).
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _SHM_CHANNEL_H_
+#define _SHM_CHANNEL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "Platform.h"
+
+namespace CSE384
+{
+    class ShmChannel
+    {
+    public:
+        // bytes per direction (a power of two)
+        static const size_t RING_BYTES = 1 << 20;
+
+        // connecting side: creates the segment and hands it over the connected
+        // Unix domain socket sock (which stays open, the channel does not own it).
+        // nullptr on failure, error set
+        static std::shared_ptr<ShmChannel> Connect(SOCKET sock, int &error);
+        // accepting side: maps the segment the peer sends over sock
+        static std::shared_ptr<ShmChannel> Accept(SOCKET sock, int &error);
+
+        ~ShmChannel();
+
+        // like a non-blocking socket: the bytes written (possibly fewer than
+        // asked), -1 with EWOULDBLOCK when the ring is full, -1 with EPIPE when
+        // either side shut the direction down
+        long long Send(const IOVEC *iov, int iovcnt);
+        // the bytes read, 0 once the peer shut down (or closed) and every byte
+        // is read, -1 with EWOULDBLOCK when the ring is empty
+        long long Recv(char *buf, size_t len);
+
+        // wait until Send (write) or Recv can make progress: 1 ready,
+        // 0 wait_ms passed (-1 waits without a limit), -1 error
+        int Poll(bool write, int wait_ms);
+
+        void ShutdownSend();
+        void ShutdownRecv();
+
+        ShmChannel(const ShmChannel &) = delete;
+        ShmChannel &operator=(const ShmChannel &) = delete;
+
+    private:
+        struct Ring;
+
+        ShmChannel();
+        // map the segment, out_ is ring out_index of it
+        bool Map(int memfd, int out_index);
+
+        bool Readable();
+        bool Writable();
+        // wake the other side if it waits on ring r (data: its reader, else its writer)
+        void Signal(Ring *r, bool data);
+
+        void *map_;
+        size_t map_len_;
+        Ring *out_;
+        Ring *in_;
+        // eventfds: the reader and the writer of each ring sleep on their own
+        int out_data_fd_;
+        int out_space_fd_;
+        int in_data_fd_;
+        int in_space_fd_;
+        SOCKET sock_;
+        std::atomic<bool> peer_gone_;
+    };
+}
+
+#endif
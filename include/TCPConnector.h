@@ -17,6 +17,30 @@
  *  to build custom/resuable TCP message passing clients
  *  This package assumes the target operating system is POSIX standard compliant
  *  i.e. standard I/O, sockets (IPv4 - old interface) I/O, and Threading model.
+ *
+ *  Connector groups: by default every connector runs a send thread and a
+ *  receive thread.  UseConnectorGroup() (before Connect) hands the socket to
+ *  a ConnectorGroup's epoll threads instead (see ConnectorGroup.h): many
+ *  connectors then share a few threads, with the same PostMessage() /
+ *  GetMessage() queues per connection.
+ *
+ *  Thread mode sockets are non-blocking: a send that would block waits for
+ *  the socket to drain (poll) instead of sleeping and retrying, and
+ *  SendTimeout() bounds that wait (see TCPSocket::SendTimeout).
+ *
+ *  Lock-free queues (thread mode): UseLockFreeQueues(true) replaces the
+ *  mutex based send and receive queues with bounded rings (see
+ *  LockFreeQueue.h): an MPSC ring from the posting threads to the send
+ *  thread and an SPSC ring from the receive thread to GetMessage().  Only one
+ *  thread may call GetMessage(), and PostMessage() waits while the send ring
+ *  is full.
+ *
+ *  In-process connections: Connect(EndPoint("inproc:name")) reaches a
+ *  responder of the same process (see InProc.h).  No socket or thread is
+ *  used: PostMessage()/SendMessage() hand the MessagePtr itself to the
+ *  responder's ClientHandler, GetMessage()/ReceiveMessage() wait for its
+ *  replies.  The queue, drain, buffer, group and placement options do not
+ *  apply.
 
  * Required Files:
  * ==============
@@ -41,15 +65,26 @@
 #include "EndPoint.h"
 #include "TCPSocket.h"
 #include "Message.h"
+#include "ReceiveRingBuffer.h"
+#include "Reactor.h"
+#include "LockFreeQueue.h"
+#include "ThreadPlacement.h"
+#include "InProc.h"
+#include "FileMessage.h"
+#include "SenderExceptions.h"
 
 #include <cstring>
 #include <thread>
 #include <atomic>
 #include <memory>
+#include <vector>
+#include <future>
 
 namespace CSE384
 {
-    class TCPConnector
+    class ConnectorGroup;
+
+    class TCPConnector : public ReactorChannel
     {
     public:
         TCPConnector(TCPSocketOptions *sc = nullptr);
@@ -65,13 +100,56 @@ namespace CSE384
         bool UseSendQueue();
         void UseReceiveQueue(bool use_q);
         bool UseReceiveQueue();
+        // drain mode: the send thread flushes every queued message with one gather send
+        void UseSendDrain(bool use_drain);
+        bool UseSendDrain();
+        // receive buffer: read as much as is available and decode many frames per recv()
+        // (takes effect on the next Connect)
+        void UseReceiveBuffer(bool use_buf);
+        bool UseReceiveBuffer();
+        // received messages with a larger body are refused with EMSGSIZE before
+        // they are allocated (see Message.h; takes effect on the next Connect)
+        void MaxFrameSize(size_t max_frame);
+        size_t MaxFrameSize() const;
+        // group mode: the group's threads send and receive (takes effect on the next
+        // Connect; the queue, drain and receive buffer options do not apply)
+        void UseConnectorGroup(ConnectorGroup *group);
+        ConnectorGroup *GetConnectorGroup() const;
+        // thread mode: max milliseconds one message send may wait for a full socket
+        // buffer to drain, -1: no limit (takes effect on the next Connect)
+        void SendTimeout(int timeout_ms);
+        int SendTimeout() const;
+        // thread mode: bounded lock-free send/receive rings instead of the blocking
+        // queues (takes effect on the next Connect)
+        void UseLockFreeQueues(bool use_lockfree);
+        bool UseLockFreeQueues();
+        // thread mode: cpus and names of the send (index 0) and receive (index 1)
+        // threads (see ThreadPlacement.h; takes effect on the next Connect)
+        void Placement(const ThreadPlacement &placement);
+        const ThreadPlacement &Placement() const;
+        const ReceiveRingBuffer *GetReceiveBuffer() const;
         void PostMessage(const MessagePtr &m);
         void SendMessage(const MessagePtr &m);
         MessagePtr GetMessage();
         MessagePtr ReceiveMessage();
 
+        // file messages (see FileMessage.h), direct like SendMessage() and
+        // ReceiveMessage(): not while the send (receive) thread uses the socket.
+        // the body is len bytes of file_fd from offset, moved by the kernel
+        // (variable size messages, not FixedSizeMsgConnector)
+        void SendFileMessage(int type, int file_fd, long long offset, size_t len);
+        // the next message: a file_type body is written to file_fd at offset
+        // (written: its length, the message returned has no data; EMSGSIZE,
+        // nothing written, when the body exceeds max_len)
+        MessagePtr ReceiveFileMessage(int file_type, int file_fd, long long offset, size_t &written,
+                                      size_t max_len = SIZE_MAX);
+
         TCPClientSocket &GetClientSocket();
 
+        // ep may be "unix:/path": a Unix domain socket to a same host responder,
+        // "shm:/path": shared memory rings (not serviced by a ConnectorGroup), or
+        // "inproc:name": a responder in this process (SenderConnectException
+        // ECONNREFUSED when none is started on name)
         void Connect(const EndPoint &ep);
         int ConnectPersist(const EndPoint &ep, unsigned retries,
             unsigned wtime_secs, unsigned vlevel);
@@ -82,13 +160,25 @@ namespace CSE384
 
     protected:
         TCPClientSocket socket;
+        std::unique_ptr<ReceiveRingBuffer> recv_ring_;
 
     private:
         TCPSocketOptions *sc_;
 
         // can redefine socket level processing (if you wish)
         virtual void SendSocketMessage(const MessagePtr &msg);
+        virtual void SendSocketMessages(const std::vector<MessagePtr> &batch);
         virtual MessagePtr RecvSocketMessage();
+        // gather list (2 entries per message) for sending count messages
+        virtual void GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov);
+        // decode one buffered message (nullptr if incomplete): group mode receive
+        virtual MessagePtr DecodeMessage(ReceiveRingBuffer &rb);
+
+        // group mode (see Reactor.h)
+        virtual TCPSocket &ChannelSocket();
+        virtual BlockingQueue<MessagePtr> &ChannelSendQueue();
+        virtual void OnMessage(const MessagePtr &msg);
+        virtual void ChannelClosed();
 
         virtual void sendProc();
         virtual void RecvProc();
@@ -98,12 +188,32 @@ namespace CSE384
 
         std::atomic<bool> useSendQueue_;
         std::atomic<bool> useRecvQueue_;
+        std::atomic<bool> useSendDrain_;
+        std::atomic<bool> useRecvBuffer_;
+
+        // max messages flushed by one drain mode send (2 buffers per message)
+        static const size_t MAX_SEND_BATCH = IOVEC_MAX / 2;
+        // slots in each lock-free ring
+        static const size_t LOCKFREE_QUEUE_CAPACITY = 4096;
 
         BlockingQueue<MessagePtr> recv_queue_;
         BlockingQueue<MessagePtr> send_bq_;
+        std::atomic<bool> useLockFree_;
+        std::unique_ptr<SPSCQueue<MessagePtr>> recv_lfq_;
+        std::unique_ptr<MPSCQueue<MessagePtr>> send_lfq_;
         std::thread send_thread_;
         std::thread recvThread;
 
+        ConnectorGroup *group_;
+        Reactor *reactor_;   // group mode: I/O thread serving this connection
+        int sendTimeout_;
+        std::atomic<size_t> maxFrameSize_;
+        ThreadPlacement placement_;
+        std::promise<void> channel_closed_;
+        std::future<void> channel_closed_f_;
+        // in-process connection (see InProc.h), else nullptr
+        std::shared_ptr<InProcConnection> inproc_;
+
         void StartReceiving();
         void StopReceiving();
         void IsReceiving(bool receiving);
@@ -113,6 +223,11 @@ namespace CSE384
         void IsSending(bool issending);
         void StartSending();
         void StopSending();
+        // send thread: the next message (waits), false once sending is stopped
+        bool NextSend(MessagePtr &msg);
+        // drain mode: every queued message, up to MAX_SEND_BATCH (waits for the
+        // first), false once sending is stopped
+        bool NextSendBatch(std::vector<MessagePtr> &batch);
 
         #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__) || defined(_WIN64)
         // On windows the Winsock needs to initialized SocketSystem manages this with a ref count
@@ -122,12 +237,41 @@ namespace CSE384
 
     inline void TCPConnector::PostMessage(const MessagePtr &m)
     {
+        // in-process: like a queued send to a closed socket, a message for a
+        // closed connection is dropped
+        if (inproc_)
+        {
+            inproc_->to_server.Put(m);
+            return;
+        }
+
+        if (send_lfq_)
+        {
+            send_lfq_->enQ(m);
+            return;
+        }
+
         send_bq_.enQ(m);
+
+        // group mode: the reactor thread sends
+        if (reactor_ != nullptr)
+            reactor_->WakeSend(this);
     }
 
     inline void TCPConnector::SendMessage(const MessagePtr &m)
     {
-        SendSocketMessage(m);
+        if (inproc_)
+        {
+            if (!inproc_->to_server.Put(m))
+                throw SenderTransmitMessageDataException(EPIPE);
+            return;
+        }
+
+        // group mode: the reactor owns the (non-blocking) socket
+        if (reactor_ != nullptr)
+            PostMessage(m);
+        else
+            SendSocketMessage(m);
     }
 
     inline void TCPConnector::IsSending(bool issending)
@@ -137,11 +281,36 @@ namespace CSE384
 
     inline MessagePtr TCPConnector::GetMessage()
     {
-        return recv_queue_.deQ();
+        if (inproc_)
+        {
+            MessagePtr msg;
+            if (inproc_->to_client.Take(msg))
+                return msg;
+            // the handler is done (or the connection is closed)
+            return Message::CreateMessage(nullptr, 0, DISCONNECT);
+        }
+
+        if (recv_lfq_)
+        {
+            MessagePtr msg;
+            if (recv_lfq_->deQ(msg))
+                return msg;
+            // closed and drained: the connection is gone
+            return Message::CreateMessage(nullptr, 0, DISCONNECT);
+        }
+
+        MessagePtr msg;
+        if (recv_queue_.deQ(msg))
+            return msg;
+        // the receive thread failed (closed without a DISCONNECT)
+        return Message::CreateMessage(nullptr, 0, DISCONNECT);
     }
 
     inline MessagePtr TCPConnector::ReceiveMessage()
     {
+        // group mode: the reactor receives into the receive queue
+        if (reactor_ != nullptr || inproc_)
+            return GetMessage();
         return RecvSocketMessage();
     }
 
@@ -162,7 +331,7 @@ namespace CSE384
 
     inline bool TCPConnector::IsConnected() const
     {
-        return socket.IsConnected();
+        return socket.IsConnected() || (inproc_ && !inproc_->to_server.Closed());
     }
 
     inline TCPClientSocket &TCPConnector::GetClientSocket()
@@ -196,6 +365,81 @@ namespace CSE384
         useSendQueue_.store(use_q);
     }
 
+    inline void TCPConnector::SendTimeout(int timeout_ms)
+    {
+        sendTimeout_ = timeout_ms;
+    }
+
+    inline int TCPConnector::SendTimeout() const
+    {
+        return sendTimeout_;
+    }
+
+    inline void TCPConnector::Placement(const ThreadPlacement &placement)
+    {
+        placement_ = placement;
+    }
+
+    inline const ThreadPlacement &TCPConnector::Placement() const
+    {
+        return placement_;
+    }
+
+    inline void TCPConnector::UseLockFreeQueues(bool use_lockfree)
+    {
+        useLockFree_.store(use_lockfree);
+    }
+
+    inline bool TCPConnector::UseLockFreeQueues()
+    {
+        return useLockFree_.load();
+    }
+
+    inline bool TCPConnector::UseSendDrain()
+    {
+        return useSendDrain_.load();
+    }
+
+    inline void TCPConnector::UseSendDrain(bool use_drain)
+    {
+        useSendDrain_.store(use_drain);
+    }
+
+    inline bool TCPConnector::UseReceiveBuffer()
+    {
+        return useRecvBuffer_.load();
+    }
+
+    inline void TCPConnector::UseReceiveBuffer(bool use_buf)
+    {
+        useRecvBuffer_.store(use_buf);
+    }
+
+    inline void TCPConnector::MaxFrameSize(size_t max_frame)
+    {
+        maxFrameSize_.store(max_frame);
+    }
+
+    inline size_t TCPConnector::MaxFrameSize() const
+    {
+        return maxFrameSize_.load();
+    }
+
+    inline const ReceiveRingBuffer *TCPConnector::GetReceiveBuffer() const
+    {
+        return recv_ring_.get();
+    }
+
+    inline void TCPConnector::UseConnectorGroup(ConnectorGroup *group)
+    {
+        group_ = group;
+    }
+
+    inline ConnectorGroup *TCPConnector::GetConnectorGroup() const
+    {
+        return group_;
+    }
+
     ////////////////////////////////////////
     //  fix size message connector       //
     ///////////////////////////////////////
@@ -209,6 +453,8 @@ namespace CSE384
         // only one send and recv system call
         virtual void SendSocketMessage(const MessagePtr &msg);
         virtual MessagePtr RecvSocketMessage();
+        virtual void GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov);
+        virtual MessagePtr DecodeMessage(ReceiveRingBuffer &rb);
         int msg_size_;
     };
 
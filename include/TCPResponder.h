@@ -19,6 +19,52 @@
  *  Threading model. 
  
  *  USAGE:  See TCPResponder test stub
+ *
+ *  Client registry: every serviced client gets a stable ClientId and stays
+ *  registered while its AppProc() runs.  Broadcast()/SendTo() post one
+ *  (shared, never copied) MessagePtr into the recipients' send queues, so they
+ *  require the client send queues (UseClientSendQueue(true), the default).
+ *  ClientQueueLimit() bounds the send queue depth of slow consumers: a client
+ *  at the limit is either skipped (the message is not queued for it) or
+ *  disconnected.
+ *
+ *  Client sockets (thread mode) are non-blocking: a send that would block
+ *  waits for the socket to drain (poll) instead of sleeping and retrying, and
+ *  ClientSendTimeout() bounds that wait (see TCPSocket::SendTimeout).
+ *
+ *  Thread mode services each client on a pool thread for as long as it is
+ *  connected: by default a pool of ClientThreads() (8) threads owned by this
+ *  responder, or a WorkStealingPool shared with other responders
+ *  (UseThreadPool).  Either way the pool bounds the clients serviced at once.
+ *
+ *  Sharded accept (AcceptShards(n), Linux): n listening sockets bound to the
+ *  same EndPoint with SO_REUSEPORT, each with its own accept thread (pinned to
+ *  a core with PinAcceptShards(true)).  The kernel spreads new connections
+ *  over the shards, and each shard services its clients on its own pool (or
+ *  its own reactors), so a connection storm is accepted in parallel.  Only
+ *  the client count (NumClients) and the Broadcast/SendTo registry are shared.
+ *
+ *  Reactor mode (UseReactor(true), Linux): instead of one thread pool thread
+ *  (plus a receive and a send thread) per client, a fixed set of
+ *  ReactorThreads() epoll threads multiplexes every connection (see Reactor.h).
+ *  AppProc() is not called: each received message is dispatched to the
+ *  handler's OnMessage() on its reactor thread, and replies are queued with
+ *  PostMessage().  The queue, drain and receive buffer options do not apply.
+ *
+ *  Same host clients: a responder (and TCPConnector) constructed with an
+ *  EndPoint("unix:/path") uses a Unix domain stream socket instead of TCP
+ *  loopback.  Handlers see no difference (RemoteEP() is "unix:").
+ *  EndPoint("shm:/path") goes one step further: after the Unix domain
+ *  connect, messages travel through shared memory rings (see ShmChannel.h),
+ *  RemoteEP() is "shm:".  Shared memory clients are serviced in thread mode
+ *  even with UseReactor(true).
+ *
+ *  Same process clients: EndPoint("inproc:name") registers the responder
+ *  under name when it starts (see InProc.h).  A TCPConnector connecting to it
+ *  hands its MessagePtrs straight to the handler's GetMessage() (no socket,
+ *  no serialization, no send/receive threads), so the cost of the framework
+ *  itself can be measured apart from the kernel.  AppProc() runs on the pool
+ *  as usual (even with UseReactor(true)) and RemoteEP() is "inproc:".
 
  * Required Files:
  * ==============
@@ -38,20 +84,31 @@
 
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "EndPoint.h"
 #include "TCPSocket.h"
 #include "ClientHandler.h"
-#include "ThreadPool.h"
+#include "WorkStealingPool.h"
+#include "Reactor.h"
+#include "InProc.h"
 
 namespace CSE384
 {
    class TCPResponder
    {
       public:
+        // what Broadcast/SendTo do with a client whose send queue is at the depth limit
+        enum OverflowPolicy { SKIP_CLIENT, DISCONNECT_CLIENT };
+
         TCPResponder(const EndPoint& ep, TCPSocketOptions* sc = nullptr);
         virtual ~TCPResponder();
         void RegisterClientHandler(ClientHandler* ch);
+        // inproc:name end point: ReceiverBindException (EADDRINUSE) when another
+        // responder of this process has the name
         void Start(int backlog=20);
         void Stop();
         bool UseClientReceiveQueue();
@@ -59,32 +116,128 @@ namespace CSE384
         void UseClientReceiveQueue(bool use_q);
         bool UseClientSendQueue();
         void UseClientSendQueue(bool use_q);
+        bool UseClientSendDrain();
+        void UseClientSendDrain(bool use_drain);
+        bool UseClientReceiveBuffer();
+        void UseClientReceiveBuffer(bool use_buf);
+        // messages from clients with a larger body are refused with EMSGSIZE
+        // before they are allocated, the client is disconnected (see Message.h)
+        size_t MaxClientFrameSize();
+        void MaxClientFrameSize(size_t max_frame);
+        // thread mode: bounded lock-free client send/receive rings (see
+        // ClientHandler::UseLockFreeQueues): a full ring counts as the queue limit
+        bool UseClientLockFreeQueues();
+        void UseClientLockFreeQueues(bool use_lockfree);
+        // set before Start()
+        bool UseReactor();
+        void UseReactor(bool use_reactor);
+        int ReactorThreads();
+        void ReactorThreads(int num_threads);
+        // thread mode: max milliseconds one message send may wait for a full client
+        // socket buffer to drain, -1 (default): no limit
+        int ClientSendTimeout();
+        void ClientSendTimeout(int timeout_ms);
+        // thread mode (set before Start()): service the clients on pool (shared,
+        // must outlive the responder's Stop) instead of an own pool of
+        // ClientThreads() threads (0: WorkStealingPool::AvailableCores()).
+        // nullptr: own pool (default)
+        WorkStealingPool* UseThreadPool();
+        void UseThreadPool(WorkStealingPool* pool);
+        size_t ClientThreads();
+        void ClientThreads(size_t num_threads);
+        // cpus and names of every thread the responder starts: accept threads
+        // (index: shard), own pool workers, reactor threads and the client
+        // send/receive threads (see ThreadPlacement.h; set before Start())
+        const ThreadPlacement& Placement();
+        void Placement(const ThreadPlacement& placement);
+        // set before Start(): n SO_REUSEPORT listeners with an accept thread each
+        // (1, the default: one listener; no effect where SO_REUSEPORT is missing,
+        // or for unix:/path and shm:/path end points)
+        int AcceptShards();
+        void AcceptShards(int num_shards);
+        // shard i accept thread runs on core i (modulo the number of cores)
+        bool PinAcceptShards();
+        void PinAcceptShards(bool pin);
         bool IsListening();
         int NumClients();
         void NumClients(int client_count);
 
+        // client registry / server push
+        size_t NumConnectedClients();
+        std::vector<ClientId> ConnectedClients();
+        // returns the number of clients the message was queued for
+        size_t Broadcast(const MessagePtr& msg);
+        // returns false if the client is not connected (or skipped/disconnected by the limit)
+        bool SendTo(ClientId id, const MessagePtr& msg);
+        // 0 (default): unlimited
+        void ClientQueueLimit(size_t max_depth, OverflowPolicy policy = SKIP_CLIENT);
+        size_t ClientQueueLimit();
+        // messages not queued (skipped clients) and clients disconnected by the limit
+        uint64_t SkippedSends();
+        uint64_t DroppedClients();
+
         // prevent users from making copies of TCPResponder objects
         TCPResponder(const TCPResponder&) = delete;
         TCPResponder& operator=(TCPResponder&) = delete;
 
       private:
+        friend class ClientHandler;  // reactor mode: unregisters itself when closed
+
         virtual void ServiceClient(ClientHandler* ch);
 
-        void ListenThreadProc(int backlog);
+        // accept loop of one shard (0: listenSocket_)
+        void ListenThreadProc(int shard, int backlog);
+        // reactor mode accept loop (listening socket ready)
+        void ReactorListen(int shard);
+        TCPServerSocket& ShardSocket(int shard);
+        // count an accepted client: false when it is over NumClients(), the
+        // shard reaching the limit wakes the other shards' accept calls
+        bool ClientLimitReached();
+        bool CountClient(int shard);
         void Initialize(const char* ip, unsigned int port);
         void IsListening(bool listening);  
+        // post msg to ch, applying the queue depth limit (registry lock held)
+        bool PostToClient(ClientHandler* ch, const MessagePtr& msg);
+        void RegisterClient(ClientHandler* ch);
+        void UnregisterClient(ClientHandler* ch);
 
         EndPoint ServiceEP;
         TCPSocketOptions* sc_;
         TCPServerSocket listenSocket_;
+        // "inproc:name" end point: takes the place of the listening sockets
+        std::shared_ptr<InProcListener> inproc_listener_;
+        // shards 1..n-1 (shard 0 is listenSocket_)
+        std::vector<std::unique_ptr<TCPServerSocket>> shardSockets_;
+        std::vector<std::thread> shardThreads_;
+        std::atomic<int> accept_shards_;
+        std::atomic<bool> pin_shards_;
+        std::atomic<int> accepted_;
         ClientHandler* ch_;
         std::atomic<bool> islistening_;
         std::thread listenThread_;
 
         std::atomic<bool> useClientRecvQueue_;
         std::atomic<bool> useClientSendQueue_;
+        std::atomic<bool> useClientSendDrain_;
+        std::atomic<bool> useClientRecvBuffer_;
+        std::atomic<size_t> max_client_frame_;
+        std::atomic<bool> useClientLockFree_;
+        std::atomic<bool> useReactor_;
+        std::atomic<int>  reactor_threads_;
+        std::atomic<int>  client_send_timeout_;
+        ThreadPlacement placement_;
+        std::atomic<WorkStealingPool*> pool_;
+        std::atomic<size_t> client_threads_;
         std::atomic<int>  num_clients_;
 
+        std::mutex clients_mtx_;
+        std::unordered_map<ClientId, ClientHandler*> clients_;
+        ClientId next_client_id_;
+        std::atomic<size_t> client_queue_limit_;
+        std::atomic<int> overflow_policy_;
+        std::atomic<uint64_t> skipped_sends_;
+        std::atomic<uint64_t> dropped_clients_;
+
         #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__) || defined(_WIN64)
         SocketSystem s;
         #endif
@@ -126,6 +279,131 @@ namespace CSE384
       useClientSendQueue_.store(use_q);
    }
 
+   inline bool TCPResponder::UseClientSendDrain()
+   {
+      return useClientSendDrain_.load();
+   }
+
+   inline void TCPResponder::UseClientSendDrain(bool use_drain)
+   {
+      useClientSendDrain_.store(use_drain);
+   }
+
+   inline bool TCPResponder::UseClientReceiveBuffer()
+   {
+      return useClientRecvBuffer_.load();
+   }
+
+   inline void TCPResponder::UseClientReceiveBuffer(bool use_buf)
+   {
+      useClientRecvBuffer_.store(use_buf);
+   }
+
+   inline size_t TCPResponder::MaxClientFrameSize()
+   {
+      return max_client_frame_.load();
+   }
+
+   inline void TCPResponder::MaxClientFrameSize(size_t max_frame)
+   {
+      max_client_frame_.store(max_frame);
+   }
+
+   inline bool TCPResponder::UseClientLockFreeQueues()
+   {
+      return useClientLockFree_.load();
+   }
+
+   inline void TCPResponder::UseClientLockFreeQueues(bool use_lockfree)
+   {
+      useClientLockFree_.store(use_lockfree);
+   }
+
+   inline bool TCPResponder::UseReactor()
+   {
+      return useReactor_.load();
+   }
+
+   inline void TCPResponder::UseReactor(bool use_reactor)
+   {
+      useReactor_.store(use_reactor);
+   }
+
+   inline int TCPResponder::ReactorThreads()
+   {
+      return reactor_threads_.load();
+   }
+
+   inline void TCPResponder::ReactorThreads(int num_threads)
+   {
+      reactor_threads_.store(num_threads < 1 ? 1 : num_threads);
+   }
+
+   inline int TCPResponder::ClientSendTimeout()
+   {
+      return client_send_timeout_.load();
+   }
+
+   inline void TCPResponder::ClientSendTimeout(int timeout_ms)
+   {
+      client_send_timeout_.store(timeout_ms);
+   }
+
+   inline TCPServerSocket& TCPResponder::ShardSocket(int shard)
+   {
+      return (shard == 0) ? listenSocket_ : *shardSockets_[shard - 1];
+   }
+
+   inline int TCPResponder::AcceptShards()
+   {
+      return accept_shards_.load();
+   }
+
+   inline void TCPResponder::AcceptShards(int num_shards)
+   {
+      accept_shards_.store(num_shards < 1 ? 1 : num_shards);
+   }
+
+   inline bool TCPResponder::PinAcceptShards()
+   {
+      return pin_shards_.load();
+   }
+
+   inline void TCPResponder::PinAcceptShards(bool pin)
+   {
+      pin_shards_.store(pin);
+   }
+
+   inline const ThreadPlacement& TCPResponder::Placement()
+   {
+      return placement_;
+   }
+
+   inline void TCPResponder::Placement(const ThreadPlacement& placement)
+   {
+      placement_ = placement;
+   }
+
+   inline WorkStealingPool* TCPResponder::UseThreadPool()
+   {
+      return pool_.load();
+   }
+
+   inline void TCPResponder::UseThreadPool(WorkStealingPool* pool)
+   {
+      pool_.store(pool);
+   }
+
+   inline size_t TCPResponder::ClientThreads()
+   {
+      return client_threads_.load();
+   }
+
+   inline void TCPResponder::ClientThreads(size_t num_threads)
+   {
+      client_threads_.store(num_threads);
+   }
+
    inline int TCPResponder::NumClients()
    {
       return  num_clients_.load();
@@ -136,6 +414,27 @@ namespace CSE384
       num_clients_.store(client_count);
    }
 
+   inline void TCPResponder::ClientQueueLimit(size_t max_depth, OverflowPolicy policy)
+   {
+      overflow_policy_.store(policy);
+      client_queue_limit_.store(max_depth);
+   }
+
+   inline size_t TCPResponder::ClientQueueLimit()
+   {
+      return client_queue_limit_.load();
+   }
+
+   inline uint64_t TCPResponder::SkippedSends()
+   {
+      return skipped_sends_.load();
+   }
+
+   inline uint64_t TCPResponder::DroppedClients()
+   {
+      return dropped_clients_.load();
+   }
+
 }
 #endif 
 
@@ -1,12 +1,15 @@
 #ifndef TCPSOCKET_H_
 #define TCPSOCKET_H_
 
+#include <memory>
+
 #include "Platform.h"
 #include "EndPoint.h"
 
 namespace CSE384
 {
   class TCPSocketOptions;
+  class ShmChannel;
   class TCPSocket
   {
   public:
@@ -15,8 +18,53 @@ namespace CSE384
   
     bool IsValid() const;
    
-    int Send(const char *block, size_t blockLen, int flags, int sendRetries, unsigned int wait_time = 1);
-    int Recv(const char *block, size_t blockLen, int flags, int recvRetries, unsigned int wait_time = 1);
+    // Send/SendV/Recv move the whole block (any size, at most INT_MAX bytes per
+    // system call) and return its length, or -1 on error.  Recv returns fewer
+    // bytes (0 when nothing was read) when the peer closes the connection
+    long long Send(const char *block, size_t blockLen, int flags, int sendRetries, unsigned int wait_time = 1);
+    // gather send: writes all iovcnt buffers using as few system calls as possible
+    // note: the iov entries are advanced in place as bytes are written
+    long long SendV(IOVEC *iov, int iovcnt, int flags, int sendRetries, unsigned int wait_time = 1);
+    long long Recv(const char *block, size_t blockLen, int flags, int recvRetries, unsigned int wait_time = 1);
+    // receive whatever is available (up to blockLen bytes) with one successful recv call
+    int RecvSome(const char *block, size_t blockLen, int flags, int recvRetries, unsigned int wait_time = 1);
+    // one gather send call (no retries): returns the bytes written (possibly partial) or -1,
+    // intended for non-blocking sockets (see wouldblock_portable)
+    long long SendSomeV(const IOVEC *iov, int iovcnt, int flags);
+    // file bytes without a user space copy: count bytes of file_fd from offset
+    // go to the socket (sendfile), or from the socket into file_fd at offset
+    // (splice through a pipe).  The file position is not used or changed.
+    // Waits like Send/Recv (SendTimeout/RecvTimeout); returns count, fewer when
+    // the file ends (SendFile) or the peer closes (RecvFile), -1 on error.
+    // Shared memory sockets and non Linux platforms copy through a buffer
+    long long SendFile(int file_fd, long long offset, size_t count);
+    long long RecvFile(int file_fd, long long offset, size_t count);
+    int SetNonBlocking(bool nonblocking);
+
+    // non-blocking sockets: when a Send/SendV (Recv/RecvSome) call would block it
+    // waits for readiness with poll, bounded by one deadline for the whole call:
+    // -1 waits without a deadline (default), 0 never waits (returns -1 with
+    // EWOULDBLOCK), > 0 returns -1 with ETIMEDOUT once timeout_ms have passed.
+    // Interrupted calls (EINTR) are repeated and never count as retries.
+    void SendTimeout(int timeout_ms);
+    int SendTimeout() const;
+    void RecvTimeout(int timeout_ms);
+    int RecvTimeout() const;
+
+    // process wide: route Send, Recv, SendV and Accept through a per thread io_uring
+    // ring (see IoUring.h), plain system calls when io_uring is not available
+    static void UseIoUring(bool use);
+    static bool UseIoUring();
+
+    // connected through a "shm:/path" end point: Send, SendV, Recv and RecvSome
+    // go through a shared memory channel (see ShmChannel.h), the socket itself
+    // only tells when the peer closes
+    bool IsShm() const;
+    // a socket from TCPServerSocket::AcceptDeferred(): sets up its shared memory
+    // channel (shm:/path, waits up to 2 seconds for the client), false (and the
+    // socket is closed) when that fails.  Other sockets: nothing to do, true
+    bool CompleteAccept();
+
     operator SOCKET();
     SOCKET GetSockFd() const;
     SOCKET SetSockFd(SOCKET sock_fd);
@@ -41,10 +89,25 @@ namespace CSE384
   protected:
      int GetAddressInfo(const char *node_name, const char *serv_name, 
                          int ai_family, struct addrinfo **servinfo);
+     // "unix:/path" end points: an AF_UNIX stream socket (with the options sc),
+     // and its address; returns 0, or -1 with the error in error
+     int UnixSocket(const EndPoint &ep, TCPSocketOptions *sc,
+                    struct sockaddr_storage *addr, socklen_t *addrlen, int &error);
   private:
+    friend class TCPClientSocket;
+    friend class TCPServerSocket;
+
     SOCKET sock_fd;
+    int send_timeout_ms;
+    int recv_timeout_ms;
+    std::shared_ptr<ShmChannel> shm_;
+    // accepted by a shm:/path listener, channel not set up yet
+    bool shm_pending_;
   };
 
+  // both socket classes also take "unix:/path" end points (see EndPoint.h):
+  // a Unix domain stream socket, for peers on the same host, and "shm:/path"
+  // end points: a shared memory channel set up over such a socket
   class TCPClientSocket : public TCPSocket
   {
      public:
@@ -55,10 +118,29 @@ namespace CSE384
   class TCPServerSocket : public TCPSocket
   {
     public:
-      void Bind(const EndPoint &ep, TCPSocketOptions *sc = nullptr);
+      // reuse_port: SO_REUSEPORT, so other sockets can bind (and listen on) ep too
+      // (throws SocketOptionsException where not supported)
+      // unix:/path, shm:/path: a socket file left at path by a listener that is no
+      // longer running (connecting to it is refused) is replaced; while a listener
+      // still accepts connections at path: ReceiverBindException (EADDRINUSE).
+      // reuse_port is not supported (SocketOptionsException).
+      // shm:/path: Accept() also sets up the client's shared memory channel (a
+      // client that does not complete it within 2 seconds is closed, and Accept
+      // returns an invalid socket)
+      void Bind(const EndPoint &ep, TCPSocketOptions *sc = nullptr, bool reuse_port = false);
       TCPSocket Accept();
+      // Accept() without the shared memory channel set up (shm:/path): the caller
+      // completes it with CompleteAccept(), e.g. on another thread so a slow
+      // client does not hold up the accept loop
+      TCPSocket AcceptDeferred();
       void Listen(int backlog);
-     
+      // also removes the socket file of a unix:/path listener
+      int Close();
+
+    private:
+      std::string unix_path_;
+      // accepted sockets get a shared memory channel (shm:/path)
+      bool shm_listener_ = false;
   };
 
 
@@ -105,24 +187,39 @@ namespace CSE384
     return sock_fd;
   }
 
-  inline bool TCPSocket::IsValid() const
+  inline int TCPSocket::SetNonBlocking(bool nonblocking)
   {
-    return (sock_fd != INVALID_SOCKET);
+    return set_nonblocking_portable(sock_fd, nonblocking);
+  }
+
+  inline void TCPSocket::SendTimeout(int timeout_ms)
+  {
+    send_timeout_ms = timeout_ms;
   }
 
-  inline int TCPSocket::Shutdown()
+  inline int TCPSocket::SendTimeout() const
   {
-    return shutdown(sock_fd, SD_BOTH);
+    return send_timeout_ms;
   }
 
-  inline int TCPSocket::ShutdownSend()
+  inline void TCPSocket::RecvTimeout(int timeout_ms)
   {
-    return shutdown(sock_fd, SD_SEND);
+    recv_timeout_ms = timeout_ms;
+  }
+
+  inline int TCPSocket::RecvTimeout() const
+  {
+    return recv_timeout_ms;
+  }
+
+  inline bool TCPSocket::IsValid() const
+  {
+    return (sock_fd != INVALID_SOCKET);
   }
 
-  inline int TCPSocket::ShutdownRecv()
+  inline bool TCPSocket::IsShm() const
   {
-    return shutdown(sock_fd, SD_RECEIVE);
+    return (shm_ != nullptr);
   }
 
   inline bool TCPClientSocket::IsConnected() const
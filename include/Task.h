@@ -19,6 +19,13 @@
  * parameters before the threadpool executes it.  If you really want
  * to pass the callable object by reference you can do that with
  * std::ref(co).  But do that carefully.
+ *
+ * Task<0> runs its callable objects on CSE384::WorkStealingPool::Shared()
+ * instead: sized at run time to the available cores (cgroup CPU quota
+ * included) with per-thread queues, and shared with everything else using
+ * that pool (e.g. TCPResponders).  The bool returned by a work item is
+ * ignored there, and wait() returns once all of the pool's work is done
+ * (the pool keeps running).
  */
 /*
  * ToDo:
@@ -28,6 +35,7 @@
 #include <functional>
 #include <memory>
 #include "ThreadPool.h"
+#include "WorkStealingPool.h"
 
 template<size_t numThreads = 8>
 class Task
@@ -65,3 +73,21 @@ void Task<numThreads>::wait()
   trpl_.wait();
 }
 
+
+//----< Task<0>: the shared, runtime sized pool >--------------------
+
+template<>
+class Task<0>
+{
+public:
+  using CallObj = std::function<bool()>;
+
+  Task() {}
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  void workItem(CallObj co) { threadPool().WorkItem([co]() { co(); }); }
+  void wait() { threadPool().Wait(); }
+  std::mutex& mutex() { static std::mutex mtx; return mtx; }
+  static CSE384::WorkStealingPool& threadPool() { return CSE384::WorkStealingPool::Shared(); }
+};
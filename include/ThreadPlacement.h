@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////////////
+// ThreadPlacement.h - cpu set, NUMA node and name of MPL threads          //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  A ThreadPlacement says where the threads of a component may run and how
+ *  they are named.  Every thread MPL starts (connector send/receive threads,
+ *  client handler threads, listener/accept threads, reactor threads and pool
+ *  workers) applies its component's placement to itself when it starts:
+ *  - Cpus(list) or NumaNode(n): the cpus the threads may run on (a NUMA
+ *    node's cpus keep the threads, and the memory they touch first, on that
+ *    node).  No cpus (the default): the threads run anywhere
+ *  - Spread(true): each thread is pinned to one cpu of the set, round robin
+ *    by its index (worker i, shard i, ...), instead of floating over the set
+ *  - Name(prefix): threads are named prefix + role (e.g. "mpl-send",
+ *    "mpl-worker3"), visible in top -H, ps -L and debuggers (at most 15
+ *    characters on Linux).  The default prefix is "mpl-"
+ *
+ *  USAGE:  ThreadPlacement io;
+ *          io.NumaNode(0).Spread(true);
+ *          responder.Placement(io);          // before Start()
+ *          connector.Placement(ThreadPlacement().Cpus("4-7"));
+ *
+ *  Windows: cpu sets are applied (cpus 0..63), NUMA nodes and names are not.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _THREAD_PLACEMENT_H_
+#define _THREAD_PLACEMENT_H_
+
+#include <string>
+#include <vector>
+
+namespace CSE384
+{
+    class ThreadPlacement
+    {
+    public:
+        ThreadPlacement();
+
+        ThreadPlacement &Cpus(const std::vector<int> &cpus);
+        // Linux cpu list syntax: "0-3,8,10-11"
+        ThreadPlacement &Cpus(const std::string &cpu_list);
+        // the cpus of NUMA node (none where the node does not exist)
+        ThreadPlacement &NumaNode(int node);
+        ThreadPlacement &Spread(bool spread);
+        ThreadPlacement &Name(const std::string &prefix);
+
+        const std::vector<int> &Cpus() const;
+        bool Spread() const;
+        const std::string &Name() const;
+
+        // place and name the calling thread: role names it, index picks its
+        // cpu when spreading.  Returns false if the cpu set could not be applied
+        bool Apply(const std::string &role, size_t index = 0) const;
+
+        // NUMA nodes of this machine (1 where there is no NUMA information)
+        static int NumNodes();
+        static std::vector<int> NodeCpus(int node);
+        static std::vector<int> ParseCpuList(const std::string &cpu_list);
+
+    private:
+        std::vector<int> cpus_;
+        bool spread_;
+        std::string name_;
+    };
+
+    inline const std::vector<int> &ThreadPlacement::Cpus() const
+    {
+        return cpus_;
+    }
+
+    inline bool ThreadPlacement::Spread() const
+    {
+        return spread_;
+    }
+
+    inline const std::string &ThreadPlacement::Name() const
+    {
+        return name_;
+    }
+}
+
+#endif
@@ -19,9 +19,12 @@
 * included in the callable object's capture list (lambda) or as member
 * data (functor).
 *
-* The thread pool can be shut down by enqueuing a work item that returns
-* false.  Each thread executes the work item and if false encqueus the 
-* same workItem and then exits.  This means that each thread will terminate.
+* The thread pool is shut down with stop(): it closes the queue, each
+* thread finishes the work items still queued and then exits (no sentinel
+* work item).  A work item returning false has the same effect.
+*
+* Debug output goes through AsyncLog (MPL_LOG_DEBUG): nothing is formatted
+* unless the asynchronous logger is started at the Debug level.
 */
 /*
  * ToDo:
@@ -36,6 +39,7 @@
 
 #include "Cpp11-BlockingQueue.h"
 #include "Logger.h"
+#include "AsyncLog.h"
 #include "Utilities.h"
 
 //#include "../Cpp11-BlockingQueue/Cpp11-BlockingQueue.h"
@@ -55,7 +59,9 @@ public:
   ThreadPool(const ThreadPool&) = delete;
   ThreadPool& operator=(const ThreadPool&) = delete;
 
-  void workItem(CallObj& co);
+  void workItem(CallObj co);
+  // no more work: the threads exit once the queued items are done (see wait())
+  void stop();
   void wait();
   std::mutex& mutex();
   ~ThreadPool();
@@ -76,56 +82,46 @@ ThreadPool<numThreads>::ThreadPool()
 {
   threadProc_ = [this]()  // all threads use this to acquire their callable objects.
   {
-    while (true)
+    CallObj co;
+    while (Q_.deQ(co))
     {
-      CallObj co = Q_.deQ();
       if (!co())
       {
-        Q_.enQ(co);
+        Q_.close();
         break;
       }
     }
-    DebugLog::write(
-      "\n  thread " +
-      Utilities::Converter<std::thread::id>::toString(std::this_thread::get_id()) +
-      " terminating"
-      );
+    MPL_LOG_DEBUG("threadpool thread terminating");
   };
   for (size_t i = 0; i < numThreads; ++i)
   {
     std::thread t(threadProc_);
-    DebugLog::write(
-      "\n--starting threadpool thread " +
-      Utilities::Converter<std::thread::id>::toString(t.get_id())
-      );
+    MPL_LOG_DEBUG("starting threadpool thread {} of {}", i + 1, numThreads);
     threads_.push_back(std::move(t));
   }
 }
 
 template <size_t numThreads>
-void ThreadPool<numThreads>::workItem(CallObj& co)
+void ThreadPool<numThreads>::workItem(CallObj co)
+{
+  Q_.enQ(std::move(co));
+  MPL_LOG_DEBUG("threadpool queue size = {}", Q_.size());
+}
+
+template <size_t numThreads>
+void ThreadPool<numThreads>::stop()
 {
-  Q_.enQ(co);
-  DebugLog::write(
-    "\n--threadpool queue size = " +
-    Utilities::Converter<size_t>::toString(Q_.size())
-  );
+  Q_.close();
 }
 
 template <size_t numThreads>
 void ThreadPool<numThreads>::wait()
 {
-  DebugLog::write(
-    "\n  entering wait with queue size = " +
-    Utilities::Converter<size_t>::toString(Q_.size())
-    );
+  MPL_LOG_DEBUG("entering wait with queue size = {}", Q_.size());
   for (auto& thrd : threads_)
     thrd.join();
   Q_.clear();
-  DebugLog::write(
-    "\n--leaving wait with queue size = " +
-    Utilities::Converter<size_t>::toString(Q_.size())
-    );
+  MPL_LOG_DEBUG("leaving wait with queue size = {}", Q_.size());
 }
 
 template<size_t numThreads>
@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////////
+// WorkStealingPool.h - runtime sized thread pool with per worker queues   //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ *  ThreadPool<N> fixes its thread count at compile time and all of its
+ *  threads take work from one shared (mutex guarded) queue, which becomes
+ *  the bottleneck for short work items.  WorkStealingPool:
+ *  - is sized at run time, by default to AvailableCores(): the cores this
+ *    process may run on (CPU affinity), capped by the cgroup CPU quota
+ *    (containers), at least one
+ *  - gives every worker its own queue: a work item posted from a worker
+ *    goes to that worker's queue (taken newest first, while its data is
+ *    still in the cache), other items are spread round robin.  An idle
+ *    worker takes the oldest item of another worker's queue (steals)
+ *    before it sleeps
+ *  - can be shared: several TCPResponders (see TCPResponder::UseThreadPool)
+ *    and Task<0> can run on one pool.  Shared() is a process wide instance
+ *
+ *  USAGE:  WorkStealingPool pool;          // AvailableCores() threads
+ *          pool.WorkItem([]() { ... });
+ *          pool.Wait();                    // every posted item has run
+ *          pool.Stop();                    // (or the destructor)
+ *
+ *  Wait() must not be called from a work item of the same pool.
+ *
+ * Maintenance:
+ * ===========
+ *  ver 1.0 : first release
+*/
+
+#ifndef _WORK_STEALING_POOL_H_
+#define _WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ThreadPlacement.h"
+
+namespace CSE384
+{
+    class WorkStealingPool
+    {
+    public:
+        using CallObj = std::function<void()>;
+
+        // num_threads 0: AvailableCores(); worker i applies placement with index i
+        WorkStealingPool(size_t num_threads = 0, const ThreadPlacement &placement = ThreadPlacement());
+        ~WorkStealingPool();
+
+        void WorkItem(CallObj co);
+        // returns once every work item posted so far has run (the pool keeps running)
+        void Wait();
+        // runs the queued work items, then joins the threads (no more work items)
+        void Stop();
+
+        size_t NumThreads() const;
+        // work items queued, not yet started
+        size_t Queued() const;
+        // work items a worker took from another worker's queue
+        uint64_t Steals() const;
+
+        // processors available to this process: affinity mask, capped by the
+        // cgroup (v2 cpu.max or v1 cfs quota) CPU limit, at least 1
+        static size_t AvailableCores();
+        // process wide pool with AvailableCores() threads, created on first use
+        static WorkStealingPool &Shared();
+
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    private:
+        struct alignas(64) Worker
+        {
+            std::mutex mtx;
+            std::deque<CallObj> items;
+            std::thread thread;
+        };
+
+        void WorkerProc(size_t self);
+        // own queue, newest first
+        bool PopLocal(size_t self, CallObj &co);
+        // other queues, oldest first
+        bool Steal(size_t self, CallObj &co);
+        void Run(CallObj &co);
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+        ThreadPlacement placement_;
+        std::atomic<size_t> next_;
+        std::atomic<size_t> queued_;
+        std::atomic<size_t> pending_;
+        std::atomic<uint64_t> steals_;
+
+        // idle workers sleep here until an item is queued (or Stop)
+        std::mutex idle_mtx_;
+        std::condition_variable idle_cv_;
+        std::atomic<int> sleepers_;
+        bool stopping_;
+
+        std::mutex done_mtx_;
+        std::condition_variable done_cv_;
+        std::mutex stop_mtx_;
+    };
+
+    inline size_t WorkStealingPool::NumThreads() const
+    {
+        return workers_.size();
+    }
+
+    inline size_t WorkStealingPool::Queued() const
+    {
+        return queued_.load();
+    }
+
+    inline uint64_t WorkStealingPool::Steals() const
+    {
+        return steals_.load();
+    }
+}
+
+#endif
@@ -14,7 +14,19 @@
 #include "SenderExceptions.h"
 #include "ThreadPool.h"
 #include "Message.h"
+#include "MessagePool.h"
 #include "TCPConnector.h"              
+#include "ReceiveRingBuffer.h"
+#include "Reactor.h"
+#include "ConnectorGroup.h"
+#include "IoUring.h"
+#include "LockFreeQueue.h"
+#include "WorkStealingPool.h"
+#include "ThreadPlacement.h"
+#include "AsyncLog.h"
+#include "ShmChannel.h"
+#include "InProc.h"
+#include "FileMessage.h"
 #include "Utilities.h"
 #include "StopWatch.h"
 
@@ -0,0 +1,244 @@
+/////////////////////////////////////////////////////////////////////////////
+// AsyncLog.cpp - low overhead asynchronous logging with levels            //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AsyncLog.h"
+#include "LockFreeQueue.h"
+
+namespace CSE384
+{
+    std::atomic<int> AsyncLog::threshold_((int)LogLevel::Off);
+
+    namespace
+    {
+        // one per logging thread: written by that thread, drained by the logger thread
+        struct LogRing
+        {
+            LogRing(int id) : id(id), records(AsyncLog::RING_CAPACITY) {}
+            int id;
+            SPSCQueue<LogRecord> records;
+        };
+
+        // the logger thread waits this long for more records (Flush/Stop wake it)
+        const std::chrono::milliseconds IDLE_WAIT(20);
+
+        struct LogState
+        {
+            std::mutex mtx;
+            std::condition_variable wake;
+            std::condition_variable flushed;
+            std::vector<std::shared_ptr<LogRing>> rings;
+            std::ostream *out = nullptr;
+            std::thread thread;
+            bool running = false;
+            bool stopping = false;
+            LogLevel level = LogLevel::Info;
+            uint64_t flush_requested = 0;
+            uint64_t flush_done = 0;
+            int next_id = 0;
+            std::atomic<uint64_t> dropped{0};
+        };
+
+        // constructed on first use (logging may start before main)
+        LogState &State()
+        {
+            static LogState *state = new LogState();
+            return *state;
+        }
+
+        thread_local std::shared_ptr<LogRing> this_ring;
+
+        const char *LevelName(LogLevel level)
+        {
+            static const char *names[] = {"TRACE", "DEBUG", "INFO ", "WARN ", "ERROR", "OFF  "};
+            return names[(int)level];
+        }
+
+        void WriteRecord(std::ostream &out, int thread_id, const LogRecord &rec)
+        {
+            // UTC time of day
+            int64_t micros = (rec.nanos / 1000) % (86400LL * 1000000);
+            int64_t secs = micros / 1000000;
+            char prev = out.fill('0');
+            out << std::setw(2) << secs / 3600 << ':' << std::setw(2) << (secs / 60) % 60 << ':'
+                << std::setw(2) << secs % 60 << '.' << std::setw(6) << micros % 1000000;
+            out.fill(prev);
+            out << ' ' << LevelName(rec.level) << " [t" << thread_id << "] ";
+            rec.format(out, rec.fmt, rec.payload);
+            out << '\n';
+        }
+
+        void LoggerProc()
+        {
+            LogState &s = State();
+            std::unique_lock<std::mutex> lock(s.mtx);
+            LogRecord rec;
+            for (;;)
+            {
+                uint64_t flush_gen = s.flush_requested;
+                std::vector<std::shared_ptr<LogRing>> rings = s.rings;
+                std::ostream *out = s.out;
+                lock.unlock();
+
+                size_t written = 0;
+                for (auto &ring : rings)
+                {
+                    while (ring->records.try_deQ(rec))
+                    {
+                        if (out != nullptr)
+                            WriteRecord(*out, ring->id, rec);
+                        ++written;
+                    }
+                }
+                if (out != nullptr && written > 0)
+                    out->flush();
+                // the registry alone must hold the rings of exited threads
+                rings.clear();
+
+                lock.lock();
+                // rings of exited threads (only the registry holds them), once drained
+                for (size_t i = 0; i < s.rings.size();)
+                {
+                    if (s.rings[i].use_count() == 1 && s.rings[i]->records.size() == 0)
+                    {
+                        s.rings[i] = s.rings.back();
+                        s.rings.pop_back();
+                    }
+                    else
+                        ++i;
+                }
+
+                s.flush_done = flush_gen;
+                s.flushed.notify_all();
+                if (written == 0)
+                {
+                    if (s.stopping)
+                        break;
+                    s.wake.wait_for(lock, IDLE_WAIT, [&s]() { return s.stopping || s.flush_requested > s.flush_done; });
+                }
+            }
+        }
+    }
+
+    std::ostream &operator<<(std::ostream &out, const LogText &t)
+    {
+        return out.write(t.text, t.len);
+    }
+
+    const char *AsyncLog::FormatUpTo(std::ostream &out, const char *fmt)
+    {
+        const char *p = std::strstr(fmt, "{}");
+        if (p == nullptr)
+        {
+            // more arguments than "{}": append them
+            out << fmt << ' ';
+            return "";
+        }
+        out.write(fmt, p - fmt);
+        return p + 2;
+    }
+
+    void AsyncLog::Post(const LogRecord &rec)
+    {
+        if (!this_ring)
+        {
+            LogState &s = State();
+            std::lock_guard<std::mutex> lock(s.mtx);
+            this_ring = std::make_shared<LogRing>(s.next_id++);
+            s.rings.push_back(this_ring);
+        }
+        if (!this_ring->records.try_enQ(rec))
+            ++State().dropped;
+    }
+
+    void AsyncLog::Attach(std::ostream *out)
+    {
+        LogState &s = State();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.out = out;
+    }
+
+    void AsyncLog::Start(LogLevel level)
+    {
+        LogState &s = State();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.level = level;
+        if (!s.running)
+        {
+            s.running = true;
+            s.stopping = false;
+            s.thread = std::thread(LoggerProc);
+        }
+        threshold_.store((int)level);
+    }
+
+    void AsyncLog::Stop()
+    {
+        LogState &s = State();
+        {
+            std::lock_guard<std::mutex> lock(s.mtx);
+            if (!s.running)
+                return;
+            threshold_.store((int)LogLevel::Off);
+            s.stopping = true;
+            s.wake.notify_all();
+        }
+        s.thread.join();
+
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.running = false;
+        s.flushed.notify_all();
+    }
+
+    void AsyncLog::Flush()
+    {
+        LogState &s = State();
+        std::unique_lock<std::mutex> lock(s.mtx);
+        if (!s.running)
+            return;
+        uint64_t gen = ++s.flush_requested;
+        s.wake.notify_all();
+        s.flushed.wait(lock, [&s, gen]() { return s.flush_done >= gen || !s.running; });
+    }
+
+    void AsyncLog::Level(LogLevel level)
+    {
+        LogState &s = State();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.level = level;
+        if (s.running && !s.stopping)
+            threshold_.store((int)level);
+    }
+
+    LogLevel AsyncLog::Level()
+    {
+        LogState &s = State();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        return s.level;
+    }
+
+    uint64_t AsyncLog::Dropped()
+    {
+        return State().dropped.load();
+    }
+
+    size_t AsyncLog::Rings()
+    {
+        LogState &s = State();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        return s.rings.size();
+    }
+}
@@ -2,6 +2,7 @@
 
 #include "ReceiverExceptions.h"
 #include "SenderExceptions.h"
+#include "TCPResponder.h"
 
 namespace CSE384
 {
@@ -25,6 +26,10 @@ namespace CSE384
         {
             if (IsReceiving())
             {
+                // a full receive ring nobody reads must not keep the receive thread waiting
+                if (recv_lfq_)
+                    recv_lfq_->close();
+
                 if (recvThread.joinable())
                     recvThread.join();
                 IsReceiving(false);
@@ -40,12 +45,17 @@ namespace CSE384
 
     void ClientHandler::ShutdownRecv()
     {
-        data_socket.ShutdownRecv();
+        if (inproc_)
+            inproc_->to_server.CloseRead();
+        else
+            data_socket.ShutdownRecv();
     }
 
 
     void ClientHandler::RecvProc()
     {     
+        // spread over the set: the receive and send threads of a client side by side
+        placement_.Apply("ch-recv", 2 * (size_t)GetClientId());
         try
         {
             IsReceiving(true);
@@ -53,7 +63,10 @@ namespace CSE384
             do
             {
                 msg = RecvSocketMessage();
-                recv_queue_.enQ(msg);
+                if (recv_lfq_)
+                    recv_lfq_->enQ(msg);
+                else
+                    recv_queue_.enQ(msg);
             } 
             while (msg->GetType() != MessageType::DISCONNECT);
         }
@@ -62,26 +75,55 @@ namespace CSE384
             std::cerr << ex.what() << std::endl;
             // IsReceiving(false);
         }
+
+        // nothing more will arrive: GetMessage() must not wait forever
+        if (recv_lfq_)
+            recv_lfq_->close();
+        else
+            recv_queue_.close();
     }
 
    // serialize the message header and message and write them into the socket
    MessagePtr ClientHandler::RecvSocketMessage()
    {
+      // buffered strategy: decode many frames per recv() call
+      if (recv_ring_)
+         return recv_ring_->NextMessage(data_socket);
+
       struct MSGHEADER mhdr;
-      int recv_bytes;
+      long long recv_bytes;
       // receive fixed size message header (see wire protocol in Message.h)
-      if ((recv_bytes = data_socket.Recv((const char *)&mhdr, sizeof(MSGHEADER),MSG_WAITALL,1)) == sizeof(MSGHEADER))
+      if ((recv_bytes = data_socket.Recv((const char *)&mhdr, sizeof(MSGHEADER),MSG_WAITALL,1)) == (long long) sizeof(MSGHEADER))
       {
          // *** MUST convert message header to host byte order (e.g. Intel CPU == little endian)
          mhdr.ToHostByteOrder();
 
          //construct a Message using the Message header read from the socket channel
          // *** critical that mhdr is host byte order ****
-         MessagePtr msgPtr(new Message(mhdr));
+         char ext[MSGHEADER::MAX_EXT_SIZE];
+         size_t length = mhdr.len();
+         int type = mhdr.type();
+         if (mhdr.IsExtended())
+         {
+            // extended header: receive the type/length extension following the legacy word
+            if (mhdr.ExtVersion() != MSGHEADER::EXT_VERSION)
+               throw ReceiverReceiveMessageHeaderException(EPROTO);
+
+            if (data_socket.Recv(ext, mhdr.ExtSize(), MSG_WAITALL, 1) != (long long) mhdr.ExtSize())
+               throw ReceiverReceiveMessageHeaderException(getlasterror_portable());
+
+            mhdr.DecodeExt(ext, length, type);
+         }
+
+         // refuse the frame before its body is allocated
+         if (length > MaxFrameSize())
+            throw ReceiverReceiveMessageHeaderException(EMSGSIZE);
 
-         // send message data
-         if (data_socket.Recv(msgPtr->GetData(), msgPtr->Length(), MSG_WAITALL,1) == -1)
-            throw ReceiverReceiveMessageDataException(getlasterror_portable());
+         MessagePtr msgPtr = mhdr.IsExtended() ? Message::CreateMessage(mhdr, ext) : Message::CreateMessage(mhdr);
+
+         // receive message data: the peer closing in the middle of the body is an error
+         if ((recv_bytes = data_socket.Recv(msgPtr->GetData(), msgPtr->Length(), MSG_WAITALL,1)) != (long long) msgPtr->Length())
+            throw ReceiverReceiveMessageDataException(recv_bytes == -1 ? getlasterror_portable() : ECONNRESET);
 
          return msgPtr;
       }
@@ -89,7 +131,7 @@ namespace CSE384
       // if read zero bytes, thyen this is the zero length message signaling client shutdown
       if (recv_bytes == 0)
       {
-         return MessagePtr(new Message(nullptr, 0, DISCONNECT));
+         return Message::CreateMessage(nullptr, 0, DISCONNECT);
       }
       else
       {
@@ -100,34 +142,134 @@ namespace CSE384
    // serialize the message header and message and write them into the socket
    void ClientHandler::SendSocketMessage(const MessagePtr &msg)
    {
-      // Note: could do the send in one call (same as for the Fixed message), but choosing 
-        // not to here. instead send the fixed size header, followed by the variable length data
-        /* 
-        msg->GetHeader()->ToNetorkByteOrder();
-        if (data_socket.Send(msg->GetRawMsg(), msg->RawMsgLength(),0,1) == -1)
-        {
-            msg->GetHeader()->ToHostByteOrder();
-            throw SenderTransmitMessageDataException(getlasterror_portable());
-        }
-        msg->GetHeader()->ToHostByteOrder();
-        */
+      // send the header and the variable length data with one (gather) system call;
+      // the header is sent from the message's pre-encoded wire header (see Message::GatherFrames)
+      IOVEC iov[2];
+      Message::GatherFrames(&msg, 1, false, iov);
 
-        // convert the wire protocol (message header) to big endian (network byte order)
-        msg->GetHeader()->ToNetorkByteOrder();  
+      if (data_socket.SendV(iov, 2, 0, 1) == -1)
+         throw SenderTransmitMessageDataException(getlasterror_portable());
+   }
 
-        // send message header
-        if(data_socket.Send( (const char*) msg->GetHeader(), sizeof(struct MSGHEADER), 0,1) == -1)
-        {
-           msg->GetHeader()->ToHostByteOrder();
-           throw SenderTransmitMessageHeaderException(getlasterror_portable());
-        }
-        msg->GetHeader()->ToHostByteOrder();
+   // serialize a batch of messages (headers and data) into the socket with one gather send
+   void ClientHandler::SendSocketMessages(const std::vector<MessagePtr> &batch)
+   {
+      std::vector<IOVEC> iov(batch.size() * 2);
+      GatherMessages(batch.data(), batch.size(), iov.data());
 
-        // send message data
-        if(data_socket.Send(msg->GetData(), msg->Length(),0,1) == -1)
-           throw SenderTransmitMessageDataException(getlasterror_portable());
+      if (data_socket.SendV(iov.data(), (int) iov.size(), 0, 1) == -1)
+         throw SenderTransmitMessageDataException(getlasterror_portable());
    }
 
+
+   void ClientHandler::GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov)
+   {
+      Message::GatherFrames(msgs, count, false, iov);
+   }
+
+   MessagePtr ClientHandler::DecodeMessage(ReceiveRingBuffer &rb)
+   {
+      // the reactor's buffers are shared by its connections
+      rb.MaxFrameSize(MaxFrameSize());
+      return rb.Decode();
+   }
+
+   void ClientHandler::OnMessage(const MessagePtr &/*msg*/)
+   {
+   }
+
+   TCPSocket &ClientHandler::ChannelSocket()
+   {
+      return data_socket;
+   }
+
+   BlockingQueue<MessagePtr> &ClientHandler::ChannelSendQueue()
+   {
+      return send_bq_;
+   }
+
+   // reactor mode teardown (what ServiceClient() does in thread pool mode)
+   void ClientHandler::ChannelClosed()
+   {
+      if (responder_ != nullptr)
+         responder_->UnregisterClient(this);
+      Close();
+      delete this;
+   }
+
+   void ClientHandler::PostMessage(const MessagePtr &msg)
+   {
+      // in-process: the client takes the message itself (dropped once it closed)
+      if (inproc_)
+      {
+         inproc_->to_client.Put(msg);
+         return;
+      }
+
+      if (send_lfq_)
+      {
+         send_lfq_->enQ(msg);
+         return;
+      }
+
+      send_bq_.enQ(msg);
+
+      // reactor mode: the I/O thread sends (there is no send thread)
+      if (reactor_ != nullptr)
+         reactor_->WakeSend(this);
+   }
+
+   bool ClientHandler::TryPostMessage(const MessagePtr &msg)
+   {
+      if (inproc_)
+         return inproc_->to_client.Put(msg);
+
+      if (send_lfq_)
+         return send_lfq_->try_enQ(msg);
+
+      PostMessage(msg);
+      return true;
+   }
+
+   void ClientHandler::SendMessage(const MessagePtr &msg)
+   {
+      if (inproc_)
+      {
+         if (!inproc_->to_client.Put(msg))
+            throw SenderTransmitMessageDataException(EPIPE);
+         return;
+      }
+
+      // the reactor owns the (non-blocking) socket: queue instead of writing directly
+      if (reactor_ != nullptr)
+         PostMessage(msg);
+      else
+         SendSocketMessage(msg);
+   }
+
+   void ClientHandler::SendFileMessage(int type, int file_fd, long long offset, size_t len)
+   {
+      // no socket of our own to write to (in-process, reactor): an ordinary message
+      if (inproc_ || reactor_ != nullptr)
+         SendMessage(FileMessage::Load(type, file_fd, offset, len));
+      else
+         FileMessage::Send(data_socket, type, file_fd, offset, len);
+   }
+
+   MessagePtr ClientHandler::ReceiveFileMessage(int file_type, int file_fd, long long offset, size_t& written,
+                                                size_t max_len)
+   {
+      written = 0;
+      if (!inproc_ && !recv_ring_)
+         return FileMessage::Receive(data_socket, file_type, file_fd, offset, written, max_len, MaxFrameSize());
+
+      // in-process, or the bytes may already be in the receive buffer
+      MessagePtr msg = ReceiveMessage();
+      if (msg->GetType() != file_type)
+         return msg;
+      written = FileMessage::Store(msg, file_fd, offset, max_len);
+      return Message::CreateMessage(nullptr, 0, file_type);
+   }
   
    void ClientHandler::StartSending()
    {
@@ -145,37 +287,68 @@ namespace CSE384
 
    void ClientHandler::SendProc()
    {  
+       placement_.Apply("ch-send", 2 * (size_t)GetClientId() + 1);
        try
        {
            IsSending(true);
-           MessagePtr msg = send_bq_.deQ();
-          
-           // if this is the stop sending message, signal
-           // the send thread to shutdown
-           while (msg->GetType() != STOP_SENDING)
+
+           // until StopSending() closes the send queue (and it is drained)
+           if (UseSendDrain())
+           {
+               // drain mode: every message queued by one wakeup goes out with one gather send
+               std::vector<MessagePtr> batch;
+               while (NextSendBatch(batch))
+                   SendSocketMessages(batch);
+           }
+           else
            {
-               // deque the next message
-               SendSocketMessage(msg);
-               msg = send_bq_.deQ();        
+               MessagePtr msg;
+               while (NextSend(msg))
+                   SendSocketMessage(msg);
            }
        }
        catch (...)
        {
-          // IsSending(false);
+          // nobody drains the ring any more: don't let posting threads wait for room
+          if (send_lfq_)
+             send_lfq_->close();
        }
    }
 
-   
-   void ClientHandler::StopSending()
+   bool ClientHandler::NextSend(MessagePtr& msg)
+   {
+       if (send_lfq_)
+           return send_lfq_->deQ(msg);
+       return send_bq_.deQ(msg);
+   }
+
+   bool ClientHandler::NextSendBatch(std::vector<MessagePtr>& batch)
+   {
+       batch.clear();
+       if (!send_lfq_)
+           return send_bq_.deQ_bulk(batch, MAX_SEND_BATCH) > 0;
+
+       MessagePtr msg;
+       if (!send_lfq_->deQ(msg))
+           return false;
+       batch.push_back(std::move(msg));
+       while (batch.size() < MAX_SEND_BATCH && send_lfq_->try_deQ(msg))
+           batch.push_back(std::move(msg));
+       return true;
+   }
+
+      void ClientHandler::StopSending()
    {
        
        try
        {
            if (IsSending())
            {
-               //note: only gets deposited into queue if IsSending is true
-               MessagePtr stopMsg(new Message(nullptr, 0, STOP_SENDING));
-               send_bq_.enQ(stopMsg);
+               // the send thread drains the queue, then sees it closed
+               if (send_lfq_)
+                  send_lfq_->close();
+               else
+                  send_bq_.close();
 
                // make the calling thread wait for the send thread to finish
                if (sendThread.joinable())
@@ -194,7 +367,23 @@ namespace CSE384
 
    void ClientHandler::ShutdownSend()
    {
-       data_socket.ShutdownSend();
+       if (inproc_)
+           inproc_->to_client.CloseWrite();
+       else
+           data_socket.ShutdownSend();
+   }
+
+   void ClientHandler::Drop()
+   {
+       if (!dropped_.exchange(true))
+       {
+           // shut the socket down in both directions: the send thread fails out and
+           // the AppProc() receive sees a DISCONNECT (queued messages go with the handler)
+           if (inproc_)
+               inproc_->Close();
+           else
+               data_socket.Shutdown();
+       }
    }
 
    FixedSizeMsgClientHander::FixedSizeMsgClientHander(int msg_size) : msg_size_(msg_size)
@@ -204,20 +393,26 @@ namespace CSE384
    // serialize the message header and message and write them into the socket
    MessagePtr FixedSizeMsgClientHander::RecvSocketMessage()
    {
+      // buffered strategy: decode many frames per recv() call
+      if (RecvRingBuffer())
+         return RecvRingBuffer()->NextFixedSizeMessage(GetDataSocket(), msg_size_);
+
       // create the fixed message recieve that message size from the socket
-      MessagePtr msgPtr = Message::CreateEmptyFixedSizeMessage(msg_size_);
-      int recv_bytes;
-      if ((recv_bytes = GetDataSocket().Recv(msgPtr->GetRawMsg(), msgPtr->RawMsgLength(), MSG_WAITALL,1)) == msgPtr->RawMsgLength())
+      MessagePtr msgPtr = Message::AllocateFixedSizeMessage(msg_size_);
+      long long recv_bytes;
+      if ((recv_bytes = GetDataSocket().Recv(msgPtr->GetRawMsg(), msgPtr->RawMsgLength(), MSG_WAITALL,1)) == (long long) msgPtr->RawMsgLength())
       {
          // *** MUST convert message header to host byte order (e.g. Intel CPU == little endian)
          msgPtr->GetHeader()->ToHostByteOrder();
+         if (!msgPtr->ParseHeader())
+            throw ReceiverReceiveMessageHeaderException(EBADMSG);
          return msgPtr;
       }
 
       // if read zero bytes, then this is the zero length message signaling client shutdown
       if (recv_bytes == 0)
       {
-         return MessagePtr(new Message(nullptr, 0, DISCONNECT));
+         return Message::CreateMessage(nullptr, 0, DISCONNECT);
       }
       else
       {
@@ -225,16 +420,27 @@ namespace CSE384
       }
    }
 
+   void FixedSizeMsgClientHander::GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov)
+   {
+      // fixed size messages always put the whole (raw) message on the wire
+      Message::GatherFrames(msgs, count, true, iov);
+   }
+
+   MessagePtr FixedSizeMsgClientHander::DecodeMessage(ReceiveRingBuffer &rb)
+   {
+      return rb.DecodeFixedSize(msg_size_);
+   }
+
    // serialize the message header and message and write them into the socket
    void FixedSizeMsgClientHander::SendSocketMessage(const MessagePtr &msg)
    {
-      msg->GetHeader()->ToNetorkByteOrder();
-      if (GetDataSocket().Send(msg->GetRawMsg(), msg->RawMsgLength(),0,1) == -1)
-      {
-         msg->GetHeader()->ToHostByteOrder();
+      // the whole (fixed size) raw message, from the pre-encoded wire header:
+      // the message is not modified, so it may be sent on many connections at once
+      IOVEC iov[2];
+      Message::GatherFrames(&msg, 1, true, iov);
+
+      if (GetDataSocket().SendV(iov, 2, 0, 1) == -1)
          throw SenderTransmitMessageDataException(getlasterror_portable());
-      }
-      msg->GetHeader()->ToHostByteOrder();
    }
 
 } // namespace CSE384
@@ -0,0 +1,47 @@
+/////////////////////////////////////////////////////////////////////////////
+// ConnectorGroup.cpp - many TCPConnectors serviced by a few epoll threads //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ConnectorGroup.h"
+
+namespace CSE384
+{
+    ConnectorGroup::ConnectorGroup(int num_threads, const ThreadPlacement &placement) : next_(0)
+    {
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+        for (int i = 0; i < (num_threads < 1 ? 1 : num_threads); ++i)
+        {
+            reactors_.emplace_back(new Reactor());
+            reactors_.back()->Start(placement, i);
+        }
+#endif
+    }
+
+    ConnectorGroup::~ConnectorGroup()
+    {
+        // returns once every connector has closed
+        for (auto &reactor : reactors_)
+            reactor->Finish();
+    }
+
+    size_t ConnectorGroup::NumConnections() const
+    {
+        size_t n = 0;
+        for (auto &reactor : reactors_)
+            n += reactor->NumConnections();
+        return n;
+    }
+
+    Reactor *ConnectorGroup::NextReactor()
+    {
+        if (reactors_.empty())
+            return nullptr;
+        return reactors_[next_++ % reactors_.size()].get();
+    }
+}
@@ -79,6 +79,34 @@ int main()
   std::cout << "\n    q3.size() = " << q3.size();
   std::cout << "\n    q3 element = " << q3.deQ() << "\n";
 
+  std::cout << "\n  Bulk dequeue and close (no sentinel)";
+  std::cout << "\n --------------------------------------";
+  BlockingQueue<std::string> q4;
+  std::thread consumer([&q4]()
+  {
+    std::vector<std::string> batch;
+    size_t n;
+    while ((n = q4.deQ_bulk(batch, 4)) > 0)
+    {
+      std::lock_guard<std::mutex> l(ioLock);
+      std::cout << "\n  thread deQed a batch of " << n;
+      batch.clear();
+    }
+    std::lock_guard<std::mutex> l(ioLock);
+    std::cout << "\n  queue closed and drained";
+  });
+  for (int i = 0; i < 10; ++i)
+    q4.emplace(3, 'x');
+  q4.close();
+  consumer.join();
+  BlockingQueue<std::string> q5(std::move(q4));
+  std::cout << "\n  moved from a closed queue: " << (q5.closed() ? "closed" : "open");
+  std::cout << "\n  try_enQ on a closed queue: " << (q5.try_enQ("late") ? "queued" : "refused");
+
+  std::string item;
+  std::cout << "\n  deQ_for on an empty queue: " << (q.deQ_for(item, std::chrono::milliseconds(10)) ? "item" : "timed out");
+  std::cout << "\n  try_deQ on an empty queue: " << (q.try_deQ(item) ? "item" : "empty");
+
   std::cout << "\n\n";
 }
 
@@ -13,6 +13,10 @@
 
 namespace CSE384 
 {
+   const std::string EndPoint::UNIX_PREFIX = "unix:";
+   const std::string EndPoint::SHM_PREFIX = "shm:";
+   const std::string EndPoint::INPROC_PREFIX = "inproc:";
+
    EndPoint::EndPoint():  _ip("NIP"), _port(0)
    {}
 
@@ -31,6 +35,19 @@ namespace CSE384
 
    void EndPoint::Parse(const std::string& serialized_ep)
    {
+     // plain "unix:/path", "shm:/path" or "inproc:name" (the serialized form is "EndPoint(unix:/path,0)")
+     for (const std::string* prefix : {&UNIX_PREFIX, &SHM_PREFIX, &INPROC_PREFIX})
+     {
+       if (serialized_ep.compare(0, prefix->size(), *prefix) != 0)
+         continue;
+       if (serialized_ep.size() == prefix->size())
+         throw BadEndPoint(prefix == &INPROC_PREFIX ? "in-process EndPoint without a name"
+                                                    : "Unix domain EndPoint without a path");
+       _ip = serialized_ep;
+       _port = 0;
+       return;
+     }
+
      try
      {
        //first, get the indices to extract the IP address part
@@ -96,6 +113,38 @@ namespace CSE384
      return _port;  
    }
 
+   bool EndPoint::IsUnix() const
+   {
+     return _ip.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0;
+   }
+
+   bool EndPoint::IsShm() const
+   {
+     return _ip.compare(0, SHM_PREFIX.size(), SHM_PREFIX) == 0;
+   }
+
+   bool EndPoint::IsLocal() const
+   {
+     return IsUnix() || IsShm();
+   }
+
+   std::string EndPoint::UnixPath() const
+   {
+     if (IsUnix())
+       return _ip.substr(UNIX_PREFIX.size());
+     return IsShm() ? _ip.substr(SHM_PREFIX.size()) : std::string();
+   }
+
+   bool EndPoint::IsInProc() const
+   {
+     return _ip.compare(0, INPROC_PREFIX.size(), INPROC_PREFIX) == 0;
+   }
+
+   std::string EndPoint::InProcName() const
+   {
+     return IsInProc() ? _ip.substr(INPROC_PREFIX.size()) : std::string();
+   }
+
 
    std::string EndPoint::ToString() const  
    { 
@@ -140,6 +189,17 @@ int main()
     std::cout<<"Test ToString(): "<<ep.ToString()<<std::endl;
     std::cout<<"Test insertion operator: "<<ep<<std::endl;
 
+    CSE384::EndPoint uds("unix:/tmp/mpl.sock");
+    CSE384::EndPoint uds2(uds.ToString());
+    std::cout<<"Unix domain: "<<uds<<" path="<<uds2.UnixPath()
+             <<(uds2.IsUnix() && !ep.IsUnix() ? " (correct)" : " (wrong!!)")<<std::endl;
+    CSE384::EndPoint shm("shm:/tmp/mpl.sock");
+    std::cout<<"Shared memory: "<<shm<<" path="<<shm.UnixPath()
+             <<(shm.IsShm() && shm.IsLocal() && !shm.IsUnix() ? " (correct)" : " (wrong!!)")<<std::endl;
+    CSE384::EndPoint inproc(CSE384::EndPoint("inproc:echo").ToString());
+    std::cout<<"In-process: "<<inproc<<" name="<<inproc.InProcName()
+             <<(inproc.IsInProc() && !inproc.IsLocal() ? " (correct)" : " (wrong!!)")<<std::endl;
+
     try
     {
 
@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////////////
+// FileMessage.cpp - messages whose body moves between a file and a socket //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include "FileMessage.h"
+#include "SenderExceptions.h"
+#include "ReceiverExceptions.h"
+
+namespace CSE384
+{
+    void FileMessage::Send(TCPSocket &sock, int type, int file_fd, long long offset, size_t len)
+    {
+        char hdr[MSGHEADER::MAX_SIZE()];
+        size_t hdr_size = MSGHEADER::SizeFor(len, type);
+        MSGHEADER::Encode(hdr, hdr_size, len, type);
+        ((MSGHEADER *)hdr)->ToNetorkByteOrder();
+
+        // the header goes out with the first file bytes, not in a segment of its own
+        int flags = 0;
+#ifdef MSG_MORE
+        if (len > 0)
+            flags = MSG_MORE;
+#endif
+        if (sock.Send(hdr, hdr_size, flags, 1) == -1)
+            throw SenderTransmitMessageDataException(getlasterror_portable());
+
+        long long sent = sock.SendFile(file_fd, offset, len);
+        if (sent == -1)
+            throw SenderTransmitMessageDataException(getlasterror_portable());
+        // the header promised len bytes: the stream cannot be continued
+        if ((size_t)sent != len)
+            throw SenderTransmitMessageDataException(EIO);
+    }
+
+    MessagePtr FileMessage::Receive(TCPSocket &sock, int file_type, int file_fd, long long offset,
+                                    size_t &written, size_t max_len, size_t max_frame)
+    {
+        written = 0;
+
+        MSGHEADER mhdr;
+        long long recv_bytes = sock.Recv((const char *)&mhdr, sizeof(MSGHEADER), MSG_WAITALL, 1);
+        if (recv_bytes == 0)
+            return Message::CreateMessage(nullptr, 0, DISCONNECT);
+        if (recv_bytes != (long long)sizeof(MSGHEADER))
+            throw ReceiverReceiveMessageHeaderException(getlasterror_portable());
+        mhdr.ToHostByteOrder();
+
+        char ext[MSGHEADER::MAX_EXT_SIZE];
+        size_t length = mhdr.len();
+        int type = mhdr.type();
+        if (mhdr.IsExtended())
+        {
+            if (mhdr.ExtVersion() != MSGHEADER::EXT_VERSION)
+                throw ReceiverReceiveMessageHeaderException(EPROTO);
+            if (sock.Recv(ext, mhdr.ExtSize(), MSG_WAITALL, 1) != (long long)mhdr.ExtSize())
+                throw ReceiverReceiveMessageHeaderException(getlasterror_portable());
+            mhdr.DecodeExt(ext, length, type);
+        }
+
+        if (type != file_type)
+        {
+            // refuse the frame before its body is allocated
+            if (length > max_frame)
+                throw ReceiverReceiveMessageHeaderException(EMSGSIZE);
+            MessagePtr msg = mhdr.IsExtended() ? Message::CreateMessage(mhdr, ext) : Message::CreateMessage(mhdr);
+            if ((recv_bytes = sock.Recv(msg->GetData(), msg->Length(), MSG_WAITALL, 1)) != (long long)msg->Length())
+                throw ReceiverReceiveMessageDataException(recv_bytes == -1 ? getlasterror_portable() : ECONNRESET);
+            return msg;
+        }
+
+        // more than the caller has room for at offset: not a byte is written
+        if (length > max_len)
+            throw ReceiverReceiveMessageDataException(EMSGSIZE);
+
+        long long got = sock.RecvFile(file_fd, offset, length);
+        if (got == -1)
+            throw ReceiverReceiveMessageDataException(getlasterror_portable());
+        // the peer closed in the middle of the body
+        if ((size_t)got != length)
+            throw ReceiverReceiveMessageDataException(ECONNRESET);
+
+        written = length;
+        return Message::CreateMessage(nullptr, 0, type);
+    }
+
+    MessagePtr FileMessage::Load(int type, int file_fd, long long offset, size_t len)
+    {
+        // a (host order) header describing the body, as if just received
+        char hdr[MSGHEADER::MAX_SIZE()];
+        MSGHEADER::Encode(hdr, MSGHEADER::SizeFor(len, type), len, type);
+        const MSGHEADER &mhdr = *(const MSGHEADER *)hdr;
+        MessagePtr msg = mhdr.IsExtended() ? Message::CreateMessage(mhdr, hdr + MSGHEADER::SIZE())
+                                           : Message::CreateMessage(mhdr);
+
+        size_t done = 0;
+        while (done < len)
+        {
+            long long n = pread_portable(file_fd, msg->GetData() + done, len - done, offset + (long long)done);
+            if (n == -1)
+                throw SenderTransmitMessageDataException(getlasterror_portable());
+            if (n == 0)
+                throw SenderTransmitMessageDataException(EIO);
+            done += (size_t)n;
+        }
+        return msg;
+    }
+
+    size_t FileMessage::Store(const MessagePtr &msg, int file_fd, long long offset, size_t max_len)
+    {
+        if (msg->Length() > max_len)
+            throw ReceiverReceiveMessageDataException(EMSGSIZE);
+
+        size_t done = 0;
+        while (done < msg->Length())
+        {
+            long long n = pwrite_portable(file_fd, msg->GetData() + done, msg->Length() - done, offset + (long long)done);
+            if (n <= 0)
+                throw ReceiverReceiveMessageDataException(getlasterror_portable());
+            done += (size_t)n;
+        }
+        return done;
+    }
+}
@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////////
+// InProc.cpp - in-process transport: MessagePtrs handed between threads   //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <map>
+#include <mutex>
+
+#include "InProc.h"
+
+namespace CSE384
+{
+    namespace
+    {
+        // listeners by name (a listener removes itself when closed)
+        struct Registry
+        {
+            std::mutex mtx;
+            std::map<std::string, std::weak_ptr<InProcListener>> listeners;
+        };
+
+        // constructed on first use, never destroyed (listeners may outlive main)
+        Registry &TheRegistry()
+        {
+            static Registry *registry = new Registry();
+            return *registry;
+        }
+    }
+
+    bool InProcPipe::Put(const MessagePtr &msg)
+    {
+        // refused under the queue lock: cannot slip in after CloseRead()'s clear()
+        return q_.try_enQ(msg);
+    }
+
+    bool InProcPipe::Take(MessagePtr &msg)
+    {
+        return !read_closed_.load() && q_.deQ(msg) && !read_closed_.load();
+    }
+
+    void InProcPipe::CloseWrite()
+    {
+        q_.close();
+    }
+
+    void InProcPipe::CloseRead()
+    {
+        read_closed_.store(true);
+        // wakes a waiting Take()
+        q_.close();
+        q_.clear();
+    }
+
+    void InProcConnection::Close()
+    {
+        to_client.CloseWrite();
+        to_server.CloseRead();
+    }
+
+    std::shared_ptr<InProcListener> InProcListener::Listen(const std::string &name)
+    {
+        Registry &r = TheRegistry();
+        std::lock_guard<std::mutex> lock(r.mtx);
+        auto it = r.listeners.find(name);
+        if (it != r.listeners.end() && !it->second.expired())
+            return nullptr;
+
+        std::shared_ptr<InProcListener> listener(new InProcListener(name));
+        r.listeners[name] = listener;
+        return listener;
+    }
+
+    std::shared_ptr<InProcConnection> InProcListener::Connect(const std::string &name)
+    {
+        Registry &r = TheRegistry();
+        std::shared_ptr<InProcListener> listener;
+        std::shared_ptr<InProcConnection> conn;
+        {
+            std::lock_guard<std::mutex> lock(r.mtx);
+            auto it = r.listeners.find(name);
+            if (it != r.listeners.end())
+                listener = it->second.lock();
+
+            // queued under the registry lock: Close() cannot miss it
+            if (listener != nullptr && !listener->closed_.load())
+            {
+                conn = std::make_shared<InProcConnection>();
+                listener->pending_.enQ(conn);
+            }
+        }
+
+        // ours may be the last reference: ~InProcListener (Close) takes the
+        // registry lock, so let it go only once the lock is released
+        listener.reset();
+        return conn;
+    }
+
+    InProcListener::~InProcListener()
+    {
+        Close();
+    }
+
+    std::shared_ptr<InProcConnection> InProcListener::Accept()
+    {
+        std::shared_ptr<InProcConnection> conn;
+        if (closed_.load() || !pending_.deQ(conn))
+            return nullptr;
+        return conn;
+    }
+
+    void InProcListener::Close()
+    {
+        if (closed_.exchange(true))
+            return;
+
+        {
+            Registry &r = TheRegistry();
+            std::lock_guard<std::mutex> lock(r.mtx);
+            auto it = r.listeners.find(name_);
+            if (it != r.listeners.end() && (it->second.expired() || it->second.lock().get() == this))
+                r.listeners.erase(it);
+        }
+
+        pending_.close();
+        std::shared_ptr<InProcConnection> conn;
+        while (pending_.try_deQ(conn))
+            conn->Close();
+    }
+}
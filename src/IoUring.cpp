@@ -0,0 +1,408 @@
+/////////////////////////////////////////////////////////////////////////////
+// IoUring.cpp - minimal io_uring submission/completion ring (Linux)        //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <memory>
+
+#include "IoUring.h"
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+
+namespace CSE384
+{
+    namespace
+    {
+        int io_uring_setup(unsigned entries, struct io_uring_params *p)
+        {
+            return (int)syscall(__NR_io_uring_setup, entries, p);
+        }
+
+        int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+        }
+
+        int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+        {
+            return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+        }
+
+        // the rings are shared with the kernel: head/tail need acquire/release ordering
+        unsigned load_acquire(const unsigned *p)
+        {
+            return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+        }
+
+        void store_release(unsigned *p, unsigned v)
+        {
+            __atomic_store_n(p, v, __ATOMIC_RELEASE);
+        }
+    }
+
+    IoUring::IoUring() : ring_fd_(-1),
+                         sq_head_(nullptr),
+                         sq_tail_(nullptr),
+                         sq_mask_(0),
+                         sq_entries_(0),
+                         sq_array_(nullptr),
+                         sqes_(nullptr),
+                         cq_head_(nullptr),
+                         cq_tail_(nullptr),
+                         cq_mask_(0),
+                         cqes_(nullptr),
+                         sq_ring_(MAP_FAILED),
+                         sq_ring_size_(0),
+                         cq_ring_(MAP_FAILED),
+                         cq_ring_size_(0),
+                         sqes_size_(0),
+                         queued_(0),
+                         enter_calls_(0)
+    {
+    }
+
+    IoUring::~IoUring()
+    {
+        Release();
+    }
+
+    void IoUring::Release()
+    {
+        if (sqes_ != nullptr)
+            munmap(sqes_, sqes_size_);
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+            munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_ != MAP_FAILED)
+            munmap(sq_ring_, sq_ring_size_);
+        if (ring_fd_ != -1)
+            close(ring_fd_);
+
+        ring_fd_ = -1;
+        sqes_ = nullptr;
+        sq_ring_ = cq_ring_ = MAP_FAILED;
+    }
+
+    bool IoUring::Init(unsigned entries)
+    {
+        if (IsReady())
+            return true;
+
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        if ((ring_fd_ = io_uring_setup(entries, &p)) < 0)
+        {
+            ring_fd_ = -1;
+            return false;
+        }
+
+        sq_ring_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+        // newer kernels map both rings with one mmap
+        bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_ring_size_ > sq_ring_size_)
+            sq_ring_size_ = cq_ring_size_;
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED)
+        {
+            Release();
+            return false;
+        }
+
+        cq_ring_ = single_mmap ? sq_ring_ : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                 ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED)
+        {
+            Release();
+            return false;
+        }
+
+        sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            Release();
+            return false;
+        }
+        sqes_ = (struct io_uring_sqe *)sqes;
+
+        char *sq = (char *)sq_ring_;
+        sq_head_ = (unsigned *)(sq + p.sq_off.head);
+        sq_tail_ = (unsigned *)(sq + p.sq_off.tail);
+        sq_mask_ = *(unsigned *)(sq + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        sq_array_ = (unsigned *)(sq + p.sq_off.array);
+
+        char *cq = (char *)cq_ring_;
+        cq_head_ = (unsigned *)(cq + p.cq_off.head);
+        cq_tail_ = (unsigned *)(cq + p.cq_off.tail);
+        cq_mask_ = *(unsigned *)(cq + p.cq_off.ring_mask);
+        cqes_ = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+        return true;
+    }
+
+    bool IoUring::Available()
+    {
+        static const bool available = []() {
+            IoUring probe;
+            return probe.Init(2);
+        }();
+        return available;
+    }
+
+    IoUring *IoUring::ThreadRing()
+    {
+        // created on first use: nullptr on this thread if io_uring is not available
+        thread_local std::unique_ptr<IoUring> ring;
+        thread_local bool failed = false;
+
+        if (!ring && !failed)
+        {
+            ring.reset(new IoUring());
+            if (!Available() || !ring->Init(64))
+            {
+                ring.reset();
+                failed = true;
+            }
+        }
+        return ring.get();
+    }
+
+    int IoUring::RegisterBuffers(const IOVEC *iov, unsigned count)
+    {
+        return io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iov, count);
+    }
+
+    int IoUring::UnregisterBuffers()
+    {
+        return io_uring_register(ring_fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    }
+
+    struct io_uring_sqe *IoUring::NextSqe(int opcode, int fd, uint64_t user_data)
+    {
+        // this thread is the only producer: the tail is ours, the kernel moves the head
+        unsigned tail = *sq_tail_;
+        if (tail - load_acquire(sq_head_) >= sq_entries_)
+            return nullptr;
+
+        unsigned index = tail & sq_mask_;
+        struct io_uring_sqe *sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = (uint8_t)opcode;
+        sqe->fd = fd;
+        sqe->user_data = user_data;
+
+        sq_array_[index] = index;
+        store_release(sq_tail_, tail + 1);
+        ++queued_;
+        return sqe;
+    }
+
+    bool IoUring::PrepSend(int fd, const void *buf, size_t len, int flags, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_SEND, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = (uint32_t)len;
+        sqe->msg_flags = (uint32_t)(flags | MSG_NOSIGNAL);
+        return true;
+    }
+
+    bool IoUring::PrepRecv(int fd, void *buf, size_t len, int flags, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_RECV, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = (uint32_t)len;
+        sqe->msg_flags = (uint32_t)flags;
+        return true;
+    }
+
+    bool IoUring::PrepSendMsg(int fd, const struct msghdr *mh, int flags, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_SENDMSG, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)mh;
+        sqe->len = 1;
+        sqe->msg_flags = (uint32_t)(flags | MSG_NOSIGNAL);
+        return true;
+    }
+
+    bool IoUring::PrepAccept(int fd, uint64_t user_data)
+    {
+        // the peer address is not needed (see TCPSocket::RemoteEP)
+        return NextSqe(IORING_OP_ACCEPT, fd, user_data) != nullptr;
+    }
+
+    bool IoUring::PrepRead(int fd, void *buf, size_t len, uint64_t offset, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_READ, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = (uint32_t)len;
+        sqe->off = offset;
+        return true;
+    }
+
+    bool IoUring::PrepWrite(int fd, const void *buf, size_t len, uint64_t offset, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_WRITE, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = (uint32_t)len;
+        sqe->off = offset;
+        return true;
+    }
+
+    bool IoUring::PrepReadFixed(int fd, void *buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_READ_FIXED, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = (uint32_t)len;
+        sqe->off = offset;
+        sqe->buf_index = (uint16_t)buf_index;
+        return true;
+    }
+
+    bool IoUring::PrepWriteFixed(int fd, const void *buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data)
+    {
+        struct io_uring_sqe *sqe = NextSqe(IORING_OP_WRITE_FIXED, fd, user_data);
+        if (sqe == nullptr)
+            return false;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = (uint32_t)len;
+        sqe->off = offset;
+        sqe->buf_index = (uint16_t)buf_index;
+        return true;
+    }
+
+    int IoUring::Submit(unsigned wait_nr)
+    {
+        int ret;
+        do
+        {
+            ++enter_calls_;
+            ret = io_uring_enter(ring_fd_, queued_, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+        } while (ret == -1 && errno == EINTR);
+
+        if (ret > 0)
+            queued_ -= ((unsigned)ret < queued_) ? (unsigned)ret : queued_;
+        return ret;
+    }
+
+    size_t IoUring::Reap(Completion *out, size_t max)
+    {
+        // this thread is the only consumer: the head is ours, the kernel moves the tail
+        unsigned head = *cq_head_;
+        unsigned tail = load_acquire(cq_tail_);
+        size_t n = 0;
+
+        while (head != tail && n < max)
+        {
+            struct io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+            out[n].user_data = cqe->user_data;
+            out[n].result = cqe->res;
+            ++n;
+            ++head;
+        }
+        store_release(cq_head_, head);
+        return n;
+    }
+
+    long long IoUring::Complete()
+    {
+        Completion c;
+        while (Reap(&c, 1) == 0)
+        {
+            if (Submit(1) == -1)
+                return -1;
+        }
+
+        if (c.result < 0)
+        {
+            errno = -c.result;
+            return -1;
+        }
+        return c.result;
+    }
+
+    long long IoUring::Send(int fd, const void *buf, size_t len, int flags)
+    {
+        if (!PrepSend(fd, buf, len, flags, 0))
+            return -1;
+        return Complete();
+    }
+
+    long long IoUring::Recv(int fd, void *buf, size_t len, int flags)
+    {
+        if (!PrepRecv(fd, buf, len, flags, 0))
+            return -1;
+        return Complete();
+    }
+
+    long long IoUring::SendMsg(int fd, const struct msghdr *mh, int flags)
+    {
+        if (!PrepSendMsg(fd, mh, flags, 0))
+            return -1;
+        return Complete();
+    }
+
+    int IoUring::Accept(int fd)
+    {
+        if (!PrepAccept(fd, 0))
+            return -1;
+        return (int)Complete();
+    }
+}
+
+#else
+
+// no io_uring on this platform: Init() fails and the callers use the plain system calls
+namespace CSE384
+{
+    IoUring::IoUring() : ring_fd_(-1), queued_(0), enter_calls_(0) {}
+    IoUring::~IoUring() {}
+    void IoUring::Release() {}
+    bool IoUring::Init(unsigned entries) { return false; }
+    bool IoUring::Available() { return false; }
+    IoUring *IoUring::ThreadRing() { return nullptr; }
+    int IoUring::RegisterBuffers(const IOVEC *iov, unsigned count) { return -1; }
+    int IoUring::UnregisterBuffers() { return -1; }
+    struct io_uring_sqe *IoUring::NextSqe(int opcode, int fd, uint64_t user_data) { return nullptr; }
+    bool IoUring::PrepSend(int fd, const void *buf, size_t len, int flags, uint64_t user_data) { return false; }
+    bool IoUring::PrepRecv(int fd, void *buf, size_t len, int flags, uint64_t user_data) { return false; }
+    bool IoUring::PrepSendMsg(int fd, const struct msghdr *mh, int flags, uint64_t user_data) { return false; }
+    bool IoUring::PrepAccept(int fd, uint64_t user_data) { return false; }
+    bool IoUring::PrepRead(int fd, void *buf, size_t len, uint64_t offset, uint64_t user_data) { return false; }
+    bool IoUring::PrepWrite(int fd, const void *buf, size_t len, uint64_t offset, uint64_t user_data) { return false; }
+    bool IoUring::PrepReadFixed(int fd, void *buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data) { return false; }
+    bool IoUring::PrepWriteFixed(int fd, const void *buf, size_t len, uint64_t offset, int buf_index, uint64_t user_data) { return false; }
+    int IoUring::Submit(unsigned wait_nr) { return -1; }
+    size_t IoUring::Reap(Completion *out, size_t max) { return 0; }
+    long long IoUring::Complete() { return -1; }
+    long long IoUring::Send(int fd, const void *buf, size_t len, int flags) { return -1; }
+    long long IoUring::Recv(int fd, void *buf, size_t len, int flags) { return -1; }
+    long long IoUring::SendMsg(int fd, const struct msghdr *mh, int flags) { return -1; }
+    int IoUring::Accept(int fd) { return -1; }
+}
+
+#endif
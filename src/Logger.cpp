@@ -40,17 +40,17 @@ void Logger::start()
   if (_ThreadRunning)
     return;
   _ThreadRunning = true;
+  _queue.reopen();
   std::function<void()> tp = [=]() {
-    while (true)
+    // until stop() closes the queue and everything queued is written
+    std::vector<std::string> batch;
+    while (_queue.deQ_bulk(batch, MAX_BATCH) > 0)
     {
-      std::string msg = _queue.deQ();
-      if (msg == "quit")
-      {
-        _ThreadRunning = false;
-        break;
-      }
-      *_pOut << msg;
+      for (auto& msg : batch)
+        *_pOut << msg;
+      batch.clear();
     }
+    _ThreadRunning = false;
   };
   std::thread thr(tp);
   thr.detach();
@@ -63,7 +63,7 @@ void Logger::stop(const std::string& msg)
   {
     if(msg != "")
       write(msg);
-    write("quit");  // request thread to stop
+    _queue.close();  // request thread to stop
     while (_ThreadRunning)
       /* wait for thread to stop*/
       ;
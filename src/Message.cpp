@@ -6,13 +6,26 @@ namespace CSE384
   {
     if (&msg != this)
     {
-      delete[] raw_msg_;
+      Release();
       raw_msg_ = msg.raw_msg_;
       raw_len_ = msg.raw_len_;
+      hdr_size_ = msg.hdr_size_;
+      len_ = msg.len_;
+      type_ = msg.type_;
+      data_ = msg.data_;
+      shared_ = std::move(msg.shared_);
+      if (msg.raw_msg_ == msg.hdr_buf_)
+      {
+        std::memcpy(hdr_buf_, msg.hdr_buf_, hdr_size_);
+        raw_msg_ = hdr_buf_;
+      }
+      std::memcpy(wire_hdr_, msg.wire_hdr_, hdr_size_);
       msg.raw_msg_ = nullptr;
       msg.raw_len_ = 0;
-      shadow_hdr = msg.shadow_hdr;
-      msg.shadow_hdr.data = 0;
+      msg.hdr_size_ = 0;
+      msg.len_ = 0;
+      msg.type_ = DEFAULT;
+      msg.data_ = nullptr;
     }
     return *this;
   }
@@ -21,16 +34,71 @@ namespace CSE384
   {
     if (&msg != this)
     {
-      delete[] raw_msg_;
-      raw_msg_ = new char[msg.RawMsgLength()];
+      char *raw = MessagePool::Allocate(msg.RawMsgLength());
+      std::memcpy(raw, msg.raw_msg_, msg.hdr_size_);
+      std::memcpy(raw + msg.hdr_size_, msg.data_, msg.raw_len_ - msg.hdr_size_);
+
+      Release();
+      raw_msg_ = raw;
       raw_len_ = msg.raw_len_;
-      shadow_hdr = msg.shadow_hdr;
-      std::memcpy(raw_msg_, msg.raw_msg_, msg.RawMsgLength());
+      hdr_size_ = msg.hdr_size_;
+      len_ = msg.len_;
+      type_ = msg.type_;
+      data_ = raw_msg_ + hdr_size_;
+      std::memcpy(wire_hdr_, msg.wire_hdr_, hdr_size_);
     }
 
     return *this;
   }
 
+  void Message::Detach()
+  {
+    char *raw = MessagePool::Allocate(raw_len_);
+    std::memcpy(raw, raw_msg_, hdr_size_);
+    std::memcpy(raw + hdr_size_, data_, raw_len_ - hdr_size_);
+
+    shared_.reset();
+    raw_msg_ = raw;
+    data_ = raw_msg_ + hdr_size_;
+  }
+
+  bool Message::ParseHeader()
+  {
+    if (raw_msg_ == nullptr)
+      return false;
+
+    const MSGHEADER *hdr = (const MSGHEADER *)raw_msg_;
+    size_t length = hdr->len();
+    int type = hdr->type();
+
+    if (hdr->IsExtended())
+    {
+      // the extension must match the header layout this message was built with
+      if (hdr->ExtVersion() != MSGHEADER::EXT_VERSION || sizeof(MSGHEADER) + hdr->ExtSize() != hdr_size_)
+        return false;
+      hdr->DecodeExt(raw_msg_ + sizeof(MSGHEADER), length, type);
+    }
+    else if (hdr_size_ != sizeof(MSGHEADER))
+      return false;
+
+    if (length > raw_len_ - hdr_size_)
+      return false;
+
+    len_ = length;
+    type_ = type;
+    EncodeWireHeader();
+    return true;
+  }
+
+  void Message::GatherFrames(const MessagePtr *msgs, size_t count, bool raw, IOVEC *iov)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      const Message &msg = *msgs[i];
+      set_iovec_portable(iov[2 * i], msg.wire_hdr_, msg.hdr_size_);
+      set_iovec_portable(iov[2 * i + 1], msg.GetData(), raw ? (msg.raw_len_ - msg.hdr_size_) : msg.len_);
+    }
+  }
 
   std::string Message::ToString() const
   {
@@ -39,14 +107,14 @@ namespace CSE384
 
   std::ostream &operator<<(std::ostream &outs, Message &msg)
   {
-    for (int i = 0; i < msg.Length(); ++i)
+    for (size_t i = 0; i < msg.Length(); ++i)
       outs << msg.GetData()[i];
     return outs;
   }
 
   std::ostream &operator<<(std::ostream &outs, const Message &msg)
   {
-    for (int i = 0; i < msg.Length(); ++i)
+    for (size_t i = 0; i < msg.Length(); ++i)
       outs << msg.GetData()[i];
     return outs;
   }
@@ -166,7 +234,22 @@ int main()
   std::cout << "Test ToString() method: " << mptr2->ToString() << std::endl;
   std::cout << "Test non const index operator " << (*mptr2)[0] << std::endl;
   std::cout << "Test GetRawLength() " << mptr2->RawMsgLength() << std::endl;
-  
+
+  std::cout << std::endl << "*** Test extended header messages *** " << std::endl;
+  std::string big(3 * 1024 * 1024, 'x');
+  MessagePtr mptr3 = Message::CreateMessage(big, 0x12345);
+  std::cout << "Test Length() accessor: " << mptr3->Length() << std::endl;
+  std::cout << "Test Message Type accessor:" << mptr3->GetType() << std::endl;
+  std::cout << "Test HeaderSize() " << mptr3->HeaderSize() << std::endl;
+  std::cout << "Test GetRawLength() " << mptr3->RawMsgLength() << std::endl;
+
+  MSGHEADER exthdr = *mptr3->GetHeader();
+  Message m3(exthdr, mptr3->GetRawMsg() + sizeof(MSGHEADER));
+  std::cout << "Test decoded extended header len: " << m3.Length() << " type: " << m3.GetType() << std::endl;
+
+  MessagePtr mptr4 = Message::CreateFixedSizeMessage(128 * 1024, "fixed extended", 14, 0xA);
+  mptr4->ParseHeader();
+  std::cout << "Test fixed extended HeaderSize() " << mptr4->HeaderSize() << " Length(): " << mptr4->Length() << std::endl;
 }
 
 #endif
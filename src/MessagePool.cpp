@@ -0,0 +1,271 @@
+/////////////////////////////////////////////////////////////////////////////
+// MessagePool.cpp - thread caching, size class buffer pool for Messages   //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <new>
+
+#include "MessagePool.h"
+
+namespace CSE384
+{
+    namespace
+    {
+        // per thread cache bound (bytes per size class): beyond this, half the
+        // cached buffers are moved to the depot
+        const size_t THREAD_CACHE_BYTES = 256 * 1024;
+        // depot bound (bytes per size class): beyond this, buffers go back to the heap
+        const size_t DEPOT_BYTES = 8 * 1024 * 1024;
+
+        size_t ThreadCacheLimit(int index)
+        {
+            size_t n = THREAD_CACHE_BYTES / MessagePool::ClassSize(index);
+            return n < 8 ? 8 : n;
+        }
+
+        size_t DepotLimit(int index)
+        {
+            size_t n = DEPOT_BYTES / MessagePool::ClassSize(index);
+            return n < 32 ? 32 : n;
+        }
+
+        struct Counters
+        {
+            std::atomic<uint64_t> hits[MessagePool::NUM_CLASSES];
+            std::atomic<uint64_t> misses[MessagePool::NUM_CLASSES];
+            std::atomic<uint64_t> oversize;
+
+            Counters() : oversize(0)
+            {
+                for (int i = 0; i < MessagePool::NUM_CLASSES; ++i)
+                {
+                    hits[i] = 0;
+                    misses[i] = 0;
+                }
+            }
+        };
+
+        // shared free lists, one lock per size class
+        struct Depot
+        {
+            std::mutex mtx[MessagePool::NUM_CLASSES];
+            std::vector<char *> free[MessagePool::NUM_CLASSES];
+            Counters counters;
+        };
+
+        // never destroyed: messages may be released during static destruction
+        Depot &GetDepot()
+        {
+            static Depot *depot = new Depot();
+            return *depot;
+        }
+
+        struct ThreadCache
+        {
+            std::vector<char *> free[MessagePool::NUM_CLASSES];
+
+            // take up to half the depot limit's worth of buffers in one lock
+            bool Refill(int index)
+            {
+                Depot &depot = GetDepot();
+                std::lock_guard<std::mutex> lock(depot.mtx[index]);
+                std::vector<char *> &shared = depot.free[index];
+                if (shared.empty())
+                    return false;
+
+                size_t n = ThreadCacheLimit(index) / 2;
+                if (n == 0 || n > shared.size())
+                    n = shared.size();
+                free[index].insert(free[index].end(), shared.end() - n, shared.end());
+                shared.resize(shared.size() - n);
+                return true;
+            }
+
+            // move "count" buffers (from the back) to the depot
+            void Flush(int index, size_t count)
+            {
+                std::vector<char *> &local = free[index];
+                Depot &depot = GetDepot();
+                std::lock_guard<std::mutex> lock(depot.mtx[index]);
+                std::vector<char *> &shared = depot.free[index];
+
+                while (count-- > 0 && !local.empty())
+                {
+                    if (shared.size() < DepotLimit(index))
+                        shared.push_back(local.back());
+                    else
+                        ::operator delete(local.back());
+                    local.pop_back();
+                }
+            }
+
+            ~ThreadCache()
+            {
+                for (int i = 0; i < MessagePool::NUM_CLASSES; ++i)
+                    Flush(i, free[i].size());
+            }
+        };
+
+        // trivially destructible: remains valid to test after the holder is destroyed
+        thread_local ThreadCache *t_cache = nullptr;
+        thread_local bool t_cache_gone = false;
+
+        struct ThreadCacheHolder
+        {
+            ThreadCache cache;
+            ThreadCacheHolder() { t_cache = &cache; }
+            ~ThreadCacheHolder()
+            {
+                t_cache = nullptr;
+                t_cache_gone = true;
+            }
+        };
+
+        // nullptr once the thread is exiting (buffers then go straight to the depot)
+        ThreadCache *GetThreadCache()
+        {
+            if (t_cache == nullptr && !t_cache_gone)
+            {
+                thread_local ThreadCacheHolder holder;
+            }
+            return t_cache;
+        }
+    }
+
+    char *MessagePool::Allocate(size_t size)
+    {
+        int index = ClassIndex(size);
+        Depot &depot = GetDepot();
+
+        if (index < 0)
+        {
+            depot.counters.oversize.fetch_add(1, std::memory_order_relaxed);
+            return (char *)::operator new(size);
+        }
+
+        ThreadCache *cache = GetThreadCache();
+        if (cache != nullptr)
+        {
+            std::vector<char *> &local = cache->free[index];
+            if (!local.empty() || cache->Refill(index))
+            {
+                char *buf = local.back();
+                local.pop_back();
+                depot.counters.hits[index].fetch_add(1, std::memory_order_relaxed);
+                return buf;
+            }
+        }
+
+        depot.counters.misses[index].fetch_add(1, std::memory_order_relaxed);
+        return (char *)::operator new(ClassSize(index));
+    }
+
+    void MessagePool::Release(char *buf, size_t size)
+    {
+        if (buf == nullptr)
+            return;
+
+        int index = ClassIndex(size);
+        if (index < 0)
+        {
+            ::operator delete(buf);
+            return;
+        }
+
+        ThreadCache *cache = GetThreadCache();
+        if (cache != nullptr)
+        {
+            cache->free[index].push_back(buf);
+            if (cache->free[index].size() > ThreadCacheLimit(index))
+                cache->Flush(index, cache->free[index].size() / 2);
+            return;
+        }
+
+        Depot &depot = GetDepot();
+        std::lock_guard<std::mutex> lock(depot.mtx[index]);
+        if (depot.free[index].size() < DepotLimit(index))
+            depot.free[index].push_back(buf);
+        else
+            ::operator delete(buf);
+    }
+
+    uint64_t MessagePool::Hits(int index)
+    {
+        Counters &counters = GetDepot().counters;
+        if (index >= 0)
+            return counters.hits[index].load(std::memory_order_relaxed);
+
+        uint64_t total = 0;
+        for (int i = 0; i < NUM_CLASSES; ++i)
+            total += counters.hits[i].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t MessagePool::Misses(int index)
+    {
+        Counters &counters = GetDepot().counters;
+        if (index >= 0)
+            return counters.misses[index].load(std::memory_order_relaxed);
+
+        uint64_t total = 0;
+        for (int i = 0; i < NUM_CLASSES; ++i)
+            total += counters.misses[i].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t MessagePool::Oversize()
+    {
+        return GetDepot().counters.oversize.load(std::memory_order_relaxed);
+    }
+
+    void MessagePool::ResetCounters()
+    {
+        Counters &counters = GetDepot().counters;
+        for (int i = 0; i < NUM_CLASSES; ++i)
+        {
+            counters.hits[i] = 0;
+            counters.misses[i] = 0;
+        }
+        counters.oversize = 0;
+    }
+}
+
+#ifdef TEST_MESSAGE_POOL
+#include <iostream>
+#include <thread>
+using namespace CSE384;
+
+int main()
+{
+    std::cout << "size classes:";
+    for (int i = 0; i < MessagePool::NUM_CLASSES; ++i)
+        std::cout << " " << MessagePool::ClassSize(i);
+    std::cout << std::endl;
+
+    char *a = MessagePool::Allocate(100);
+    MessagePool::Release(a, 100);
+    char *b = MessagePool::Allocate(120);
+    std::cout << "recycled same buffer: " << (a == b) << std::endl;
+    MessagePool::Release(b, 120);
+
+    std::thread t([] {
+        for (int i = 0; i < 10000; ++i)
+            MessagePool::Release(MessagePool::Allocate(1000), 1000);
+    });
+    t.join();
+
+    char *big = MessagePool::Allocate(1024 * 1024);
+    MessagePool::Release(big, 1024 * 1024);
+
+    std::cout << "hits: " << MessagePool::Hits() << " misses: " << MessagePool::Misses()
+              << " oversize: " << MessagePool::Oversize() << std::endl;
+}
+#endif
@@ -0,0 +1,464 @@
+/////////////////////////////////////////////////////////////////////////////
+// Reactor.cpp - epoll I/O thread multiplexing many client connections     //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <iostream>
+
+#include "Reactor.h"
+#include "ReceiverExceptions.h"
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace CSE384
+{
+    Reactor::Reactor() : epoll_fd_(-1),
+                         wake_fd_(-1),
+                         placement_index_(0),
+                         finishing_(false),
+                         num_conns_(0),
+                         woken_(false),
+                         // one shared read buffer per reactor thread
+                         scratch_(ReceiveRingBuffer::DEFAULT_CAPACITY)
+    {
+    }
+
+    Reactor::~Reactor()
+    {
+        Finish();
+
+        // channels still handed over if the thread could not run
+        for (auto &conn : conns_)
+        {
+            conn.first->ChannelClosed();
+            delete conn.second;
+        }
+        for (ReactorChannel *ch : incoming_)
+            ch->ChannelClosed();
+
+        if (wake_fd_ != -1)
+            close(wake_fd_);
+        if (epoll_fd_ != -1)
+            close(epoll_fd_);
+    }
+
+    void Reactor::Start(const ThreadPlacement &placement, size_t index)
+    {
+        placement_ = placement;
+        placement_index_ = index;
+        if ((epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) == -1)
+            throw ReceiverReactorException(getlasterror_portable());
+        if ((wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+            throw ReceiverReactorException(getlasterror_portable());
+
+        // the wakeup descriptor is the only event without a connection
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) == -1)
+            throw ReceiverReactorException(getlasterror_portable());
+
+        thread_ = std::thread(&Reactor::Run, this);
+    }
+
+    void Reactor::Add(ReactorChannel *ch)
+    {
+        ++num_conns_;
+        std::lock_guard<std::mutex> lock(mtx_);
+        incoming_.push_back(ch);
+        Wake();
+    }
+
+    void Reactor::WakeSend(ReactorChannel *ch)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pending_.push_back(ch);
+
+        // from a handler (OnMessage): the reactor flushes before it waits again
+        if (std::this_thread::get_id() != thread_.get_id())
+            Wake();
+    }
+
+    void Reactor::Shutdown(ReactorChannel *ch)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        shutdowns_.push_back(ch);
+        Wake();
+    }
+
+    void Reactor::Finish()
+    {
+        if (thread_.joinable())
+        {
+            finishing_.store(true);
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                Wake();
+            }
+            thread_.join();
+        }
+    }
+
+    // mtx_ held: one eventfd write until the reactor picks up the hand over lists
+    void Reactor::Wake()
+    {
+        if (!woken_)
+        {
+            woken_ = true;
+            uint64_t one = 1;
+            ssize_t ret = write(wake_fd_, &one, sizeof(one));
+            (void)ret;
+        }
+    }
+
+    void Reactor::Run()
+    {
+        struct epoll_event events[MAX_EVENTS];
+        placement_.Apply("reactor" + std::to_string(placement_index_), placement_index_);
+
+        // num_conns_ also counts channels handed over but not yet picked up
+        while (!finishing_.load() || num_conns_.load() > 0)
+        {
+            int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+            if (n == -1 && getlasterror_portable() != EINTR)
+            {
+                std::cerr << ReceiverReactorException(getlasterror_portable()).what() << std::endl;
+                break;
+            }
+
+            for (int i = 0; i < n; ++i)
+            {
+                Connection *c = (Connection *)events[i].data.ptr;
+                if (c == nullptr)
+                {
+                    // reset the wakeup counter: the hand over lists are read below
+                    uint64_t count;
+                    ssize_t ret = read(wake_fd_, &count, sizeof(count));
+                    (void)ret;
+                    continue;
+                }
+
+                // closed by an earlier event of this batch (deleted after the batch)
+                if (c->closed)
+                    continue;
+
+                uint32_t ev = events[i].events;
+                if (c->closing)
+                {
+                    // waiting to flush: a hang up means the rest can't be delivered
+                    if ((ev & (EPOLLERR | EPOLLHUP)) || !Flush(c) || c->iov_first == c->iov.size())
+                        Close(c);
+                    continue;
+                }
+
+                if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                    OnReadable(c);
+
+                if (!c->closed && !c->closing && (ev & EPOLLOUT) && !Flush(c))
+                    Disconnect(c);
+            }
+
+            AcceptIncoming();
+            FlushPending();
+            ShutdownPending();
+
+            for (Connection *c : closed_)
+                delete c;
+            closed_.clear();
+        }
+    }
+
+    void Reactor::AcceptIncoming()
+    {
+        std::vector<ReactorChannel *> incoming;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            incoming.swap(incoming_);
+            woken_ = false;
+        }
+
+        for (ReactorChannel *ch : incoming)
+        {
+            Connection *c = new Connection();
+            c->ch = ch;
+            c->iov_first = 0;
+            c->want_out = false;
+            c->closing = false;
+            c->closed = false;
+            c->shutdown = false;
+            c->write_shut = false;
+            conns_[ch] = c;
+
+            // the reactor thread must never wait in a socket call
+            ch->ChannelSocket().SendTimeout(0);
+            ch->ChannelSocket().RecvTimeout(0);
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = c;
+            if (ch->ChannelSocket().SetNonBlocking(true) == -1 ||
+                epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, (int)ch->ChannelSocket().GetSockFd(), &ev) == -1)
+            {
+                std::cerr << ReceiverReactorException(getlasterror_portable()).what() << std::endl;
+                Disconnect(c);
+                continue;
+            }
+
+            // messages posted (e.g. broadcast) before the hand over
+            if (ch->ChannelSendQueue().size() > 0 && !Flush(c))
+                Disconnect(c);
+        }
+    }
+
+    void Reactor::FlushPending()
+    {
+        std::vector<ReactorChannel *> pending;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending.swap(pending_);
+            woken_ = false;
+        }
+
+        for (ReactorChannel *ch : pending)
+        {
+            auto conn = conns_.find(ch);
+            if (conn == conns_.end())
+                continue;
+
+            // while waiting for EPOLLOUT, the socket buffer is still full
+            Connection *c = conn->second;
+            if (c->want_out)
+                continue;
+
+            if (!Flush(c))
+                Disconnect(c);
+            else if (c->closing && c->iov_first == c->iov.size())
+                Close(c);
+        }
+    }
+
+    void Reactor::ShutdownPending()
+    {
+        std::vector<ReactorChannel *> shutdowns;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            shutdowns.swap(shutdowns_);
+            woken_ = false;
+        }
+
+        for (ReactorChannel *ch : shutdowns)
+        {
+            // already closed (e.g. by the peer)
+            auto conn = conns_.find(ch);
+            if (conn == conns_.end())
+                continue;
+
+            Connection *c = conn->second;
+            c->shutdown = true;
+            if (!Flush(c))
+                Disconnect(c);
+        }
+    }
+
+    void Reactor::OnReadable(Connection *c)
+    {
+        ReactorChannel *ch = c->ch;
+        int n = scratch_.ReadSome(ch->ChannelSocket());
+        if (n == 0 || (n == -1 && !wouldblock_portable(getlasterror_portable())))
+        {
+            // peer shut down (or the socket failed)
+            scratch_.Clear();
+            Disconnect(c);
+            return;
+        }
+        if (n == -1)
+            return;
+
+        // an incomplete frame is pending: it continues with these bytes
+        if (c->partial)
+        {
+            c->partial->Append(scratch_.Peek(), scratch_.Buffered());
+            scratch_.Clear();
+        }
+        ReceiveRingBuffer &rb = c->partial ? *c->partial : scratch_;
+
+        try
+        {
+            MessagePtr msg;
+            while ((msg = ch->DecodeMessage(rb)) != nullptr)
+                ch->OnMessage(msg);
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            scratch_.Clear();
+            Disconnect(c);
+            return;
+        }
+
+        // keep the rest of the frame with the connection (the scratch buffer is shared)
+        if (scratch_.Buffered() > 0)
+        {
+            c->partial.reset(new ReceiveRingBuffer(0));
+            c->partial->Append(scratch_.Peek(), scratch_.Buffered());
+            scratch_.Clear();
+        }
+        else if (c->partial && c->partial->Buffered() == 0)
+            c->partial.reset();
+    }
+
+    bool Reactor::Flush(Connection *c)
+    {
+        ReactorChannel *ch = c->ch;
+        BlockingQueue<MessagePtr> &send_q = ch->ChannelSendQueue();
+
+        // a bounded number of batches per call, so one busy client can't starve the rest
+        for (int batches = 0; batches < MAX_FLUSH_BATCHES; ++batches)
+        {
+            if (c->iov_first == c->iov.size())
+            {
+                // one lock for the whole batch (never waits)
+                c->out.clear();
+                send_q.try_deQ_bulk(c->out, MAX_SEND_BATCH);
+
+                c->iov.resize(c->out.size() * 2);
+                c->iov_first = 0;
+                if (c->out.empty())
+                {
+                    WantOut(c, false);
+
+                    // everything requested before Shutdown() is on the wire
+                    if (c->shutdown && !c->write_shut)
+                    {
+                        c->write_shut = true;
+                        ch->ChannelSocket().ShutdownSend();
+                    }
+                    return true;
+                }
+                ch->GatherMessages(c->out.data(), c->out.size(), c->iov.data());
+            }
+
+            long long n = ch->ChannelSocket().SendSomeV(&c->iov[c->iov_first], (int)(c->iov.size() - c->iov_first), 0);
+            if (n == -1)
+            {
+                if (!wouldblock_portable(getlasterror_portable()))
+                    return false;
+                WantOut(c, true);
+                return true;
+            }
+
+            // skip what was sent (the iovec of a partially sent buffer is advanced)
+            while (c->iov_first < c->iov.size())
+            {
+                size_t len = iovec_len_portable(c->iov[c->iov_first]);
+                if ((size_t)n < len)
+                {
+                    advance_iovec_portable(c->iov[c->iov_first], (size_t)n);
+                    break;
+                }
+                n -= len;
+                ++c->iov_first;
+            }
+        }
+
+        // more to send: continue when the reactor sees EPOLLOUT
+        WantOut(c, true);
+        return true;
+    }
+
+    void Reactor::WantOut(Connection *c, bool want_out)
+    {
+        if (c->want_out == want_out)
+            return;
+
+        c->want_out = want_out;
+        struct epoll_event ev;
+        ev.events = (c->closing ? 0u : (uint32_t)EPOLLIN) | (want_out ? (uint32_t)EPOLLOUT : 0u);
+        ev.data.ptr = c;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, (int)c->ch->ChannelSocket().GetSockFd(), &ev);
+    }
+
+    void Reactor::Disconnect(Connection *c)
+    {
+        if (c->closing || c->closed)
+            return;
+
+        // the channel sees the DISCONNECT last, and may still reply to it
+        c->closing = true;
+        try
+        {
+            c->ch->OnMessage(Message::CreateMessage(nullptr, 0, DISCONNECT));
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+        }
+
+        // stop reading: stay registered only while sends wait for EPOLLOUT
+        bool sent = Flush(c);
+        if (!sent || c->iov_first == c->iov.size())
+        {
+            Close(c);
+            return;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLOUT;
+        ev.data.ptr = c;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, (int)c->ch->ChannelSocket().GetSockFd(), &ev);
+    }
+
+    void Reactor::Close(Connection *c)
+    {
+        if (c->closed)
+            return;
+        c->closed = true;
+
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, (int)c->ch->ChannelSocket().GetSockFd(), nullptr);
+        conns_.erase(c->ch);
+        closed_.push_back(c);
+        --num_conns_;
+
+        // the channel may be gone after this
+        c->ch->ChannelClosed();
+        c->ch = nullptr;
+    }
+}
+
+#else
+
+namespace CSE384
+{
+    Reactor::Reactor() : epoll_fd_(-1),
+                         wake_fd_(-1),
+                         placement_index_(0),
+                         finishing_(false),
+                         num_conns_(0),
+                         woken_(false)
+    {
+    }
+
+    Reactor::~Reactor()
+    {
+    }
+
+    // no epoll: TCPResponder and TCPConnector keep using the thread per connection model
+    void Reactor::Start(const ThreadPlacement &placement, size_t index)
+    {
+        throw ReceiverReactorException(ENOSYS);
+    }
+
+    void Reactor::Add(ReactorChannel *ch) {}
+    void Reactor::WakeSend(ReactorChannel *ch) {}
+    void Reactor::Shutdown(ReactorChannel *ch) {}
+    void Reactor::Finish() {}
+}
+
+#endif
@@ -0,0 +1,237 @@
+/////////////////////////////////////////////////////////////////////////////
+// ReceiveRingBuffer.cpp - per connection buffered receive / frame parser  //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include "ReceiveRingBuffer.h"
+#include "ReceiverExceptions.h"
+
+namespace CSE384
+{
+    ReceiveRingBuffer::ReceiveRingBuffer(size_t capacity) : buf_(capacity),
+                                                            head_(0),
+                                                            tail_(0),
+                                                            recv_calls_(0),
+                                                            decoded_(0),
+                                                            max_frame_(MSGHEADER::DEFAULT_MAX_FRAME)
+    {
+    }
+
+    void ReceiveRingBuffer::Compact()
+    {
+        if (head_ > 0)
+        {
+            std::memmove(&buf_[0], &buf_[head_], Buffered());
+            tail_ -= head_;
+            head_ = 0;
+        }
+    }
+
+    int ReceiveRingBuffer::Fill(TCPSocket &sock)
+    {
+        // wrap around: carry the partial frame over to the front of the buffer
+        if (tail_ == buf_.size())
+            Compact();
+
+        ++recv_calls_;
+        int n = sock.RecvSome(&buf_[tail_], buf_.size() - tail_, 0, 1);
+        if (n > 0)
+            tail_ += n;
+        return n;
+    }
+
+    int ReceiveRingBuffer::ReadSome(TCPSocket &sock)
+    {
+        if (tail_ == buf_.size())
+            Compact();
+        if (tail_ == buf_.size())
+            return -1;
+
+        ++recv_calls_;
+        int n = sock.RecvSome(&buf_[tail_], buf_.size() - tail_, 0, 0);
+        if (n > 0)
+            tail_ += n;
+        return n;
+    }
+
+    void ReceiveRingBuffer::Append(const char *data, size_t len)
+    {
+        if (buf_.size() - tail_ < len)
+        {
+            Compact();
+            if (buf_.size() - tail_ < len)
+                buf_.resize(tail_ + len);
+        }
+        std::memcpy(&buf_[tail_], data, len);
+        tail_ += len;
+    }
+
+    bool ReceiveRingBuffer::PeekHeader(MSGHEADER &mhdr, char *ext, size_t &hdr_size, size_t &length) const
+    {
+        if (Buffered() < sizeof(MSGHEADER))
+            return false;
+
+        // *** MUST convert message header to host byte order (e.g. Intel CPU == little endian)
+        std::memcpy(&mhdr, &buf_[head_], sizeof(MSGHEADER));
+        mhdr.ToHostByteOrder();
+
+        if (!mhdr.IsExtended())
+        {
+            hdr_size = sizeof(MSGHEADER);
+            length = mhdr.len();
+        }
+        else
+        {
+            if (mhdr.ExtVersion() != MSGHEADER::EXT_VERSION)
+                throw ReceiverReceiveMessageHeaderException(EPROTO);
+
+            hdr_size = sizeof(MSGHEADER) + mhdr.ExtSize();
+            if (Buffered() < hdr_size)
+                return false;
+
+            int type;
+            std::memcpy(ext, &buf_[head_ + sizeof(MSGHEADER)], mhdr.ExtSize());
+            mhdr.DecodeExt(ext, length, type);
+        }
+
+        // refuse the frame before its body is allocated
+        if (length > max_frame_)
+            throw ReceiverReceiveMessageHeaderException(EMSGSIZE);
+        return true;
+    }
+
+    MessagePtr ReceiveRingBuffer::Decode()
+    {
+        MSGHEADER mhdr;
+        char ext[MSGHEADER::MAX_EXT_SIZE];
+        size_t hdr_size, length;
+
+        if (!PeekHeader(mhdr, ext, hdr_size, length) || Buffered() < hdr_size + length)
+            return nullptr;
+
+        MessagePtr msg = mhdr.IsExtended() ? Message::CreateMessage(mhdr, ext) : Message::CreateMessage(mhdr);
+        std::memcpy(msg->GetData(), &buf_[head_ + hdr_size], length);
+
+        head_ += hdr_size + length;
+        if (head_ == tail_)
+            head_ = tail_ = 0;
+
+        ++decoded_;
+        return msg;
+    }
+
+    MessagePtr ReceiveRingBuffer::DecodeFixedSize(size_t msg_size)
+    {
+        size_t raw_len = Message::FixedHeaderSize(msg_size) + msg_size;
+        if (Buffered() < raw_len)
+            return nullptr;
+
+        MessagePtr msg = Message::AllocateFixedSizeMessage(msg_size);
+        std::memcpy(msg->GetRawMsg(), &buf_[head_], raw_len);
+
+        head_ += raw_len;
+        if (head_ == tail_)
+            head_ = tail_ = 0;
+
+        // *** MUST convert message header to host byte order (e.g. Intel CPU == little endian)
+        msg->GetHeader()->ToHostByteOrder();
+        if (!msg->ParseHeader())
+            throw ReceiverReceiveMessageHeaderException(EBADMSG);
+
+        ++decoded_;
+        return msg;
+    }
+
+    // frame larger than the buffer: copy the buffered part into dst and
+    // receive the remainder directly (no staging through the buffer); the
+    // frame is complete on return, otherwise throws
+    static void RecvRemainder(TCPSocket &sock, char *dst, size_t copied, size_t total)
+    {
+        if (copied == total)
+            return;
+        long long n = sock.Recv(dst + copied, total - copied, MSG_WAITALL, 1);
+        // the peer closing in the middle of the frame is an error, not a shutdown
+        if (n != (long long)(total - copied))
+            throw ReceiverReceiveMessageDataException(n == -1 ? getlasterror_portable() : ECONNRESET);
+    }
+
+    MessagePtr ReceiveRingBuffer::NextMessage(TCPSocket &sock)
+    {
+        MSGHEADER mhdr;
+        char ext[MSGHEADER::MAX_EXT_SIZE];
+        size_t hdr_size, length;
+        int n;
+
+        while (true)
+        {
+            MessagePtr msg = Decode();
+            if (msg)
+                return msg;
+
+            if (PeekHeader(mhdr, ext, hdr_size, length) && hdr_size + length > Capacity())
+            {
+                msg = mhdr.IsExtended() ? Message::CreateMessage(mhdr, ext) : Message::CreateMessage(mhdr);
+                size_t copied = Buffered() - hdr_size;
+                std::memcpy(msg->GetData(), &buf_[head_ + hdr_size], copied);
+                Clear();
+
+                ++recv_calls_;
+                RecvRemainder(sock, msg->GetData(), copied, length);
+                ++decoded_;
+                return msg;
+            }
+
+            n = Fill(sock);
+
+            // if read zero bytes, then this is the zero length message signaling client shutdown
+            if (n == 0)
+                return Message::CreateMessage(nullptr, 0, DISCONNECT);
+            if (n == -1)
+                throw ReceiverReceiveMessageDataException(getlasterror_portable());
+        }
+    }
+
+    MessagePtr ReceiveRingBuffer::NextFixedSizeMessage(TCPSocket &sock, size_t msg_size)
+    {
+        size_t raw_len = Message::FixedHeaderSize(msg_size) + msg_size;
+        int n;
+
+        while (true)
+        {
+            MessagePtr msg = DecodeFixedSize(msg_size);
+            if (msg)
+                return msg;
+
+            // only once the frame has begun: on an empty buffer Fill() tells a
+            // shutdown (0) from the start of the next frame
+            if (raw_len > Capacity() && Buffered() > 0)
+            {
+                msg = Message::AllocateFixedSizeMessage(msg_size);
+                size_t copied = Buffered();
+                std::memcpy(msg->GetRawMsg(), &buf_[head_], copied);
+                Clear();
+
+                ++recv_calls_;
+                RecvRemainder(sock, msg->GetRawMsg(), copied, raw_len);
+                msg->GetHeader()->ToHostByteOrder();
+                if (!msg->ParseHeader())
+                    throw ReceiverReceiveMessageHeaderException(EBADMSG);
+                ++decoded_;
+                return msg;
+            }
+
+            n = Fill(sock);
+
+            // if read zero bytes, then this is the zero length message signaling client shutdown
+            if (n == 0)
+                return Message::CreateMessage(nullptr, 0, DISCONNECT);
+            if (n == -1)
+                throw ReceiverReceiveMessageDataException(getlasterror_portable());
+        }
+    }
+}
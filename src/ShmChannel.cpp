@@ -0,0 +1,434 @@
+/////////////////////////////////////////////////////////////////////////////
+// ShmChannel.cpp - shared memory byte stream between two local processes  //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <new>
+#include <thread>
+
+#include "ShmChannel.h"
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+namespace CSE384
+{
+    // one direction, in the shared segment: the writer owns head, the reader tail
+    struct ShmChannel::Ring
+    {
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) std::atomic<uint32_t> reader_waiting;
+        std::atomic<uint32_t> writer_waiting;
+        std::atomic<uint32_t> writer_closed;
+        std::atomic<uint32_t> reader_closed;
+        alignas(64) char data[RING_BYTES];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ShmChannel: 64 bit atomics must be lock-free to be shared between processes");
+    static_assert((ShmChannel::RING_BYTES & (ShmChannel::RING_BYTES - 1)) == 0, "ShmChannel: RING_BYTES must be a power of two");
+
+    namespace
+    {
+        // the peer must answer the handshake within this time
+        const int HANDSHAKE_MS = 2000;
+        const char HELLO = 'M';
+        const char ACK = 'A';
+        // segment, then the eventfds: ring 0 data/space, ring 1 data/space
+        const int NUM_FDS = 5;
+
+        const int SPIN_LIMIT = 128;
+        const int YIELD_LIMIT = 8;
+
+        inline void CpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#endif
+        }
+
+        // false (errno ETIMEDOUT) when sock has nothing to read within HANDSHAKE_MS
+        bool WaitReadable(SOCKET sock)
+        {
+            int ready;
+            while ((ready = poll_portable(sock, false, HANDSHAKE_MS)) == -1 && errno == EINTR)
+                ;
+            if (ready == 0)
+                errno = ETIMEDOUT;
+            return ready > 0;
+        }
+
+        void CloseFds(int *fds, int n)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                if (fds[i] != -1)
+                    close(fds[i]);
+            }
+        }
+    }
+
+    ShmChannel::ShmChannel() : map_(MAP_FAILED),
+                               map_len_(2 * sizeof(Ring)),
+                               out_(nullptr),
+                               in_(nullptr),
+                               out_data_fd_(-1),
+                               out_space_fd_(-1),
+                               in_data_fd_(-1),
+                               in_space_fd_(-1),
+                               sock_(INVALID_SOCKET),
+                               peer_gone_(false)
+    {
+    }
+
+    ShmChannel::~ShmChannel()
+    {
+        if (map_ != MAP_FAILED)
+            munmap(map_, map_len_);
+        int fds[] = {out_data_fd_, out_space_fd_, in_data_fd_, in_space_fd_};
+        CloseFds(fds, 4);
+    }
+
+    bool ShmChannel::Map(int memfd, int out_index)
+    {
+        map_ = mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if (map_ == MAP_FAILED)
+            return false;
+        Ring *rings = (Ring *)map_;
+        out_ = &rings[out_index];
+        in_ = &rings[1 - out_index];
+        return true;
+    }
+
+    std::shared_ptr<ShmChannel> ShmChannel::Connect(SOCKET sock, int &error)
+    {
+        std::shared_ptr<ShmChannel> ch(new ShmChannel());
+        ch->sock_ = sock;
+
+        int fds[NUM_FDS] = {-1, -1, -1, -1, -1};
+        bool ok = (fds[0] = memfd_create("mpl-shm", MFD_CLOEXEC)) != -1 &&
+                  ftruncate(fds[0], (off_t)ch->map_len_) == 0;
+        for (int i = 1; ok && i < NUM_FDS; ++i)
+            ok = (fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) != -1;
+        ok = ok && ch->Map(fds[0], 0);
+
+        if (ok)
+        {
+            // the segment is zero filled (data need not be cleared)
+            Ring *rings = (Ring *)ch->map_;
+            for (int i = 0; i < 2; ++i)
+            {
+                new (&rings[i]) Ring;
+                rings[i].head.store(0);
+                rings[i].tail.store(0);
+                rings[i].reader_waiting.store(0);
+                rings[i].writer_waiting.store(0);
+                rings[i].writer_closed.store(0);
+                rings[i].reader_closed.store(0);
+            }
+            ch->out_data_fd_ = fds[1];
+            ch->out_space_fd_ = fds[2];
+            ch->in_data_fd_ = fds[3];
+            ch->in_space_fd_ = fds[4];
+
+            char buf[CMSG_SPACE(sizeof(fds))];
+            memset(buf, 0, sizeof(buf));
+            char hello = HELLO;
+            struct iovec iov = {&hello, 1};
+            struct msghdr mh;
+            memset(&mh, 0, sizeof(mh));
+            mh.msg_iov = &iov;
+            mh.msg_iovlen = 1;
+            mh.msg_control = buf;
+            mh.msg_controllen = sizeof(buf);
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(sizeof(fds));
+            memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+            ok = sendmsg(sock, &mh, MSG_NOSIGNAL) == 1 && WaitReadable(sock);
+            if (ok)
+            {
+                char ack = 0;
+                ssize_t n = recv(sock, &ack, 1, 0);
+                if (n != 1 || ack != ACK)
+                {
+                    // closed by the peer (0), or not an MPL shm listener
+                    if (n >= 0)
+                        errno = (n == 0) ? ECONNRESET : EPROTO;
+                    ok = false;
+                }
+            }
+        }
+
+        error = ok ? 0 : errno;
+        // the mapping (and the peer's copies) keep the segment
+        if (fds[0] != -1)
+            close(fds[0]);
+        if (!ok && ch->out_data_fd_ == -1)
+            CloseFds(&fds[1], NUM_FDS - 1);
+        return ok ? ch : nullptr;
+    }
+
+    std::shared_ptr<ShmChannel> ShmChannel::Accept(SOCKET sock, int &error)
+    {
+        std::shared_ptr<ShmChannel> ch(new ShmChannel());
+        ch->sock_ = sock;
+
+        if (!WaitReadable(sock))
+        {
+            error = errno;
+            return nullptr;
+        }
+
+        int fds[NUM_FDS] = {-1, -1, -1, -1, -1};
+        char buf[CMSG_SPACE(sizeof(fds))];
+        char hello = 0;
+        struct iovec iov = {&hello, 1};
+        struct msghdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = buf;
+        mh.msg_controllen = sizeof(buf);
+
+        bool ok = false;
+        errno = EPROTO;
+        if (recvmsg(sock, &mh, MSG_CMSG_CLOEXEC) == 1 && hello == HELLO)
+        {
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+            bool rights = cm != nullptr && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS;
+            if (rights && cm->cmsg_len != CMSG_LEN(sizeof(fds)))
+            {
+                // not what a ShmChannel sends: do not leak what came along
+                int n = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+                int received[NUM_FDS];
+                n = (n < NUM_FDS) ? n : NUM_FDS;
+                memcpy(received, CMSG_DATA(cm), n * sizeof(int));
+                CloseFds(received, n);
+            }
+            else if (rights)
+            {
+                memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+                // the rings are mirrored: the peer's out ring is our in ring
+                ch->in_data_fd_ = fds[1];
+                ch->in_space_fd_ = fds[2];
+                ch->out_data_fd_ = fds[3];
+                ch->out_space_fd_ = fds[4];
+
+                struct stat st;
+                ok = fstat(fds[0], &st) == 0 && (size_t)st.st_size == ch->map_len_ && ch->Map(fds[0], 1);
+                char ack = ACK;
+                ok = ok && send(sock, &ack, 1, MSG_NOSIGNAL) == 1;
+            }
+        }
+
+        error = ok ? 0 : errno;
+        if (fds[0] != -1)
+            close(fds[0]);
+        return ok ? ch : nullptr;
+    }
+
+    bool ShmChannel::Readable()
+    {
+        return in_->head.load(std::memory_order_acquire) != in_->tail.load(std::memory_order_relaxed) ||
+               in_->writer_closed.load() || in_->reader_closed.load() || peer_gone_.load();
+    }
+
+    bool ShmChannel::Writable()
+    {
+        return out_->head.load(std::memory_order_relaxed) - out_->tail.load(std::memory_order_acquire) < RING_BYTES ||
+               out_->reader_closed.load() || out_->writer_closed.load() || peer_gone_.load();
+    }
+
+    void ShmChannel::Signal(Ring *r, bool data)
+    {
+        // pairs with the fence in Poll: either the waiter sees the new position
+        // or this sees the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::atomic<uint32_t> &waiting = data ? r->reader_waiting : r->writer_waiting;
+        if (waiting.load(std::memory_order_relaxed) != 0)
+        {
+            int fd = (r == out_) ? (data ? out_data_fd_ : out_space_fd_)
+                                 : (data ? in_data_fd_ : in_space_fd_);
+            eventfd_write(fd, 1);
+        }
+    }
+
+    long long ShmChannel::Send(const IOVEC *iov, int iovcnt)
+    {
+        if (out_->writer_closed.load() || out_->reader_closed.load() || peer_gone_.load())
+        {
+            errno = EPIPE;
+            return -1;
+        }
+
+        uint64_t head = out_->head.load(std::memory_order_relaxed);
+        size_t space = RING_BYTES - (size_t)(head - out_->tail.load(std::memory_order_acquire));
+        size_t written = 0;
+        for (int i = 0; i < iovcnt && written < space; ++i)
+        {
+            const char *src = (const char *)iov[i].iov_base;
+            size_t len = (iov[i].iov_len < space - written) ? iov[i].iov_len : space - written;
+            while (len > 0)
+            {
+                size_t pos = (size_t)(head + written) & (RING_BYTES - 1);
+                size_t n = (len < RING_BYTES - pos) ? len : RING_BYTES - pos;
+                memcpy(&out_->data[pos], src, n);
+                src += n;
+                len -= n;
+                written += n;
+            }
+        }
+
+        if (written == 0)
+        {
+            if (space > 0)
+                return 0;
+            errno = EWOULDBLOCK;
+            return -1;
+        }
+        out_->head.store(head + written, std::memory_order_release);
+        Signal(out_, true);
+        return (long long)written;
+    }
+
+    long long ShmChannel::Recv(char *buf, size_t len)
+    {
+        if (in_->reader_closed.load())
+            return 0;
+
+        // closed before the position is read: bytes written before the close are seen
+        bool closed = in_->writer_closed.load() || peer_gone_.load();
+        uint64_t tail = in_->tail.load(std::memory_order_relaxed);
+        size_t avail = (size_t)(in_->head.load(std::memory_order_acquire) - tail);
+        if (avail == 0)
+        {
+            if (closed)
+                return 0;
+            errno = EWOULDBLOCK;
+            return -1;
+        }
+
+        size_t total = (avail < len) ? avail : len;
+        size_t copied = 0;
+        while (copied < total)
+        {
+            size_t pos = (size_t)(tail + copied) & (RING_BYTES - 1);
+            size_t n = (total - copied < RING_BYTES - pos) ? total - copied : RING_BYTES - pos;
+            memcpy(buf + copied, &in_->data[pos], n);
+            copied += n;
+        }
+        in_->tail.store(tail + total, std::memory_order_release);
+        Signal(in_, false);
+        return (long long)total;
+    }
+
+    int ShmChannel::Poll(bool write, int wait_ms)
+    {
+        // spinning only helps when the peer runs on another cpu meanwhile
+        static const int spin_limit = (std::thread::hardware_concurrency() > 1) ? SPIN_LIMIT : 0;
+        for (int i = 0; i < spin_limit + YIELD_LIMIT; ++i)
+        {
+            if (write ? Writable() : Readable())
+                return 1;
+            if (i < spin_limit)
+                CpuRelax();
+            else
+                std::this_thread::yield();
+        }
+
+        std::atomic<uint32_t> &waiting = write ? out_->writer_waiting : in_->reader_waiting;
+        int fd = write ? out_space_fd_ : in_data_fd_;
+        waiting.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int ready = 1;
+        if (!(write ? Writable() : Readable()))
+        {
+            // the socket only becomes readable when the peer closes it
+            struct pollfd p[2];
+            p[0].fd = fd;
+            p[0].events = POLLIN;
+            p[0].revents = 0;
+            p[1].fd = sock_;
+            p[1].events = POLLIN;
+            p[1].revents = 0;
+            ready = poll(p, 2, wait_ms);
+            if (ready > 0)
+            {
+                if (p[1].revents != 0)
+                    peer_gone_.store(true);
+                eventfd_t count;
+                eventfd_read(fd, &count);
+                ready = 1;
+            }
+        }
+        waiting.store(0);
+        return ready;
+    }
+
+    void ShmChannel::ShutdownSend()
+    {
+        // the peer's reader sees the end of the stream, a local writer EPIPE
+        out_->writer_closed.store(1);
+        eventfd_write(out_data_fd_, 1);
+        eventfd_write(out_space_fd_, 1);
+    }
+
+    void ShmChannel::ShutdownRecv()
+    {
+        // a local reader sees the end of the stream, the peer's writer EPIPE
+        in_->reader_closed.store(1);
+        eventfd_write(in_data_fd_, 1);
+        eventfd_write(in_space_fd_, 1);
+    }
+}
+
+#else
+
+namespace CSE384
+{
+    struct ShmChannel::Ring
+    {
+    };
+
+    ShmChannel::ShmChannel() : map_(nullptr), map_len_(0), out_(nullptr), in_(nullptr),
+                               out_data_fd_(-1), out_space_fd_(-1), in_data_fd_(-1), in_space_fd_(-1),
+                               sock_(INVALID_SOCKET), peer_gone_(false)
+    {
+    }
+
+    ShmChannel::~ShmChannel()
+    {
+    }
+
+    std::shared_ptr<ShmChannel> ShmChannel::Connect(SOCKET sock, int &error)
+    {
+        error = WSAEAFNOSUPPORT;
+        return nullptr;
+    }
+
+    std::shared_ptr<ShmChannel> ShmChannel::Accept(SOCKET sock, int &error)
+    {
+        error = WSAEAFNOSUPPORT;
+        return nullptr;
+    }
+
+    long long ShmChannel::Send(const IOVEC *iov, int iovcnt) { return -1; }
+    long long ShmChannel::Recv(char *buf, size_t len) { return -1; }
+    int ShmChannel::Poll(bool write, int wait_ms) { return -1; }
+    void ShmChannel::ShutdownSend() {}
+    void ShmChannel::ShutdownRecv() {}
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "TCPConnector.h"
+#include "ConnectorGroup.h"
 #include "SenderExceptions.h"
 #include "ReceiverExceptions.h"
 #include "Platform.h"
@@ -9,7 +10,14 @@ namespace CSE384
         isSending_(false),
         isReceiving_(false),
         useSendQueue_(true),
-        useRecvQueue_(true)
+        useRecvQueue_(true),
+        useSendDrain_(false),
+        useRecvBuffer_(false),
+        useLockFree_(false),
+        group_(nullptr),
+        reactor_(nullptr),
+        sendTimeout_(-1),
+        maxFrameSize_(MSGHEADER::DEFAULT_MAX_FRAME)
     {
     }
 
@@ -27,6 +35,34 @@ namespace CSE384
     {
         if (IsConnected())
         {
+            recv_lfq_.reset();
+            send_lfq_.reset();
+            // closed by the previous connection's Close()
+            recv_queue_.reopen();
+            send_bq_.reopen();
+
+            // group mode: the group's reactor threads service the socket (a
+            // shared memory channel cannot be watched by epoll: thread mode)
+            reactor_ = (group_ != nullptr && !socket.IsShm()) ? group_->NextReactor() : nullptr;
+            if (reactor_ != nullptr)
+            {
+                channel_closed_ = std::promise<void>();
+                channel_closed_f_ = channel_closed_.get_future();
+                reactor_->Add(this);
+                return true;
+            }
+
+            // wait for readiness (poll) rather than sleep and retry
+            socket.SetNonBlocking(true);
+            socket.SendTimeout(SendTimeout());
+            socket.RecvTimeout(-1);
+
+            if (UseLockFreeQueues())
+            {
+                recv_lfq_.reset(new SPSCQueue<MessagePtr>(LOCKFREE_QUEUE_CAPACITY));
+                send_lfq_.reset(new MPSCQueue<MessagePtr>(LOCKFREE_QUEUE_CAPACITY));
+            }
+
             if (UseSendQueue())
                 StartSending();
 
@@ -43,58 +79,135 @@ namespace CSE384
     // from the blocking queue and writes them into the socket
     void TCPConnector::sendProc()
     {
+        placement_.Apply("send", 0);
         try
         {
             IsSending(true);
 
-            MessagePtr msgPtr = send_bq_.deQ();
-            // if this is the stop sending message, signal
-            // the send thread to shutdown
-            while (msgPtr->GetType() != STOP_SENDING)
+            // until StopSending() closes the send queue (and it is drained)
+            if (UseSendDrain())
+            {
+                // drain mode: every message queued by one wakeup goes out with one gather send
+                std::vector<MessagePtr> batch;
+                while (NextSendBatch(batch))
+                    SendSocketMessages(batch);
+            }
+            else
             {
-                // serialize the message into the socket
-                SendSocketMessage(msgPtr);
-                // deque the next message
-                msgPtr = send_bq_.deQ();            
+                MessagePtr msgPtr;
+                while (NextSend(msgPtr))
+                    SendSocketMessage(msgPtr);
             }
         }
         catch (...)
         {
-            // IsSending(false);
+            // nobody drains the ring any more: don't let posting threads wait for room
+            if (send_lfq_)
+                send_lfq_->close();
         }
     }
 
+    bool TCPConnector::NextSend(MessagePtr &msgPtr)
+    {
+        if (send_lfq_)
+            return send_lfq_->deQ(msgPtr);
+        return send_bq_.deQ(msgPtr);
+    }
+
+    bool TCPConnector::NextSendBatch(std::vector<MessagePtr> &batch)
+    {
+        batch.clear();
+        if (!send_lfq_)
+            return send_bq_.deQ_bulk(batch, MAX_SEND_BATCH) > 0;
+
+        MessagePtr msgPtr;
+        if (!send_lfq_->deQ(msgPtr))
+            return false;
+        batch.push_back(std::move(msgPtr));
+        while (batch.size() < MAX_SEND_BATCH && send_lfq_->try_deQ(msgPtr))
+            batch.push_back(std::move(msgPtr));
+        return true;
+    }
+
     // serialize the message header and message and write them into the socket
     void TCPConnector::SendSocketMessage(const MessagePtr &msgPtr)
     {
-        // Note: could do the send in one call (same as for the Fixed message), but choosing 
-        // not to here. instead send the fixed size header, followed by the variable length data
-        /* 
-        msgPtr->GetHeader()->ToNetorkByteOrder();
-        if (socket.Send(msgPtr->GetRawMsg(), msgPtr->RawMsgLength(),0,1) == -1)
-        {
-            msgPtr->GetHeader()->ToHostByteOrder();
-            throw SenderTransmitMessageDataException(getlasterror_portable());
-        }
-        msgPtr->GetHeader()->ToHostByteOrder();
-        */
+        // send the header and the variable length data with one (gather) system call;
+        // the header is sent from the message's pre-encoded wire header (see Message::GatherFrames)
+        IOVEC iov[2];
+        Message::GatherFrames(&msgPtr, 1, false, iov);
 
-        // convert the wire protocol (message header) to big endian (network byte order)
-        msgPtr->GetHeader()->ToNetorkByteOrder();  
+        if (socket.SendV(iov, 2, 0, 1) == -1)
+           throw SenderTransmitMessageDataException(getlasterror_portable());
+    }
 
-        // send message header
-        if(socket.Send( (const char*) msgPtr->GetHeader(), sizeof(struct MSGHEADER), 0,1) == -1)
-        {
-           msgPtr->GetHeader()->ToHostByteOrder();
-           throw SenderTransmitMessageHeaderException(getlasterror_portable());
-        }
-        msgPtr->GetHeader()->ToHostByteOrder();
+    // serialize a batch of messages (headers and data) into the socket with one gather send
+    void TCPConnector::SendSocketMessages(const std::vector<MessagePtr> &batch)
+    {
+        std::vector<IOVEC> iov(batch.size() * 2);
+        GatherMessages(batch.data(), batch.size(), iov.data());
 
-        // send message data
-        if(socket.Send(msgPtr->GetData(), msgPtr->Length(),0,1) == -1)
+        if (socket.SendV(iov.data(), (int) iov.size(), 0, 1) == -1)
            throw SenderTransmitMessageDataException(getlasterror_portable());
     }
 
+    void TCPConnector::SendFileMessage(int type, int file_fd, long long offset, size_t len)
+    {
+        // no socket of our own to write to (in-process, group mode): an ordinary message
+        if (inproc_ || reactor_ != nullptr)
+            SendMessage(FileMessage::Load(type, file_fd, offset, len));
+        else
+            FileMessage::Send(socket, type, file_fd, offset, len);
+    }
+
+    MessagePtr TCPConnector::ReceiveFileMessage(int file_type, int file_fd, long long offset, size_t &written,
+                                                size_t max_len)
+    {
+        written = 0;
+        if (!inproc_ && !recv_ring_ && reactor_ == nullptr)
+            return FileMessage::Receive(socket, file_type, file_fd, offset, written, max_len, MaxFrameSize());
+
+        // in-process, group mode, or the bytes may already be in the receive buffer
+        MessagePtr msg = ReceiveMessage();
+        if (msg->GetType() != file_type)
+            return msg;
+        written = FileMessage::Store(msg, file_fd, offset, max_len);
+        return Message::CreateMessage(nullptr, 0, file_type);
+    }
+
+    void TCPConnector::GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov)
+    {
+        Message::GatherFrames(msgs, count, false, iov);
+    }
+
+    MessagePtr TCPConnector::DecodeMessage(ReceiveRingBuffer &rb)
+    {
+        // the group's buffers are shared by its connections
+        rb.MaxFrameSize(MaxFrameSize());
+        return rb.Decode();
+    }
+
+    TCPSocket &TCPConnector::ChannelSocket()
+    {
+        return socket;
+    }
+
+    BlockingQueue<MessagePtr> &TCPConnector::ChannelSendQueue()
+    {
+        return send_bq_;
+    }
+
+    // group mode: received messages go to the receive queue (GetMessage)
+    void TCPConnector::OnMessage(const MessagePtr &msg)
+    {
+        recv_queue_.enQ(msg);
+    }
+
+    void TCPConnector::ChannelClosed()
+    {
+        channel_closed_.set_value();
+    }
+
 
     void TCPConnector::StartReceiving()
     {
@@ -110,6 +223,7 @@ namespace CSE384
     // by pulling out messasges and enQing in the recv blocking queue
     void TCPConnector::RecvProc()
     {
+        placement_.Apply("recv", 1);
         try
         {
             IsReceiving(true);
@@ -117,7 +231,10 @@ namespace CSE384
             do
             {
                 msg = RecvSocketMessage();
-                recv_queue_.enQ(msg);
+                if (recv_lfq_)
+                    recv_lfq_->enQ(msg);
+                else
+                    recv_queue_.enQ(msg);
             } 
             while (msg->GetType() != MessageType::DISCONNECT);
         }
@@ -127,26 +244,55 @@ namespace CSE384
             // IsReceiving(false);
         }
 
+        // nothing more will arrive: GetMessage() must not wait forever
+        if (recv_lfq_)
+            recv_lfq_->close();
+        else
+            recv_queue_.close();
+
     }
 
     // serialize the message header and message and write them into the socket
     MessagePtr TCPConnector::RecvSocketMessage()
     {
+        // buffered strategy: decode many frames per recv() call
+        if (recv_ring_)
+            return recv_ring_->NextMessage(socket);
+
         struct MSGHEADER mhdr;
-        int recv_bytes;
+        long long recv_bytes;
         // receive fixed size message header (see wire protocol in Message.h)
-        if ((recv_bytes = socket.Recv((const char *)&mhdr, sizeof(MSGHEADER), MSG_WAITALL, 1)) == sizeof(MSGHEADER))
+        if ((recv_bytes = socket.Recv((const char *)&mhdr, sizeof(MSGHEADER), MSG_WAITALL, 1)) == (long long) sizeof(MSGHEADER))
         {
             // *** MUST convert message header to host byte order (e.g. Intel CPU == little endian)
             mhdr.ToHostByteOrder();
 
             // construct a Message using the Message header read from the socket channel
             // *** critical that mhdr is host byte order ****
-            MessagePtr msgPtr(new Message(mhdr));
+            char ext[MSGHEADER::MAX_EXT_SIZE];
+            size_t length = mhdr.len();
+            int type = mhdr.type();
+            if (mhdr.IsExtended())
+            {
+                // extended header: receive the type/length extension following the legacy word
+                if (mhdr.ExtVersion() != MSGHEADER::EXT_VERSION)
+                    throw ReceiverReceiveMessageHeaderException(EPROTO);
+
+                if (socket.Recv(ext, mhdr.ExtSize(), MSG_WAITALL, 1) != (long long) mhdr.ExtSize())
+                    throw ReceiverReceiveMessageHeaderException(getlasterror_portable());
+
+                mhdr.DecodeExt(ext, length, type);
+            }
+
+            // refuse the frame before its body is allocated
+            if (length > MaxFrameSize())
+                throw ReceiverReceiveMessageHeaderException(EMSGSIZE);
 
-            // send message data
-            if (socket.Recv(msgPtr->GetData(), msgPtr->Length(), MSG_WAITALL, 1) == -1)
-                throw ReceiverReceiveMessageDataException(getlasterror_portable());
+            MessagePtr msgPtr = mhdr.IsExtended() ? Message::CreateMessage(mhdr, ext) : Message::CreateMessage(mhdr);
+
+            // receive message data: the peer closing in the middle of the body is an error
+            if ((recv_bytes = socket.Recv(msgPtr->GetData(), msgPtr->Length(), MSG_WAITALL, 1)) != (long long) msgPtr->Length())
+                throw ReceiverReceiveMessageDataException(recv_bytes == -1 ? getlasterror_portable() : ECONNRESET);
 
             return msgPtr;
         }
@@ -154,7 +300,7 @@ namespace CSE384
         // if read zero bytes, then this is the zero length message signaling client shutdown
         if (recv_bytes == 0)
         {
-            return MessagePtr(new Message(nullptr, 0, DISCONNECT));
+            return Message::CreateMessage(nullptr, 0, DISCONNECT);
         }
         else
         {
@@ -168,9 +314,11 @@ namespace CSE384
         {
             if (IsSending())
             {
-                //note: only gets deposited into queue if IsSending is true
-                MessagePtr StopMsgPtr(new Message(nullptr, 0, STOP_SENDING));
-                this->PostMessage(StopMsgPtr);
+                // the send thread drains the queue, then sees it closed
+                if (send_lfq_)
+                    send_lfq_->close();
+                else
+                    send_bq_.close();
 
                 if (send_thread_.joinable())
                     send_thread_.join();
@@ -191,6 +339,10 @@ namespace CSE384
         {
             if (IsReceiving())
             {
+                // a full receive ring nobody reads must not keep the receive thread waiting
+                if (recv_lfq_)
+                    recv_lfq_->close();
+
                 if (recvThread.joinable())
                     recvThread.join();
 
@@ -207,7 +359,33 @@ namespace CSE384
     bool TCPConnector::Close(std::thread* listener)
     {
         bool ret = false;
-        if (IsConnected())
+        if (IsConnected() && inproc_)
+        {
+            // like ShutdownSend: the handler takes what is queued, then DISCONNECT.
+            // Its replies stay readable (GetMessage) until it closes too
+            inproc_->to_server.CloseWrite();
+
+            if (listener)
+                if (listener->joinable())
+                    listener->join();
+
+            ret = true;
+        }
+        else if (IsConnected() && reactor_ != nullptr)
+        {
+            // group mode: the reactor flushes the queued sends and shuts down the
+            // write side, then waits for the peer to close (DISCONNECT)
+            reactor_->Shutdown(this);
+
+            if (listener)
+                if (listener->joinable())
+                    listener->join();
+
+            channel_closed_f_.wait();
+            reactor_ = nullptr;
+            ret = (socket.Close() == 0);
+        }
+        else if (IsConnected())
         {
             if (UseSendQueue())
                 StopSending();
@@ -235,8 +413,24 @@ namespace CSE384
 
     void TCPConnector::Connect(const EndPoint &ep)
     {
+        // the previous in-process connection (if any) is done with
+        inproc_.reset();
+        if (ep.IsInProc())
+        {
+            // no socket and no send/receive threads: the messages go through the pipes
+            inproc_ = InProcListener::Connect(ep.InProcName());
+            if (!inproc_)
+                throw SenderConnectException(ECONNREFUSED);
+            return;
+        }
+
         socket.Connect(ep, sc_);
 
+        // fresh receive buffer (if requested) for the new connection
+        recv_ring_.reset(UseReceiveBuffer() ? new ReceiveRingBuffer() : nullptr);
+        if (recv_ring_)
+            recv_ring_->MaxFrameSize(MaxFrameSize());
+
         // start send and receive threads
         Start();
     }
@@ -277,33 +471,50 @@ namespace CSE384
 
 
     void FixedSizeMsgConnector::SendSocketMessage(const MessagePtr &msg)
-    {   
-        msg->GetHeader()->ToNetorkByteOrder();
-        if (socket.Send(msg->GetRawMsg(), msg->RawMsgLength(),0,1) == -1)
-        {
-            msg->GetHeader()->ToHostByteOrder();
+    {
+        // the whole (fixed size) raw message, from the pre-encoded wire header:
+        // the message is not modified, so it may be sent on many connections at once
+        IOVEC iov[2];
+        Message::GatherFrames(&msg, 1, true, iov);
+
+        if (socket.SendV(iov, 2, 0, 1) == -1)
             throw SenderTransmitMessageDataException(getlasterror_portable());
-        }
-        msg->GetHeader()->ToHostByteOrder();
     }
     
 
+    void FixedSizeMsgConnector::GatherMessages(const MessagePtr *msgs, size_t count, IOVEC *iov)
+    {
+        // fixed size messages always put the whole (raw) message on the wire
+        Message::GatherFrames(msgs, count, true, iov);
+    }
+
+    MessagePtr FixedSizeMsgConnector::DecodeMessage(ReceiveRingBuffer &rb)
+    {
+        return rb.DecodeFixedSize(msg_size_);
+    }
+
     MessagePtr FixedSizeMsgConnector::RecvSocketMessage()
     {
-        MessagePtr msgPtr = Message::CreateEmptyFixedSizeMessage(msg_size_);
-        int recv_bytes;
+        // buffered strategy: decode many frames per recv() call
+        if (recv_ring_)
+            return recv_ring_->NextFixedSizeMessage(socket, msg_size_);
+
+        MessagePtr msgPtr = Message::AllocateFixedSizeMessage(msg_size_);
+        long long recv_bytes;
 
-        if ((recv_bytes = socket.Recv(msgPtr->GetRawMsg(), msgPtr->RawMsgLength(),MSG_WAITALL,1 )) == msgPtr->RawMsgLength())
+        if ((recv_bytes = socket.Recv(msgPtr->GetRawMsg(), msgPtr->RawMsgLength(),MSG_WAITALL,1 )) == (long long) msgPtr->RawMsgLength())
         {
             // *** MUST convert message header to host byte order (e.g. Intel CPU == little endian)
             msgPtr->GetHeader()->ToHostByteOrder();
+            if (!msgPtr->ParseHeader())
+                throw ReceiverReceiveMessageHeaderException(EBADMSG);
             return msgPtr;
         }
 
         // if read zero bytes, then this is the zero length message signaling client shutdown
         if (recv_bytes == 0)
         {
-            return MessagePtr(new Message(nullptr, 0, DISCONNECT));
+            return Message::CreateMessage(nullptr, 0, DISCONNECT);
         }
         else
         {
@@ -1,50 +1,173 @@
 #include "TCPResponder.h"
 #include "ReceiverExceptions.h"
+#include "AsyncLog.h"
 
 namespace CSE384
 {
    TCPResponder::TCPResponder(const EndPoint &ep, TCPSocketOptions *sc) : ServiceEP(ep),
                                                                           sc_(sc),
+                                                                          accept_shards_(1),
+                                                                          pin_shards_(false),
+                                                                          accepted_(0),
                                                                           ch_(nullptr),
                                                                           islistening_(false),
                                                                           useClientRecvQueue_(true),
                                                                           useClientSendQueue_(true),
-                                                                          num_clients_(-1)
+                                                                          useClientSendDrain_(false),
+                                                                          useClientRecvBuffer_(false),
+                                                                          max_client_frame_(MSGHEADER::DEFAULT_MAX_FRAME),
+                                                                          useClientLockFree_(false),
+                                                                          useReactor_(false),
+                                                                          reactor_threads_(2),
+                                                                          client_send_timeout_(-1),
+                                                                          pool_(nullptr),
+                                                                          client_threads_(8),
+                                                                          num_clients_(-1),
+                                                                          next_client_id_(1),
+                                                                          client_queue_limit_(0),
+                                                                          overflow_policy_(SKIP_CLIENT),
+                                                                          skipped_sends_(0),
+                                                                          dropped_clients_(0)
    {
-      listenSocket_.Bind(ep, sc);
+      // in-process end points have no socket (the name is registered by Start)
+      if (!ep.IsInProc())
+         listenSocket_.Bind(ep, sc);
    }
 
    void TCPResponder::Start(int backlog)
    {
       if (!IsListening())
       {
+         accepted_.store(0);
+
+         if (ServiceEP.IsInProc())
+         {
+            inproc_listener_ = InProcListener::Listen(ServiceEP.InProcName());
+            if (!inproc_listener_)
+               throw ReceiverBindException(EADDRINUSE);
+         }
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+         // every shard socket (the first one too) is bound with SO_REUSEPORT,
+         // and listening before any shard can reach the limit and shut it down
+         // (unix:/path and shm:/path end points keep the one listener)
+         if (AcceptShards() > 1 && !ServiceEP.IsLocal() && !ServiceEP.IsInProc())
+         {
+            listenSocket_.Close();
+            listenSocket_.Bind(ServiceEP, sc_, true);
+            for (int i = 1; i < AcceptShards(); ++i)
+            {
+               shardSockets_.emplace_back(new TCPServerSocket());
+               shardSockets_.back()->Bind(ServiceEP, sc_, true);
+            }
+            for (int i = 0; i < AcceptShards(); ++i)
+               ShardSocket(i).Listen(backlog);
+         }
+#endif
+
          IsListening(true);
-         listenThread_ = std::thread(&TCPResponder::ListenThreadProc, this, backlog);
+         listenThread_ = std::thread(&TCPResponder::ListenThreadProc, this, 0, backlog);
+         for (int i = 1; i <= (int)shardSockets_.size(); ++i)
+            shardThreads_.push_back(std::thread(&TCPResponder::ListenThreadProc, this, i, backlog));
       }
    }
 
-   void TCPResponder::ListenThreadProc(int backlog)
+   bool TCPResponder::ClientLimitReached()
+   {
+      return NumClients() != -1 && accepted_.load() >= NumClients();
+   }
+
+   bool TCPResponder::CountClient(int shard)
+   {
+      if (NumClients() == -1)
+         return true;
+
+      int count = accepted_.fetch_add(1) + 1;
+      if (count == NumClients())
+      {
+         // the other shards are blocked in Accept(): wake them to exit
+         for (int i = 0; i <= (int)shardSockets_.size(); ++i)
+         {
+            if (i != shard)
+               ShardSocket(i).Shutdown();
+         }
+      }
+      return count <= NumClients();
+   }
+
+   void TCPResponder::ListenThreadProc(int shard, int backlog)
    {
       try
       {
-         int client_count = 0;
-         // set socket listening
-         listenSocket_.Listen(backlog);
-         IsListening(true);
+         TCPServerSocket& listener = ShardSocket(shard);
+         placement_.Apply("accept" + std::to_string(shard), shard);
+         if (PinAcceptShards())
+            pin_thread_portable(shard % (int)WorkStealingPool::AvailableCores());
+
+         // set socket listening (shards: done by Start)
+         if (shardSockets_.empty() && !inproc_listener_)
+            listener.Listen(backlog);
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+         // epoll multiplexing (elsewhere: the thread pool below); shared memory
+         // channels and in-process connections are not sockets epoll can watch,
+         // they use the thread pool
+         if (UseReactor() && !ServiceEP.IsShm() && !inproc_listener_)
+         {
+            ReactorListen(shard);
+            return;
+         }
+#endif
 
          // std::vector<std::thread> serviceQ_;
-         
-         //Dr. Fawcett's thread pool hard wired to 8 threads (I think?)
-         ThreadPool<8> threadPool_;
+
+         // clients of this responder still being serviced (a shared pool
+         // also runs other work, so its Wait() is not ours); shared with the
+         // work items, which may outlive this frame if accepting throws
+         struct ActiveClients
+         {
+            std::mutex mtx;
+            std::condition_variable cv;
+            size_t count = 0;
+         };
+         std::shared_ptr<ActiveClients> active = std::make_shared<ActiveClients>();
+
+         // service the clients on the shared pool, or on a pool of our own
+         std::unique_ptr<WorkStealingPool> own_pool;
+         WorkStealingPool* pool = UseThreadPool();
+         if (pool == nullptr)
+         {
+            own_pool.reset(new WorkStealingPool(ClientThreads(), placement_));
+            pool = own_pool.get();
+         }
 
          // loop around accepting)
-         while (IsListening() && (client_count++ < NumClients() || NumClients() == -1))
+         while (IsListening() && !ClientLimitReached())
          {
              // ---accept a connection (creating a data pipe)---
-             TCPSocket client_socket = listenSocket_.Accept();
+             // (in-process: a pair of message pipes, nullptr once closed)
+             TCPSocket client_socket;
+             std::shared_ptr<InProcConnection> inproc;
+             if (inproc_listener_)
+             {
+                 if (!(inproc = inproc_listener_->Accept()))
+                     break;
+             }
+             else
+                 client_socket = listener.AcceptDeferred();
 
-             if (client_socket.IsValid())
+             if (client_socket.IsValid() || inproc)
              {
+                 // accepted by two shards at once: over the limit
+                 if (!CountClient(shard))
+                 {
+                     if (inproc)
+                         inproc->Close();
+                     client_socket.Close();
+                     continue;
+                 }
+                 MPL_LOG_DEBUG("accept shard {}: client socket {}", shard, (int)client_socket.GetSockFd());
+
                  if (ch_ != nullptr)
                  {
                      // clone the registered client hander, and hand the socket to the client handler
@@ -52,19 +175,24 @@ namespace CSE384
 
                      // give service end point the client handler instance
                      ch->SetServiceEndPoint(ServiceEP);
+                     ch->MaxFrameSize(MaxClientFrameSize());
 
-                     // give the TCPSocket to the client handler instance
+                     // give the TCPSocket (or the pipes) to the client handler instance
                      ch->SetSocket(client_socket);
+                     ch->inproc_ = inproc;
 
-                     // service the current client request using a threadPool thread
-                     ThreadPool<8>::CallObj service_client = [this, ch]() -> bool
+                     // service the current client request using a pool thread
+                     {
+                        std::lock_guard<std::mutex> lock(active->mtx);
+                        ++active->count;
+                     }
+                     pool->WorkItem([this, ch, active]()
                      {
                          ServiceClient(ch);
-                         return true;
-                     };
-                     threadPool_.workItem(service_client);
-                    
-
+                         std::lock_guard<std::mutex> lock(active->mtx);
+                         if (--active->count == 0)
+                            active->cv.notify_all();
+                     });
 
                      // spawn a thread to service the current client request
                      // serviceQ_.push_back(std::thread(&TCPResponder::ServiceClient, this, ch));
@@ -83,10 +211,13 @@ namespace CSE384
          }
          */
 
-          ThreadPool<8>::CallObj exit = []() ->bool { return false; };
-          threadPool_.workItem(exit);
-          threadPool_.wait();
-         
+          // connections past the client limit are refused
+          if (inproc_listener_)
+             inproc_listener_->Close();
+
+          // finish the clients being serviced (an own pool then stops)
+          std::unique_lock<std::mutex> lock(active->mtx);
+          active->cv.wait(lock, [&active]() { return active->count == 0; });
       }
       catch (const std::exception)
       {
@@ -94,17 +225,87 @@ namespace CSE384
       }
    }
 
+   void TCPResponder::ReactorListen(int shard)
+   {
+      std::vector<std::unique_ptr<Reactor>> reactors;
+      for (int i = 0; i < ReactorThreads(); ++i)
+      {
+         reactors.emplace_back(new Reactor());
+         reactors.back()->Start(placement_, shard * ReactorThreads() + i);
+      }
+
+      TCPServerSocket& listener = ShardSocket(shard);
+      size_t client_count = 0;
+      while (IsListening() && !ClientLimitReached())
+      {
+         TCPSocket client_socket = listener.Accept();
+         if (!client_socket.IsValid())
+            continue;
+         if (ch_ == nullptr)
+            throw ReceiverNoRegisteredClientHandlerException();
+         if (!CountClient(shard))
+         {
+            client_socket.Close();
+            continue;
+         }
+         MPL_LOG_DEBUG("accept shard {}: client socket {} (reactor)", shard, (int)client_socket.GetSockFd());
+
+         ClientHandler* ch = ch_->Clone();
+         ch->SetServiceEndPoint(ServiceEP);
+         ch->MaxFrameSize(MaxClientFrameSize());
+         ch->SetSocket(client_socket);
+
+         // round robin: the reactor owns the handler from here on
+         Reactor* reactor = reactors[client_count++ % reactors.size()].get();
+         ch->reactor_ = reactor;
+         ch->responder_ = this;
+         RegisterClient(ch);
+         reactor->Add(ch);
+      }
+
+      // wait for the connected clients to finish (like the thread pool does)
+      for (auto& reactor : reactors)
+         reactor->Finish();
+   }
+
    void TCPResponder::ServiceClient(ClientHandler* ch)
    {
        std::thread clientThread;
+       // in-process: AppProc() works on the pipes, no socket and no threads
+       bool use_threads = (ch->inproc_ == nullptr);
+
+       // shm:/path: the channel handshake waits for the client, here on the
+       // pool thread rather than on the accept thread
+       if (use_threads && !ch->GetDataSocket().CompleteAccept())
+       {
+           delete ch;
+           return;
+       }
+
        try
        {
+           if (use_threads)
+           {
+              // wait for readiness (poll) rather than sleep and retry
+              ch->GetDataSocket().SetNonBlocking(true);
+              ch->GetDataSocket().SendTimeout(ClientSendTimeout());
+
+              ch->UseReceiveBuffer(UseClientReceiveBuffer());
+              ch->UseLockFreeQueues(UseClientLockFreeQueues());
+              ch->UseSendDrain(UseClientSendDrain());
+              ch->placement_ = placement_;
+           }
+
+           // reachable through Broadcast/SendTo while AppProc() runs (posts are
+           // queued until the send thread starts); the id also places the threads
+           RegisterClient(ch);
+
            //start the client processing thread, if use specifies to 
-           if (UseClientReceiveQueue())
+           if (use_threads && UseClientReceiveQueue())
                ch->StartReceiving();
 
            // start the send thread
-           if (UseClientSendQueue())
+           if (use_threads && UseClientSendQueue())
                ch->StartSending();
 
            // start the user defined AppProc() on a new thread
@@ -118,6 +319,8 @@ namespace CSE384
            std::cerr << ex.what() << std::endl;
        }
 
+       UnregisterClient(ch);
+
        try
        {
            //wait for the receive thread to shutdown
@@ -140,6 +343,76 @@ namespace CSE384
 
        delete ch;
    }
+   void TCPResponder::RegisterClient(ClientHandler* ch)
+   {
+      std::lock_guard<std::mutex> lock(clients_mtx_);
+      ch->SetClientId(next_client_id_++);
+      clients_[ch->GetClientId()] = ch;
+   }
+
+   void TCPResponder::UnregisterClient(ClientHandler* ch)
+   {
+      // after this returns, no Broadcast/SendTo can reach ch (safe to tear down)
+      std::lock_guard<std::mutex> lock(clients_mtx_);
+      clients_.erase(ch->GetClientId());
+   }
+
+   bool TCPResponder::PostToClient(ClientHandler* ch, const MessagePtr& msg)
+   {
+      // server push goes through the client send queues (see TCPResponder.h)
+      if ((!UseClientSendQueue() && ch->reactor_ == nullptr && !ch->inproc_) || ch->IsDropped())
+         return false;
+
+      // a full lock-free send ring is a depth limit too (never wait under the registry lock)
+      size_t limit = ClientQueueLimit();
+      if ((limit > 0 && ch->SendQueueDepth() >= limit) || !ch->TryPostMessage(msg))
+      {
+         if (overflow_policy_.load() == DISCONNECT_CLIENT)
+         {
+            ch->Drop();
+            ++dropped_clients_;
+         }
+         else
+            ++skipped_sends_;
+         return false;
+      }
+      return true;
+   }
+
+   size_t TCPResponder::Broadcast(const MessagePtr& msg)
+   {
+      size_t sent = 0;
+      std::lock_guard<std::mutex> lock(clients_mtx_);
+      for (auto& client : clients_)
+      {
+         if (PostToClient(client.second, msg))
+            ++sent;
+      }
+      return sent;
+   }
+
+   bool TCPResponder::SendTo(ClientId id, const MessagePtr& msg)
+   {
+      std::lock_guard<std::mutex> lock(clients_mtx_);
+      auto client = clients_.find(id);
+      return client != clients_.end() && PostToClient(client->second, msg);
+   }
+
+   size_t TCPResponder::NumConnectedClients()
+   {
+      std::lock_guard<std::mutex> lock(clients_mtx_);
+      return clients_.size();
+   }
+
+   std::vector<ClientId> TCPResponder::ConnectedClients()
+   {
+      std::vector<ClientId> ids;
+      std::lock_guard<std::mutex> lock(clients_mtx_);
+      for (auto& client : clients_)
+         ids.push_back(client.first);
+      return ids;
+   }
+
    void TCPResponder::RegisterClientHandler(ClientHandler *ch)
    {
       ch_ = ch;
@@ -149,14 +422,22 @@ namespace CSE384
    void TCPResponder::Stop()
    {
       // if user started the listener, then shut it all down
-      if (IsListening())
+      if (IsListening() || listenThread_.joinable())
       {
          try
          {     
             if(listenThread_.joinable())
                listenThread_.join();
+            for (auto& shard : shardThreads_)
+               if (shard.joinable())
+                  shard.join();
+            shardThreads_.clear();
 
+            inproc_listener_.reset();
             listenSocket_.Close(); 
+            for (auto& sock : shardSockets_)
+               sock->Close();
+            shardSockets_.clear();
             IsListening(false);
          }
          catch(...)
@@ -2,26 +2,43 @@
 #include "TCPSocketExceptions.h"
 #include "SenderExceptions.h"
 #include "ReceiverExceptions.h"
+#include "IoUring.h"
+#include "ShmChannel.h"
 
 #include <string>
 #include <sstream>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include <sys/sendfile.h>
+#include <signal.h>
+#endif
 
 namespace CSE384
 {
 
-  TCPSocket::TCPSocket() : sock_fd(INVALID_SOCKET)
+  TCPSocket::TCPSocket() : sock_fd(INVALID_SOCKET), send_timeout_ms(-1), recv_timeout_ms(-1), shm_pending_(false)
   {
   }
 
-  TCPSocket::TCPSocket(SOCKET socket) : sock_fd(socket)
+  TCPSocket::TCPSocket(SOCKET socket) : sock_fd(socket), send_timeout_ms(-1), recv_timeout_ms(-1), shm_pending_(false)
   {
   }
 
   TCPSocket::TCPSocket(TCPSocket &&s) noexcept
   {
     sock_fd = s.sock_fd;
+    send_timeout_ms = s.send_timeout_ms;
+    recv_timeout_ms = s.recv_timeout_ms;
+    shm_ = std::move(s.shm_);
+    shm_pending_ = s.shm_pending_;
     s.sock_fd = INVALID_SOCKET;
+    s.shm_pending_ = false;
   }
 
   TCPSocket &TCPSocket::operator=(TCPSocket &&s) noexcept
@@ -29,11 +46,90 @@ namespace CSE384
     if(this != &s)
     {
       sock_fd = s.sock_fd;
+      send_timeout_ms = s.send_timeout_ms;
+      recv_timeout_ms = s.recv_timeout_ms;
+      shm_ = std::move(s.shm_);
+      shm_pending_ = s.shm_pending_;
       s.sock_fd = INVALID_SOCKET;
+      s.shm_pending_ = false;
     }
     return *this;
   }
 
+  // outcome of a send/recv call that returned -1 (see IoWait::Wait)
+  enum { IO_AGAIN, IO_TIMEOUT, IO_ERROR };
+
+  // readiness wait for one Send/Recv call: the deadline covers the whole call,
+  // not each wait
+  class IoWait
+  {
+  public:
+    IoWait(int timeout_ms) : timeout_ms_(timeout_ms)
+    {
+      if (timeout_ms_ > 0)
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms_);
+    }
+
+    // IO_AGAIN: interrupted, or the socket is ready (repeat the call now)
+    // IO_TIMEOUT: the deadline passed (ETIMEDOUT), or timeout 0 (EWOULDBLOCK kept)
+    // IO_ERROR: any other error, left to the caller's retry policy
+    // (shm: wait for the shared memory channel instead of the socket)
+    int Wait(SOCKET fd, bool write, ShmChannel *shm = nullptr)
+    {
+      int error = getlasterror_portable();
+      if (interrupted_portable(error))
+        return IO_AGAIN;
+      if (!wouldblock_portable(error))
+        return IO_ERROR;
+      if (timeout_ms_ == 0)
+        return IO_TIMEOUT;
+
+      int wait_ms = -1;
+      if (timeout_ms_ > 0)
+      {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline_ - std::chrono::steady_clock::now());
+        if (left.count() <= 0)
+        {
+          settimedout_portable();
+          return IO_TIMEOUT;
+        }
+        wait_ms = (int)left.count();
+      }
+
+      int ready = (shm != nullptr) ? shm->Poll(write, wait_ms) : poll_portable(fd, write, wait_ms);
+      if (ready == 0)
+      {
+        settimedout_portable();
+        return IO_TIMEOUT;
+      }
+      if (ready == -1 && !interrupted_portable(getlasterror_portable()))
+        return IO_ERROR;
+      return IO_AGAIN;
+    }
+
+  private:
+    int timeout_ms_;
+    std::chrono::steady_clock::time_point deadline_;
+  };
+
+  static std::atomic<bool> use_io_uring(false);
+
+  // this thread's ring when io_uring routing is on and available, else nullptr
+  static IoUring *io_ring()
+  {
+    return use_io_uring.load(std::memory_order_relaxed) ? IoUring::ThreadRing() : nullptr;
+  }
+
+  void TCPSocket::UseIoUring(bool use)
+  {
+    use_io_uring = use;
+  }
+
+  bool TCPSocket::UseIoUring()
+  {
+    return use_io_uring;
+  }
+
   template <typename T>
   static std::string ToString(const T &t)
   {
@@ -61,24 +157,47 @@ namespace CSE384
     return getaddrinfo(node_name, serv_name, &hints, servinfo);
   }
 
-  int TCPSocket::Send(const char *block, size_t blockLen, int flags, int sendRetries, unsigned int wait_time)
+  // one send/recv call moves at most this many bytes: the system calls take
+  // (Windows) or return (ssize_t narrowed to int here) an int count
+  static const size_t IO_CALL_MAX = (size_t)INT_MAX;
+
+  long long TCPSocket::Send(const char *block, size_t blockLen, int flags, int sendRetries, unsigned int wait_time)
   {
     int bytesSent;
 
-    int bytesLeft = (int) blockLen;
-    int blockIndx = 0;
+    size_t bytesLeft = blockLen;
+    size_t blockIndx = 0;
     int count = 0;
+    IoUring *ring = io_ring();
+    IoWait wait(send_timeout_ms);
 
     while (bytesLeft > 0)
     {
-      bytesSent = send(sock_fd, &block[blockIndx], bytesLeft, flags);
+      if (shm_ != nullptr)
+      {
+        IOVEC v;
+        set_iovec_portable(v, &block[blockIndx], std::min(bytesLeft, IO_CALL_MAX));
+        bytesSent = (int)shm_->Send(&v, 1);
+      }
+      else
+      {
+        int chunk = (int)std::min(bytesLeft, IO_CALL_MAX);
+        bytesSent = (ring != nullptr) ? (int)ring->Send(sock_fd, &block[blockIndx], chunk, flags)
+                                      : (int)send(sock_fd, &block[blockIndx], chunk, flags);
+      }
       if (bytesSent > 0)
       {
-        bytesLeft -= bytesSent;
-        blockIndx += bytesSent;
+        bytesLeft -= (size_t)bytesSent;
+        blockIndx += (size_t)bytesSent;
       }
       else if (bytesSent == -1)
       {
+        int outcome = wait.Wait(sock_fd, true, shm_.get());
+        if (outcome == IO_AGAIN)
+          continue;
+        if (outcome == IO_TIMEOUT)
+          return -1;
+
         ++count;
         if(count > sendRetries)
           return -1;
@@ -86,29 +205,99 @@ namespace CSE384
         //usleep(wait_time);
       }
     }
-    return (int) blockLen;
+    return (long long) blockLen;
+  }
+
+  long long TCPSocket::SendV(IOVEC *iov, int iovcnt, int flags, int sendRetries, unsigned int wait_time)
+  {
+    long long bytesSent;
+    size_t totalSent = 0;
+    int first = 0;
+    int count = 0;
+    IoWait wait(send_timeout_ms);
+
+    while (first < iovcnt)
+    {
+      int n = (iovcnt - first < IOVEC_MAX) ? (iovcnt - first) : IOVEC_MAX;
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+      struct msghdr mh;
+      memset(&mh, 0, sizeof(mh));
+      mh.msg_iov = &iov[first];
+      mh.msg_iovlen = n;
+      // a peer (or local Shutdown) closing the connection is reported as EPIPE, not SIGPIPE
+      IoUring *ring = io_ring();
+      if (shm_ != nullptr)
+        bytesSent = shm_->Send(&iov[first], n);
+      else
+        bytesSent = (ring != nullptr) ? ring->SendMsg(sock_fd, &mh, flags)
+                                      : sendmsg(sock_fd, &mh, flags | MSG_NOSIGNAL);
+#else
+      DWORD sent = 0;
+      bytesSent = (WSASend(sock_fd, &iov[first], n, &sent, flags, NULL, NULL) == 0) ? (long long)sent : -1;
+#endif
+      if (bytesSent > 0 || (bytesSent == 0 && iovec_len_portable(iov[first]) == 0))
+      {
+        totalSent += (size_t)bytesSent;
+
+        // skip the buffers written completely (including empty ones), then trim a partial write
+        size_t left = (size_t)bytesSent;
+        while (first < iovcnt && left >= iovec_len_portable(iov[first]))
+          left -= iovec_len_portable(iov[first++]);
+        if (first < iovcnt && left > 0)
+          advance_iovec_portable(iov[first], left);
+      }
+      else
+      {
+        int outcome = wait.Wait(sock_fd, true, shm_.get());
+        if (outcome == IO_AGAIN)
+          continue;
+        if (outcome == IO_TIMEOUT)
+          return -1;
+
+        ++count;
+        if (count > sendRetries)
+          return -1;
+        std::this_thread::sleep_for(std::chrono::microseconds(wait_time));
+      }
+    }
+    return (long long) totalSent;
   }
 
   //test MSG_WAITALL flag
-  int TCPSocket::Recv(const char *block, size_t blockLen, int flags, int recvRetries, unsigned int wait_time)
+  long long TCPSocket::Recv(const char *block, size_t blockLen, int flags, int recvRetries, unsigned int wait_time)
   {
-    int bytesRecvd, bytesLeft = (int) blockLen;
-    int blockIndx = 0;
+    int bytesRecvd;
+    size_t bytesLeft = blockLen;
+    size_t blockIndx = 0;
     int count = 0;
+    IoUring *ring = io_ring();
+    IoWait wait(recv_timeout_ms);
 
     while (bytesLeft > 0)
     {
-      bytesRecvd = recv(sock_fd, (char *)&block[blockIndx], bytesLeft, flags);
+      int chunk = (int)std::min(bytesLeft, IO_CALL_MAX);
+      if (shm_ != nullptr)
+        bytesRecvd = (int)shm_->Recv((char *)&block[blockIndx], chunk);
+      else
+        bytesRecvd = (ring != nullptr) ? (int)ring->Recv(sock_fd, (char *)&block[blockIndx], chunk, flags)
+                                       : (int)recv(sock_fd, (char *)&block[blockIndx], chunk, flags);
 
       if (bytesRecvd > 0)
       {
-        bytesLeft -= bytesRecvd;
-        blockIndx += bytesRecvd;
+        bytesLeft -= (size_t)bytesRecvd;
+        blockIndx += (size_t)bytesRecvd;
       }
       else if (bytesRecvd == 0)
-        return 0;
+        return (long long) blockIndx;
       else
       {
+        int outcome = wait.Wait(sock_fd, false, shm_.get());
+        if (outcome == IO_AGAIN)
+          continue;
+        if (outcome == IO_TIMEOUT)
+          return -1;
+
         ++count;
         if (count > recvRetries)
           return -1;
@@ -116,7 +305,271 @@ namespace CSE384
          //usleep(wait_time);
       }
     }
-    return (int) blockLen;
+    return (long long) blockLen;
+  }
+
+  long long TCPSocket::SendSomeV(const IOVEC *iov, int iovcnt, int flags)
+  {
+    if (iovcnt > IOVEC_MAX)
+      iovcnt = IOVEC_MAX;
+    if (shm_ != nullptr)
+      return shm_->Send(iov, iovcnt);
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = (IOVEC *)iov;
+    mh.msg_iovlen = iovcnt;
+    return sendmsg(sock_fd, &mh, flags | MSG_NOSIGNAL);
+#else
+    DWORD sent = 0;
+    return (WSASend(sock_fd, (IOVEC *)iov, iovcnt, &sent, flags, NULL, NULL) == 0) ? (long long)sent : -1;
+#endif
+  }
+
+  int TCPSocket::RecvSome(const char *block, size_t blockLen, int flags, int recvRetries, unsigned int wait_time)
+  {
+    int count = 0;
+    int bytesRecvd;
+    IoWait wait(recv_timeout_ms);
+
+    blockLen = std::min(blockLen, IO_CALL_MAX);
+    while ((bytesRecvd = (shm_ != nullptr) ? (int)shm_->Recv((char *)block, blockLen)
+                                           : (int)recv(sock_fd, (char *)block, (int) blockLen, flags)) == -1)
+    {
+      int outcome = wait.Wait(sock_fd, false, shm_.get());
+      if (outcome == IO_AGAIN)
+        continue;
+      if (outcome == IO_TIMEOUT)
+        return -1;
+
+      ++count;
+      if (count > recvRetries)
+        return -1;
+      std::this_thread::sleep_for(std::chrono::microseconds(wait_time));
+    }
+    return bytesRecvd;
+  }
+
+  // SendFile/RecvFile chunk when the bytes go through a buffer
+  static const size_t FILE_COPY_BUFFER = 64 * 1024;
+
+  static long long CopyFileToSocket(TCPSocket &sock, int file_fd, long long offset, size_t count)
+  {
+    std::vector<char> buf(std::min(count, FILE_COPY_BUFFER));
+    size_t done = 0;
+    while (done < count)
+    {
+      long long n = pread_portable(file_fd, buf.data(), std::min(buf.size(), count - done), offset + (long long)done);
+      if (n == -1)
+        return -1;
+      if (n == 0)
+        break;
+      if (sock.Send(buf.data(), (size_t)n, 0, 1) == -1)
+        return -1;
+      done += (size_t)n;
+    }
+    return (long long)done;
+  }
+
+  static long long CopySocketToFile(TCPSocket &sock, int file_fd, long long offset, size_t count)
+  {
+    std::vector<char> buf(std::min(count, FILE_COPY_BUFFER));
+    size_t done = 0;
+    while (done < count)
+    {
+      int n = sock.RecvSome(buf.data(), std::min(buf.size(), count - done), 0, 1);
+      if (n == -1)
+        return -1;
+      if (n == 0)
+        break;
+      for (int put = 0; put < n; )
+      {
+        long long w = pwrite_portable(file_fd, buf.data() + put, (size_t)(n - put), offset + (long long)(done + put));
+        if (w <= 0)
+          return -1;
+        put += (int)w;
+      }
+      done += (size_t)n;
+    }
+    return (long long)done;
+  }
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+  // sendfile and splice have no MSG_NOSIGNAL: SIGPIPE is blocked in the calling
+  // thread while they run, and a SIGPIPE they raise is discarded (EPIPE is kept)
+  class SigPipeGuard
+  {
+  public:
+    SigPipeGuard()
+    {
+      sigemptyset(&pipe_set_);
+      sigaddset(&pipe_set_, SIGPIPE);
+      sigset_t pending;
+      sigpending(&pending);
+      was_pending_ = sigismember(&pending, SIGPIPE) == 1;
+      pthread_sigmask(SIG_BLOCK, &pipe_set_, &old_);
+    }
+
+    ~SigPipeGuard()
+    {
+      int error = errno;
+      sigset_t pending;
+      if (!was_pending_ && sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1)
+      {
+        struct timespec zero = {0, 0};
+        sigtimedwait(&pipe_set_, nullptr, &zero);
+      }
+      pthread_sigmask(SIG_SETMASK, &old_, nullptr);
+      errno = error;
+    }
+
+  private:
+    sigset_t pipe_set_;
+    sigset_t old_;
+    bool was_pending_;
+  };
+
+  // RecvFile: socket -> pipe -> file, one pipe per thread (empty between calls)
+  class SplicePipe
+  {
+  public:
+    SplicePipe() { Open(); }
+    ~SplicePipe() { Close(); }
+
+    bool IsOpen() const { return fd_[0] != -1; }
+    int ReadFd() const { return fd_[0]; }
+    int WriteFd() const { return fd_[1]; }
+    // a failed call may leave bytes in the pipe: start over with an empty one
+    void Reset() { Close(); Open(); }
+
+  private:
+    void Open()
+    {
+      if (pipe2(fd_, O_CLOEXEC) != 0)
+        fd_[0] = fd_[1] = -1;
+    }
+
+    void Close()
+    {
+      if (IsOpen())
+      {
+        close(fd_[0]);
+        close(fd_[1]);
+        fd_[0] = fd_[1] = -1;
+      }
+    }
+
+    int fd_[2];
+  };
+
+  // move len bytes from the pipe into file_fd at off (a file that splice cannot
+  // write, e.g. O_APPEND, is written from a buffer)
+  static bool DrainPipe(int pipe_fd, int file_fd, loff_t &off, size_t len)
+  {
+    while (len > 0)
+    {
+      ssize_t n = splice(pipe_fd, nullptr, file_fd, &off, len, SPLICE_F_MOVE);
+      if (n > 0)
+      {
+        len -= (size_t)n;
+        continue;
+      }
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n == 0 || errno != EINVAL)
+        return false;
+
+      char buf[16 * 1024];
+      while (len > 0)
+      {
+        ssize_t r = read(pipe_fd, buf, std::min(len, sizeof(buf)));
+        if (r <= 0)
+          return false;
+        for (ssize_t put = 0; put < r; )
+        {
+          ssize_t w = pwrite(file_fd, buf + put, (size_t)(r - put), off);
+          if (w <= 0)
+            return false;
+          put += w;
+          off += w;
+        }
+        len -= (size_t)r;
+      }
+    }
+    return true;
+  }
+#endif
+
+  long long TCPSocket::SendFile(int file_fd, long long offset, size_t count)
+  {
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+    if (shm_ == nullptr)
+    {
+      SigPipeGuard guard;
+      IoWait wait(send_timeout_ms);
+      off_t off = (off_t)offset;
+      size_t sent = 0;
+      while (sent < count)
+      {
+        ssize_t n = sendfile(sock_fd, file_fd, &off, count - sent);
+        if (n > 0)
+          sent += (size_t)n;
+        else if (n == 0)
+          break;
+        else if (errno == EINVAL || errno == ENOSYS)
+        {
+          // a file sendfile cannot read from
+          long long rest = CopyFileToSocket(*this, file_fd, (long long)off, count - sent);
+          return (rest == -1) ? -1 : (long long)sent + rest;
+        }
+        else if (wait.Wait(sock_fd, true) != IO_AGAIN)
+          return -1;
+      }
+      return (long long)sent;
+    }
+#endif
+    return CopyFileToSocket(*this, file_fd, offset, count);
+  }
+
+  long long TCPSocket::RecvFile(int file_fd, long long offset, size_t count)
+  {
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+    thread_local SplicePipe pipe;
+    if (shm_ == nullptr && pipe.IsOpen())
+    {
+      SigPipeGuard guard;
+      IoWait wait(recv_timeout_ms);
+      loff_t off = (loff_t)offset;
+      size_t done = 0;
+      while (done < count)
+      {
+        ssize_t n = splice(sock_fd, nullptr, pipe.WriteFd(), nullptr, count - done, SPLICE_F_MOVE);
+        if (n > 0)
+        {
+          if (!DrainPipe(pipe.ReadFd(), file_fd, off, (size_t)n))
+          {
+            int error = errno;
+            pipe.Reset();
+            errno = error;
+            return -1;
+          }
+          done += (size_t)n;
+        }
+        else if (n == 0)
+          break;
+        else if (errno == EINVAL || errno == ENOSYS)
+        {
+          // a socket splice cannot read from
+          long long rest = CopySocketToFile(*this, file_fd, (long long)off, count - done);
+          return (rest == -1) ? -1 : (long long)done + rest;
+        }
+        else if (wait.Wait(sock_fd, false) != IO_AGAIN)
+          return -1;
+      }
+      return (long long)done;
+    }
+#endif
+    return CopySocketToFile(*this, file_fd, offset, count);
   }
 
   static int GetPeerEndPoint(int sock_fd, char ipstr[], unsigned int &port)
@@ -128,6 +581,14 @@ namespace CSE384
     if (getpeername(sock_fd, (struct sockaddr *)&addr, &len) == -1)
       return -1;
 
+    // Unix domain: clients are normally unnamed, "unix:" then
+    if (addr.ss_family == AF_UNIX)
+    {
+      port = 0;
+      strcpy(ipstr, "unix:");
+      return 0;
+    }
+
     // deal with both IPv4 and IPv6:
     if (addr.ss_family == AF_INET)
     {
@@ -146,6 +607,9 @@ namespace CSE384
 
   EndPoint TCPSocket::RemoteEP()
   {
+    if (shm_ != nullptr)
+      return EndPoint(EndPoint::SHM_PREFIX, 0);
+
     unsigned int port;
     char ipstr[INET6_ADDRSTRLEN];
     if(GetPeerEndPoint((int) GetSockFd(), ipstr, port) == 0)
@@ -155,12 +619,69 @@ namespace CSE384
 
   int TCPSocket::Close()
   {
+    // the peer's waits end on the socket closing
     int ret = closesocket(sock_fd);
     if (ret == 0)
+    {
       sock_fd = INVALID_SOCKET;
+      shm_.reset();
+    }
     return ret;
   }
 
+  int TCPSocket::Shutdown()
+  {
+    if (shm_ != nullptr)
+    {
+      shm_->ShutdownSend();
+      shm_->ShutdownRecv();
+      return 0;
+    }
+    return shutdown(sock_fd, SD_BOTH);
+  }
+
+  // shm: the socket stays open (a half closed socket would look like a
+  // closed peer), only the channel direction is shut down
+  int TCPSocket::ShutdownSend()
+  {
+    if (shm_ != nullptr)
+    {
+      shm_->ShutdownSend();
+      return 0;
+    }
+    return shutdown(sock_fd, SD_SEND);
+  }
+
+  int TCPSocket::ShutdownRecv()
+  {
+    if (shm_ != nullptr)
+    {
+      shm_->ShutdownRecv();
+      return 0;
+    }
+    return shutdown(sock_fd, SD_RECEIVE);
+  }
+
+  int TCPSocket::UnixSocket(const EndPoint &ep, TCPSocketOptions *sc,
+                            struct sockaddr_storage *addr, socklen_t *addrlen, int &error)
+  {
+    if (unix_addr_portable(ep.UnixPath().c_str(), addr, addrlen) != 0 ||
+        SetSockFd(socket(AF_UNIX, SOCK_STREAM, 0)) == INVALID_SOCKET)
+    {
+      error = getlasterror_portable();
+      return -1;
+    }
+
+    if (sc != 0 && sc->SetSocketOptions(this) == -1)
+    {
+      error = getlasterror_portable();
+      closesocket(GetSockFd());
+      SetSockFd(INVALID_SOCKET);
+      throw SocketOptionsException(error);
+    }
+    return 0;
+  }
+
   void TCPClientSocket::Connect(const EndPoint &ep, TCPSocketOptions *sc)
   {
     struct addrinfo *p;
@@ -168,6 +689,29 @@ namespace CSE384
     int error = 0;
     int addr_info_result;
 
+    if (ep.IsLocal())
+    {
+      struct sockaddr_storage addr;
+      socklen_t addrlen;
+      shm_.reset();
+      if (UnixSocket(ep, sc, &addr, &addrlen, error) != 0)
+        throw SenderConnectException(error);
+      bool connected = (connect(GetSockFd(), (struct sockaddr *)&addr, addrlen) != INVALID_SOCKET);
+      if (!connected)
+        error = getlasterror_portable();
+      // shm: hand the shared memory channel to the listener
+      else if (ep.IsShm())
+        connected = ((shm_ = ShmChannel::Connect(GetSockFd(), error)) != nullptr);
+
+      if (!connected)
+      {
+        closesocket(GetSockFd());
+        SetSockFd(INVALID_SOCKET);
+        throw SenderConnectException(error);
+      }
+      return;
+    }
+
     if ((addr_info_result = GetAddressInfo(ep.IP_STR(), ToString(ep.Port()).c_str(), AF_UNSPEC, &servinfo)) != 0)
       throw GetAddrInfoException(addr_info_result);
 
@@ -221,13 +765,43 @@ namespace CSE384
       throw ReceiverListenException(getlasterror_portable());
   }
 
-  void TCPServerSocket::Bind(const EndPoint &ep, TCPSocketOptions *sc)
+  void TCPServerSocket::Bind(const EndPoint &ep, TCPSocketOptions *sc, bool reuse_port)
   {
     struct addrinfo *p;
     struct addrinfo *servinfo;
     int addr_info_result;
     int error = 0;
 
+    if (ep.IsLocal())
+    {
+      // a second listener cannot share the path (the file would be replaced)
+      if (reuse_port)
+        throw SocketOptionsException(EOPNOTSUPP);
+
+      struct sockaddr_storage addr;
+      socklen_t addrlen;
+      if (UnixSocket(ep, sc, &addr, &addrlen, error) != 0)
+        throw ReceiverBindException(error);
+      // a socket file of a listener that is gone is replaced, a live one is not
+      if (unlink_unix_socket_portable(ep.UnixPath().c_str()) != 0)
+      {
+        error = getlasterror_portable();
+        closesocket(GetSockFd());
+        SetSockFd(INVALID_SOCKET);
+        throw ReceiverBindException(error);
+      }
+      if (bind(GetSockFd(), (struct sockaddr *)&addr, addrlen) == INVALID_SOCKET)
+      {
+        error = getlasterror_portable();
+        closesocket(GetSockFd());
+        SetSockFd(INVALID_SOCKET);
+        throw ReceiverBindException(error);
+      }
+      unix_path_ = ep.UnixPath();
+      shm_listener_ = ep.IsShm();
+      return;
+    }
+
     if((addr_info_result = GetAddressInfo(ep.IP_STR(), ToString(ep.Port()).c_str(), AF_UNSPEC, &servinfo)) != 0)
       throw GetAddrInfoException(addr_info_result);
 
@@ -251,6 +825,14 @@ namespace CSE384
         }
       }
 
+      if (reuse_port && set_reuseport_portable(GetSockFd()) == -1)
+      {
+        error = getlasterror_portable();
+        closesocket(GetSockFd());
+        freeaddrinfo(servinfo);
+        throw SocketOptionsException(error);
+      }
+
       // attempt current connection result, and get out with first successful attempt
       if (bind(GetSockFd(), p->ai_addr, (int)p->ai_addrlen) == INVALID_SOCKET)
       {
@@ -271,7 +853,40 @@ namespace CSE384
     freeaddrinfo(servinfo);
   }
 
+  int TCPServerSocket::Close()
+  {
+    int ret = TCPSocket::Close();
+    if (ret == 0 && !unix_path_.empty())
+    {
+      unlink_unix_socket_portable(unix_path_.c_str());
+      unix_path_.clear();
+    }
+    return ret;
+  }
+
+  bool TCPSocket::CompleteAccept()
+  {
+    if (!shm_pending_)
+      return true;
+
+    shm_pending_ = false;
+    int error;
+    if ((shm_ = ShmChannel::Accept(GetSockFd(), error)) == nullptr)
+    {
+      Close();
+      return false;
+    }
+    return true;
+  }
+
   TCPSocket TCPServerSocket::Accept()
+  {
+    TCPSocket client = AcceptDeferred();
+    client.CompleteAccept();
+    return client;
+  }
+
+  TCPSocket TCPServerSocket::AcceptDeferred()
   {
     struct sockaddr_in client_addr;
     socklen_t addrlen = sizeof(client_addr);
@@ -280,7 +895,13 @@ namespace CSE384
     // std::cout << "Hello New Client From: " << inet_ntoa(client_addr.sin_addr) << " : "
     //           << ntohs(client_addr.sin_port) << std::endl;
 
-    return TCPSocket(accept(GetSockFd(), (struct sockaddr *)&client_addr, &addrlen));
+    IoUring *ring = io_ring();
+    TCPSocket client((ring != nullptr) ? ring->Accept(GetSockFd())
+                                       : accept(GetSockFd(), (struct sockaddr *)&client_addr, &addrlen));
+
+    // the shared memory channel is set up by CompleteAccept()
+    client.shm_pending_ = shm_listener_ && client.IsValid();
+    return client;
   }
 
 }; // namespace CSE384
@@ -51,6 +51,15 @@ int main()
   Task<8>::CallObj exit = []() ->bool { return false; };
   tsk.workItem(exit);
   tsk.wait();
+
+  Utils::title("Task<0>: shared work stealing pool");
+  Task<0> shared;
+  Show::write("\n  pool threads: " + Utilities::Converter<size_t>::toString(shared.threadPool().NumThreads()));
+  for (size_t i = 0; i < 20; ++i)
+    shared.workItem(co);
+  shared.wait();
+  Show::write("\n  steals: " + Utilities::Converter<uint64_t>::toString(shared.threadPool().Steals()));
+  Show::stop();
 }
 
 #endif
@@ -0,0 +1,123 @@
+/////////////////////////////////////////////////////////////////////////////
+// ThreadPlacement.cpp - cpu set, NUMA node and name of MPL threads        //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <sstream>
+
+#include "Platform.h"
+#include "ThreadPlacement.h"
+
+namespace CSE384
+{
+    ThreadPlacement::ThreadPlacement() : spread_(false), name_("mpl-")
+    {
+    }
+
+    ThreadPlacement &ThreadPlacement::Cpus(const std::vector<int> &cpus)
+    {
+        cpus_ = cpus;
+        return *this;
+    }
+
+    ThreadPlacement &ThreadPlacement::Cpus(const std::string &cpu_list)
+    {
+        cpus_ = ParseCpuList(cpu_list);
+        return *this;
+    }
+
+    ThreadPlacement &ThreadPlacement::NumaNode(int node)
+    {
+        cpus_ = NodeCpus(node);
+        return *this;
+    }
+
+    ThreadPlacement &ThreadPlacement::Spread(bool spread)
+    {
+        spread_ = spread;
+        return *this;
+    }
+
+    ThreadPlacement &ThreadPlacement::Name(const std::string &prefix)
+    {
+        name_ = prefix;
+        return *this;
+    }
+
+    std::vector<int> ThreadPlacement::ParseCpuList(const std::string &cpu_list)
+    {
+        std::vector<int> cpus;
+        std::stringstream in(cpu_list);
+        for (std::string range; std::getline(in, range, ',');)
+        {
+            int first = 0, last = 0;
+            char dash = 0;
+            std::stringstream r(range);
+            if (!(r >> first))
+                continue;
+            last = (r >> dash >> last && dash == '-') ? last : first;
+            for (int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    std::vector<int> ThreadPlacement::NodeCpus(int node)
+    {
+        std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string cpu_list;
+        std::getline(list, cpu_list);
+        return ParseCpuList(cpu_list);
+    }
+
+    int ThreadPlacement::NumNodes()
+    {
+        int nodes = 0;
+        while (std::ifstream("/sys/devices/system/node/node" + std::to_string(nodes) + "/cpulist"))
+            ++nodes;
+        return (nodes < 1) ? 1 : nodes;
+    }
+
+    bool ThreadPlacement::Apply(const std::string &role, size_t index) const
+    {
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+        // names longer than 15 characters are refused, keep the start
+        std::string name = (name_ + role).substr(0, 15);
+        if (!name.empty())
+            pthread_setname_np(pthread_self(), name.c_str());
+
+        if (cpus_.empty())
+            return true;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (spread_)
+            CPU_SET(cpus_[index % cpus_.size()], &set);
+        else
+        {
+            for (int cpu : cpus_)
+                CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        if (cpus_.empty())
+            return true;
+
+        DWORD_PTR mask = 0;
+        if (spread_)
+            mask = (DWORD_PTR)1 << cpus_[index % cpus_.size()];
+        else
+        {
+            for (int cpu : cpus_)
+                mask |= (DWORD_PTR)1 << cpu;
+        }
+        return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#endif
+    }
+}
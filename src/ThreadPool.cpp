@@ -19,8 +19,9 @@ int main()
 {
   Show::attach(&std::cout);
   Show::start();
-  DebugLog::attach(&std::cout);
-  DebugLog::start();
+  // pool debug messages (MPL_LOG_DEBUG)
+  CSE384::AsyncLog::Attach(&std::cout);
+  CSE384::AsyncLog::Start(CSE384::LogLevel::Debug);
 
   Utils::Title("Testing ThreadPool");
 
@@ -37,9 +38,9 @@ int main()
   for (size_t i = 0; i < 20; ++i)
     trpl.workItem(co);
 
-  ThreadPool<8>::CallObj exit = []() ->bool { return false; };
-  trpl.workItem(exit);
+  trpl.stop();
   trpl.wait();
+  CSE384::AsyncLog::Stop();
 
   //std::cout << "\n\n";
 }
@@ -0,0 +1,235 @@
+/////////////////////////////////////////////////////////////////////////////
+// WorkStealingPool.cpp - runtime sized thread pool with per worker queues //
+// ver 1.0                                                                 //
+// Language:    Standard C++ (gcc/g++ 7.4)                                 //
+// Platform:    Dell Precision M7720, Linux Mint 19.3 (64-bit)             //
+// Application: CSE 384, MPL (Message passing Layer)                       //
+// Author:      Mike Corley, Syracuse University                           //
+//              mwcorley@syr.edu                                           //
+/////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "WorkStealingPool.h"
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+#include <sched.h>
+#endif
+
+namespace CSE384
+{
+    // the pool (and worker index) the calling thread works for
+    static thread_local WorkStealingPool *current_pool = nullptr;
+    static thread_local size_t current_worker = 0;
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+    // cgroup CPU limit in cores (e.g. 1.5), 0 when there is none
+    static double CgroupCpuLimit()
+    {
+        // cgroup v2: "<quota> <period>" or "max <period>" in cpu.max of this
+        // process's cgroup ("0::<path>" in /proc/self/cgroup), or of the root
+        // when the container mounts its own cgroup there
+        std::string path;
+        std::ifstream self("/proc/self/cgroup");
+        for (std::string line; std::getline(self, line);)
+        {
+            if (line.compare(0, 3, "0::") == 0)
+                path = line.substr(3);
+        }
+
+        for (const std::string &dir : {"/sys/fs/cgroup" + path, std::string("/sys/fs/cgroup")})
+        {
+            std::ifstream max(dir + "/cpu.max");
+            std::string quota;
+            double period = 0;
+            if (max >> quota >> period)
+                return (quota == "max" || period <= 0) ? 0 : std::stod(quota) / period;
+        }
+
+        // cgroup v1: quota -1 means no limit
+        std::ifstream quota_file("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+        std::ifstream period_file("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        double quota = 0, period = 0;
+        if ((quota_file >> quota) && (period_file >> period) && quota > 0 && period > 0)
+            return quota / period;
+        return 0;
+    }
+#endif
+
+    size_t WorkStealingPool::AvailableCores()
+    {
+        size_t cores = std::thread::hardware_concurrency();
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__) && !defined(__NT__) && !defined(_WIN64)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            cores = CPU_COUNT(&set);
+
+        // a quota of 1.5 cores still keeps two threads busy part of the time
+        double limit = CgroupCpuLimit();
+        if (limit > 0 && std::ceil(limit) < cores)
+            cores = (size_t)std::ceil(limit);
+#endif
+
+        return (cores < 1) ? 1 : cores;
+    }
+
+    WorkStealingPool &WorkStealingPool::Shared()
+    {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    WorkStealingPool::WorkStealingPool(size_t num_threads, const ThreadPlacement &placement)
+        : placement_(placement),
+          next_(0),
+          queued_(0),
+          pending_(0),
+          steals_(0),
+          sleepers_(0),
+          stopping_(false)
+    {
+        if (num_threads == 0)
+            num_threads = AvailableCores();
+
+        // every queue exists before any worker may steal from it
+        for (size_t i = 0; i < num_threads; ++i)
+            workers_.emplace_back(new Worker());
+        for (size_t i = 0; i < num_threads; ++i)
+            workers_[i]->thread = std::thread(&WorkStealingPool::WorkerProc, this, i);
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        Stop();
+    }
+
+    void WorkStealingPool::WorkItem(CallObj co)
+    {
+        // a worker keeps what it posts, everyone else spreads round robin
+        size_t target = (current_pool == this) ? current_worker
+                                                : next_.fetch_add(1) % workers_.size();
+        pending_.fetch_add(1);
+        {
+            // counted under the queue lock: no worker can pop (and Run()) it
+            // before it is counted
+            std::lock_guard<std::mutex> lock(workers_[target]->mtx);
+            workers_[target]->items.push_back(std::move(co));
+            queued_.fetch_add(1);
+        }
+
+        // a worker going to sleep counts itself before it checks queued_, so
+        // either it sees this item or this sees it (no lost wake up)
+        if (sleepers_.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx_);
+            idle_cv_.notify_one();
+        }
+    }
+
+    bool WorkStealingPool::PopLocal(size_t self, CallObj &co)
+    {
+        Worker &w = *workers_[self];
+        std::lock_guard<std::mutex> lock(w.mtx);
+        if (w.items.empty())
+            return false;
+        co = std::move(w.items.back());
+        w.items.pop_back();
+        return true;
+    }
+
+    bool WorkStealingPool::Steal(size_t self, CallObj &co)
+    {
+        for (size_t i = 1; i < workers_.size(); ++i)
+        {
+            Worker &w = *workers_[(self + i) % workers_.size()];
+            std::unique_lock<std::mutex> lock(w.mtx, std::try_to_lock);
+            if (!lock.owns_lock() || w.items.empty())
+                continue;
+            co = std::move(w.items.front());
+            w.items.pop_front();
+            steals_.fetch_add(1);
+            return true;
+        }
+        return false;
+    }
+
+    void WorkStealingPool::Run(CallObj &co)
+    {
+        queued_.fetch_sub(1);
+        // one item failing must not take the worker (and pending_) with it
+        try
+        {
+            co();
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "work item: unknown exception" << std::endl;
+        }
+        co = nullptr;
+
+        if (pending_.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(done_mtx_);
+            done_cv_.notify_all();
+        }
+    }
+
+    void WorkStealingPool::WorkerProc(size_t self)
+    {
+        current_pool = this;
+        current_worker = self;
+        placement_.Apply("worker" + std::to_string(self), self);
+
+        CallObj co;
+        for (;;)
+        {
+            if (PopLocal(self, co) || Steal(self, co))
+            {
+                Run(co);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(idle_mtx_);
+            sleepers_.fetch_add(1);
+            // queued_ > 0: an item is (or was) in some queue, the try_lock steal
+            // may have skipped it, look again
+            idle_cv_.wait(lock, [this]() { return queued_.load() > 0 || stopping_; });
+            sleepers_.fetch_sub(1);
+            if (stopping_ && queued_.load() == 0)
+                break;
+        }
+
+        current_pool = nullptr;
+    }
+
+    void WorkStealingPool::Wait()
+    {
+        std::unique_lock<std::mutex> lock(done_mtx_);
+        done_cv_.wait(lock, [this]() { return pending_.load() == 0; });
+    }
+
+    void WorkStealingPool::Stop()
+    {
+        std::lock_guard<std::mutex> stop_lock(stop_mtx_);
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx_);
+            stopping_ = true;
+            idle_cv_.notify_all();
+        }
+
+        for (auto &w : workers_)
+        {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+}
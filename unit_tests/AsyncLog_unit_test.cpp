@@ -0,0 +1,69 @@
+
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cassert>
+#include "AsyncLog.h"
+using namespace CSE384;
+
+size_t count_lines(const std::string& text)
+{
+     size_t lines = 0;
+     for (char c : text)
+          lines += (c == '\n');
+     return lines;
+}
+
+void test_thread_rings_released()
+{
+     std::ostringstream out;
+     AsyncLog::Attach(&out);
+     AsyncLog::Start(LogLevel::Info);
+
+     // many short lived logging threads, a batch at a time
+     const int batches = 16, threads_per_batch = 16, records = 4;
+     for (int b = 0; b < batches; ++b)
+     {
+          std::vector<std::thread> threads;
+          for (int t = 0; t < threads_per_batch; ++t)
+               threads.emplace_back([b, t]() {
+                    for (int i = 0; i < records; ++i)
+                         MPL_LOG_INFO("batch {} thread {} record {}", b, t, i);
+               });
+          for (auto& th : threads)
+               th.join();
+     }
+
+     // the threads are gone: once their records are written, so are their rings
+     AsyncLog::Flush();
+     assert(("Test every record written", count_lines(out.str()) == (size_t)(batches * threads_per_batch * records)));
+     assert(("Test rings of exited threads released", AsyncLog::Rings() == 0));
+
+     // a thread still running keeps its ring
+     std::thread live([]() {
+          MPL_LOG_INFO("live thread");
+          AsyncLog::Flush();
+          assert(("Test ring of a running thread kept", AsyncLog::Rings() == 1));
+     });
+     live.join();
+     AsyncLog::Flush();
+     assert(("Test ring released after join", AsyncLog::Rings() == 0));
+
+     AsyncLog::Stop();
+     AsyncLog::Attach(nullptr);
+}
+
+
+int main()
+{
+     std::cout << "AsyncLog unit tests " << std::endl;
+
+     test_thread_rings_released();
+
+     std::cout << "All tests passed"<< std::endl;
+
+     return 0;
+}
@@ -0,0 +1,56 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <cassert>
+#include "InProc.h"
+using namespace CSE384;
+
+void test_listener_dropped_during_connect()
+{
+     // the owner lets go of the listener while a connector is inside Connect():
+     // the connector may then hold the last reference
+     auto run = std::async(std::launch::async, []() {
+          const std::string name = "unit_test_drop";
+          for (int i = 0; i < 500; ++i)
+          {
+               std::shared_ptr<InProcListener> listener = InProcListener::Listen(name);
+               assert(("Test name registered", listener != nullptr));
+
+               std::atomic<bool> started(false);
+               std::thread connector([&name, &started]() {
+                    started.store(true);
+                    while (InProcListener::Connect(name) != nullptr)
+                         ;
+               });
+               while (!started.load())
+                    ;
+               listener.reset();
+               connector.join();
+          }
+     });
+     assert(("Test no deadlock dropping the listener", run.wait_for(std::chrono::seconds(30)) == std::future_status::ready));
+     run.get();
+
+     // the name is free again, and a closed listener refuses connections
+     std::shared_ptr<InProcListener> listener = InProcListener::Listen("unit_test_drop");
+     assert(("Test name free after drop", listener != nullptr));
+     listener->Close();
+     assert(("Test closed listener refuses", InProcListener::Connect("unit_test_drop") == nullptr));
+     assert(("Test accept after close", listener->Accept() == nullptr));
+}
+
+
+int main()
+{
+     std::cout << "InProc unit tests " << std::endl;
+
+     test_listener_dropped_during_connect();
+
+     std::cout << "All tests passed"<< std::endl;
+
+     return 0;
+}
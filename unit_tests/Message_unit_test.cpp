@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cassert>
 #include <string>
+#include <stdexcept>
 #include "Message.h"
 using namespace CSE384;
 
@@ -23,6 +24,143 @@ void test()
   
 }
 
+void test_extended_header()
+{
+     // small messages keep the legacy 4-byte header
+     MessagePtr small_msg = Message::CreateMessage(std::string("legacy"), 100);
+     assert(("Test legacy HeaderSize()", small_msg->HeaderSize() == 4));
+
+     // bodies over 65535 bytes switch to the extended header
+     std::string body(5 * 1024 * 1024, 'b');
+     MessagePtr big_msg = Message::CreateMessage(body, 100);
+     assert(("Test extended HeaderSize()", big_msg->HeaderSize() == 12));
+     assert(("Test extended Length()", big_msg->Length() == body.size()));
+     assert(("Test extended legacy word", big_msg->GetHeader()->IsExtended()));
+
+     // decode the extension as the receive path does
+     Message decoded(*big_msg->GetHeader(), big_msg->GetRawMsg() + MSGHEADER::SIZE());
+     assert(("Test decoded Length()", decoded.Length() == body.size()));
+     assert(("Test decoded GetType()", decoded.GetType() == 100));
+
+     // types that don't fit in 16 bits also use the extended header
+     MessagePtr wide_type = Message::CreateMessage(std::string("wide"), 0x10000);
+     assert(("Test wide type HeaderSize()", wide_type->HeaderSize() == 12));
+     assert(("Test wide type GetType()", wide_type->GetType() == 0x10000));
+
+     // fixed size messages re-read the header after a raw receive
+     MessagePtr fixed = Message::CreateFixedSizeMessage(128 * 1024, "fixed", 5, 7);
+     assert(("Test fixed ParseHeader()", fixed->ParseHeader()));
+     assert(("Test fixed Length()", fixed->Length() == 5));
+     assert(("Test fixed GetType()", fixed->GetType() == 7));
+
+     // a body longer than the fixed size is refused, nothing is written
+     std::string too_long(65, 'x');
+     bool refused = false;
+     try
+     {
+          Message::CreateFixedSizeMessage(64, too_long.c_str(), too_long.size(), 7);
+     }
+     catch (const std::length_error &)
+     {
+          refused = true;
+     }
+     assert(("Test fixed size overflow refused", refused));
+     MessagePtr exact = Message::CreateFixedSizeMessage(64, too_long.c_str(), 64, 7);
+     assert(("Test fixed size exact fit", exact->Length() == 64));
+}
+
+void test_message_pool()
+{
+     // a released message buffer is handed out again for the same size class
+     MessagePool::ResetCounters();
+     char *raw = nullptr;
+     {
+        MessagePtr msg = Message::CreateMessage(std::string("pooled"), 1);
+        raw = msg->GetRawMsg();
+     }
+     MessagePtr again = Message::CreateMessage(std::string("pooled again"), 1);
+     assert(("Test pooled buffer reused", again->GetRawMsg() == raw));
+     assert(("Test pool hits", MessagePool::Hits() > 0));
+
+     // size classes: 64B .. 64KB bodies (plus header room), larger goes to the heap
+     assert(("Test ClassIndex() small", MessagePool::ClassIndex(4) == 0));
+     assert(("Test ClassIndex() 64KB body", MessagePool::ClassIndex(64 * 1024 + MSGHEADER::SIZE()) == MessagePool::NUM_CLASSES - 1));
+     assert(("Test ClassIndex() oversize", MessagePool::ClassIndex(1024 * 1024) == -1));
+
+     // copies own separate (pooled) buffers
+     Message copy(*again);
+     assert(("Test copy buffer", copy.GetRawMsg() != again->GetRawMsg()));
+     assert(("Test copy contents", copy.ToString() == again->ToString()));
+}
+
+void test_shared_buffers()
+{
+     // Clone() shares the buffer until one side writes (copy on write)
+     MessagePtr msg = Message::CreateMessage(std::string("shared"), 3);
+     MessagePtr clone = msg->Clone();
+     assert(("Test Clone() shares buffer", clone->GetData() == msg->GetData()));
+     assert(("Test Clone() GetType()", clone->GetType() == 3));
+
+     (*clone)[0] = 'S';
+     assert(("Test copy on write", clone->GetData() != msg->GetData()));
+     assert(("Test copy on write clone", clone->ToString() == "Shared"));
+     assert(("Test copy on write original", msg->ToString() == "shared"));
+
+     // the original outlives its clones (and vice versa)
+     MessagePtr clone2 = msg->Clone();
+     msg.reset();
+     assert(("Test clone outlives original", clone2->ToString() == "shared"));
+
+     // adopt a caller owned body without copying
+     bool released = false;
+     char *body = new char[5];
+     std::memcpy(body, "adopt", 5);
+     {
+        MessagePtr adopted = Message::AdoptMessage(std::shared_ptr<char>(body, [&released](char *p) { released = true; delete[] p; }), 5, 9);
+        assert(("Test adopted GetData()", adopted->GetData() == body));
+        assert(("Test adopted Length()", adopted->Length() == 5));
+        assert(("Test adopted header", adopted->GetHeader()->len() == 5 && adopted->GetHeader()->type() == 9));
+
+        Message copy(*adopted);
+        assert(("Test adopted copy", copy.ToString() == "adopt" && copy.GetData() == copy.GetRawMsg() + copy.HeaderSize()));
+     }
+     assert(("Test adopted body released", released));
+
+     // uninitialized fixed size body for receiving
+     MessagePtr recv = Message::AllocateFixedSizeMessage(256);
+     assert(("Test AllocateFixedSizeMessage() RawMsgLength()", recv->RawMsgLength() == 256 + MSGHEADER::SIZE()));
+}
+
+void test_wire_header()
+{
+     // the wire header is pre-encoded in network byte order, the raw header stays in host order
+     MessagePtr msg = Message::CreateMessage(std::string("wire"), 0x21);
+     MSGHEADER wire;
+     std::memcpy(&wire, msg->GetWireHeader(), sizeof(MSGHEADER));
+     wire.ToHostByteOrder();
+     assert(("Test wire header len", wire.len() == 4 && wire.type() == 0x21));
+
+     // gathering frames (same message twice) leaves the message untouched
+     MessagePtr batch[2] = { msg, msg };
+     IOVEC iov[4];
+     Message::GatherFrames(batch, 2, false, iov);
+     assert(("Test GatherFrames() header entry", iovec_base_portable(iov[0]) == msg->GetWireHeader() && iovec_base_portable(iov[2]) == msg->GetWireHeader()));
+     assert(("Test GatherFrames() body entry", iovec_len_portable(iov[1]) == 4 && iovec_base_portable(iov[1]) == msg->GetData()));
+     assert(("Test raw header unchanged", msg->GetHeader()->len() == 4 && msg->GetHeader()->type() == 0x21));
+
+     // extended headers: the extension words are already big endian
+     MessagePtr big = Message::CreateMessage(std::string(70000, 'w'), 5);
+     assert(("Test extended wire header", std::memcmp(big->GetWireHeader() + MSGHEADER::SIZE(), big->GetRawMsg() + MSGHEADER::SIZE(), big->HeaderSize() - MSGHEADER::SIZE()) == 0));
+
+     // ParseHeader() re-encodes after a raw header change
+     MessagePtr fixed = Message::AllocateFixedSizeMessage(64);
+     new (fixed->GetRawMsg()) MSGHEADER(10, 6);
+     assert(("Test ParseHeader()", fixed->ParseHeader()));
+     std::memcpy(&wire, fixed->GetWireHeader(), sizeof(MSGHEADER));
+     wire.ToHostByteOrder();
+     assert(("Test re-encoded wire header", wire.len() == 10 && wire.type() == 6));
+}
+
 
 int main()
 {
@@ -30,6 +168,10 @@ int main()
     try
     {
        test();
+       test_extended_header();
+       test_message_pool();
+       test_shared_buffers();
+       test_wire_header();
     }
     catch(const std::exception& e)
     {